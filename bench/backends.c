@@ -0,0 +1,124 @@
+#include "ast.h"
+#include "chunk.h"
+#include "parser.h"
+#include "reg_chunk.h"
+#include "scanner.h"
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_REPEAT 16U
+#define BENCH_TERMS 20000U
+
+static char *_generate(void) {
+  size_t capacity = BENCH_TERMS * 32;
+  char *source = malloc(capacity);
+  size_t length = 0;
+
+  srand(1);
+  length += snprintf(source, capacity, "0");
+  for (uint32_t i = 0; i < BENCH_TERMS; ++i) {
+    length += snprintf(source + length, capacity - length,
+                       " %c (%d * %d - %d)", i % 2 ? '+' : '-', rand() % 100,
+                       rand() % 100, rand() % 100);
+  }
+  return source;
+}
+
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static uint32_t _count_instructions(chunk_t chunk) {
+  uint32_t count = 0;
+  for (uint32_t offset = 0; offset < chunk->count; ++count) {
+    switch (chunk->code[offset]) {
+    case OPCODE_CONSTANT:
+      offset += 2;
+      break;
+    case OPCODE_CONSTANT_LONG:
+      offset += 4;
+      break;
+    default:
+      offset += 1;
+      break;
+    }
+  }
+  return count;
+}
+
+static void _report(const char *backend, uint32_t instructions, size_t bytes,
+                    double best) {
+  printf("%-8s %12u %12zu %12.3f %10.3f\n", backend, instructions, bytes,
+         best * 1e3, best * 1e9 / instructions);
+}
+
+int main(void) {
+  char *source = _generate();
+
+  struct scanner scanner;
+  struct parser parser;
+  struct ast_arena arena;
+  scanner_init(&scanner, source);
+  ast_arena_new(&arena);
+  parser_init(&parser, &arena, &scanner);
+  struct ast *ast = parser_parse(&parser);
+
+  struct vm vm;
+  vm_init(&vm);
+  if (!output_open(&vm.output, "/dev/null")) {
+    return EXIT_FAILURE;
+  }
+
+  chunk_t chunk;
+  chunk_init(&chunk);
+  globals_t globals;
+  globals_init(&globals);
+  gc_pause(&vm.gc);
+  chunk_write_from_ast(&chunk, ast, &globals, &vm.objects, &vm.strings);
+
+  reg_chunk_t reg_chunk;
+  reg_chunk_init(&reg_chunk);
+  if (!reg_chunk_write_from_ast(&reg_chunk, ast, &vm.objects, &vm.strings)) {
+    fputs("register compilation failed\n", stderr);
+    return EXIT_FAILURE;
+  }
+  gc_resume(&vm.gc);
+
+  printf("%-8s %12s %12s %12s %10s\n", "backend", "instructions", "code bytes",
+         "best (ms)", "ns/instr");
+
+  double best = 0;
+  for (uint32_t run = 0; run < BENCH_REPEAT; ++run) {
+    double start = _now();
+    vm_interpret(&vm, chunk);
+    double elapsed = _now() - start;
+    if (!run || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  _report("stack", _count_instructions(chunk), chunk->count, best);
+
+  for (uint32_t run = 0; run < BENCH_REPEAT; ++run) {
+    double start = _now();
+    vm_interpret_registers(&vm, reg_chunk);
+    double elapsed = _now() - start;
+    if (!run || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  _report("register", reg_chunk->count,
+          reg_chunk->count * sizeof(*reg_chunk->code), best);
+
+  reg_chunk_free(&reg_chunk);
+  chunk_free(&chunk);
+  globals_free(&globals);
+  vm_free(&vm);
+  ast_arena_free(&arena);
+  free(source);
+  return EXIT_SUCCESS;
+}
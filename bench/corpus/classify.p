@@ -0,0 +1,45 @@
+// Classifies characters and numbers through long chains of IF statements,
+// the way CASE statements compile once the language has them.
+FUNCTION CharClass(c : CHAR) RETURNS INTEGER
+  IF c >= 'a' AND c <= 'z' THEN RETURN 1 ENDIF
+  IF c >= 'A' AND c <= 'Z' THEN RETURN 2 ENDIF
+  IF c >= '0' AND c <= '9' THEN RETURN 3 ENDIF
+  IF c = ' ' THEN RETURN 4 ENDIF
+  IF c = '.' OR c = ',' OR c = ';' OR c = ':' THEN RETURN 5 ENDIF
+  IF c = '(' OR c = ')' THEN RETURN 6 ENDIF
+  RETURN 7
+ENDFUNCTION
+
+FUNCTION Grade(score : INTEGER) RETURNS INTEGER
+  IF score >= 90 THEN RETURN 5 ENDIF
+  IF score >= 80 THEN RETURN 4 ENDIF
+  IF score >= 70 THEN RETURN 3 ENDIF
+  IF score >= 60 THEN RETURN 2 ENDIF
+  IF score >= 50 THEN RETURN 1 ENDIF
+  RETURN 0
+ENDFUNCTION
+
+FUNCTION Weekday(day : INTEGER) RETURNS INTEGER
+  IF day = 0 THEN RETURN 0 ENDIF
+  IF day = 1 THEN RETURN 1 ENDIF
+  IF day = 2 THEN RETURN 1 ENDIF
+  IF day = 3 THEN RETURN 1 ENDIF
+  IF day = 4 THEN RETURN 1 ENDIF
+  IF day = 5 THEN RETURN 1 ENDIF
+  RETURN 0
+ENDFUNCTION
+
+FUNCTION Classify(i : INTEGER) RETURNS INTEGER
+  DECLARE chars : INTEGER
+  chars <- CharClass('a') + CharClass('Q') + CharClass('7') + CharClass(';')
+  RETURN chars + CharClass('~') + Grade(i MOD 101) + Weekday(i MOD 7)
+ENDFUNCTION
+
+FUNCTION Total(low : INTEGER, high : INTEGER) RETURNS INTEGER
+  IF low = high THEN RETURN Classify(low) ENDIF
+  DECLARE middle : INTEGER
+  middle <- (low + high) DIV 2
+  RETURN Total(low, middle) + Total(middle + 1, high)
+ENDFUNCTION
+
+Total(1, 500000)
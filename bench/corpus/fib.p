@@ -0,0 +1,7 @@
+// Recursive Fibonacci: call and return overhead with integer arithmetic.
+FUNCTION Fib(n : INTEGER) RETURNS INTEGER
+  IF n < 2 THEN RETURN n ENDIF
+  RETURN Fib(n - 1) + Fib(n - 2)
+ENDFUNCTION
+
+Fib(32)
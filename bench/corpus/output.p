@@ -0,0 +1,13 @@
+// Prints the numbers from one to a million, one per line, by splitting the
+// range in half: the run time is mostly formatting and writing output.
+FUNCTION Print(low : INTEGER, high : INTEGER) RETURNS INTEGER
+  IF low = high THEN
+    low
+    RETURN 1
+  ENDIF
+  DECLARE middle : INTEGER
+  middle <- (low + high) DIV 2
+  RETURN Print(low, middle) + Print(middle + 1, high)
+ENDFUNCTION
+
+Print(1, 1000000)
@@ -0,0 +1,25 @@
+// Counts primes by trial division. There are no loops yet, so ranges are
+// walked by splitting them in half, which keeps the call depth logarithmic.
+FUNCTION HasDivisor(n : INTEGER, d : INTEGER) RETURNS BOOLEAN
+  IF d * d > n THEN RETURN FALSE ENDIF
+  IF n MOD d = 0 THEN RETURN TRUE ENDIF
+  RETURN HasDivisor(n, d + 2)
+ENDFUNCTION
+
+FUNCTION IsPrime(n : INTEGER) RETURNS BOOLEAN
+  IF n < 2 THEN RETURN FALSE ENDIF
+  IF n MOD 2 = 0 THEN RETURN n = 2 ENDIF
+  RETURN NOT HasDivisor(n, 3)
+ENDFUNCTION
+
+FUNCTION CountPrimes(low : INTEGER, high : INTEGER) RETURNS INTEGER
+  IF low = high THEN
+    IF IsPrime(low) THEN RETURN 1 ENDIF
+    RETURN 0
+  ENDIF
+  DECLARE middle : INTEGER
+  middle <- (low + high) DIV 2
+  RETURN CountPrimes(low, middle) + CountPrimes(middle + 1, high)
+ENDFUNCTION
+
+CountPrimes(1, 200000)
@@ -0,0 +1,72 @@
+// Bubble and insertion sort over eight two-digit values packed into one
+// INTEGER, one value per base-100 digit. There are no arrays or loops yet,
+// so the "array" is the packed integer and every pass is a recursive call.
+FUNCTION Scale(i : INTEGER) RETURNS INTEGER
+  IF i = 0 THEN RETURN 1 ENDIF
+  RETURN 100 * Scale(i - 1)
+ENDFUNCTION
+
+FUNCTION Get(packed : INTEGER, i : INTEGER) RETURNS INTEGER
+  RETURN packed DIV Scale(i) MOD 100
+ENDFUNCTION
+
+FUNCTION Swap(packed : INTEGER, i : INTEGER) RETURNS INTEGER
+  DECLARE x : INTEGER
+  DECLARE y : INTEGER
+  x <- Get(packed, i)
+  y <- Get(packed, i + 1)
+  RETURN packed + (y - x) * Scale(i) + (x - y) * Scale(i + 1)
+ENDFUNCTION
+
+FUNCTION BubblePass(packed : INTEGER, i : INTEGER, n : INTEGER) RETURNS INTEGER
+  IF i >= n - 1 THEN RETURN packed ENDIF
+  IF Get(packed, i) > Get(packed, i + 1) THEN
+    RETURN BubblePass(Swap(packed, i), i + 1, n)
+  ENDIF
+  RETURN BubblePass(packed, i + 1, n)
+ENDFUNCTION
+
+FUNCTION BubbleSort(packed : INTEGER, n : INTEGER) RETURNS INTEGER
+  IF n < 2 THEN RETURN packed ENDIF
+  RETURN BubbleSort(BubblePass(packed, 0, n), n - 1)
+ENDFUNCTION
+
+FUNCTION Sink(packed : INTEGER, i : INTEGER) RETURNS INTEGER
+  IF i = 0 THEN RETURN packed ENDIF
+  IF Get(packed, i - 1) > Get(packed, i) THEN
+    RETURN Sink(Swap(packed, i - 1), i - 1)
+  ENDIF
+  RETURN packed
+ENDFUNCTION
+
+FUNCTION InsertionSort(packed : INTEGER, i : INTEGER) RETURNS INTEGER
+  IF i >= 8 THEN RETURN packed ENDIF
+  RETURN InsertionSort(Sink(packed, i), i + 1)
+ENDFUNCTION
+
+FUNCTION Hash(x : INTEGER) RETURNS INTEGER
+  RETURN (x * 2654435761 + 12345) MOD 4294967296 DIV 65536
+ENDFUNCTION
+
+FUNCTION Fill(round : INTEGER, i : INTEGER) RETURNS INTEGER
+  IF i = 8 THEN RETURN 0 ENDIF
+  RETURN Fill(round, i + 1) * 100 + Hash(round * 8 + i) MOD 100
+ENDFUNCTION
+
+FUNCTION Round(round : INTEGER) RETURNS INTEGER
+  DECLARE packed : INTEGER
+  DECLARE sorted : INTEGER
+  packed <- Fill(round, 0)
+  sorted <- BubbleSort(packed, 8)
+  IF sorted <> InsertionSort(packed, 1) THEN RETURN -1000000 ENDIF
+  RETURN Get(sorted, 8 - 1) - Get(sorted, 0)
+ENDFUNCTION
+
+FUNCTION Rounds(low : INTEGER, high : INTEGER) RETURNS INTEGER
+  IF low = high THEN RETURN Round(low) ENDIF
+  DECLARE middle : INTEGER
+  middle <- (low + high) DIV 2
+  RETURN Rounds(low, middle) + Rounds(middle + 1, high)
+ENDFUNCTION
+
+Rounds(1, 10000)
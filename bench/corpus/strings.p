@@ -0,0 +1,46 @@
+// Builds long strings with `&`, a piece at a time and by doubling, then
+// compares them.
+FUNCTION Word(i : INTEGER) RETURNS STRING
+  IF i MOD 4 = 0 THEN RETURN "alpha" ENDIF
+  IF i MOD 4 = 1 THEN RETURN "beta" ENDIF
+  IF i MOD 4 = 2 THEN RETURN "gamma" ENDIF
+  RETURN "delta"
+ENDFUNCTION
+
+FUNCTION Sentence(low : INTEGER, high : INTEGER) RETURNS STRING
+  IF low = high THEN RETURN Word(low) & ", " ENDIF
+  DECLARE middle : INTEGER
+  middle <- (low + high) DIV 2
+  RETURN Sentence(low, middle) & Sentence(middle + 1, high)
+ENDFUNCTION
+
+FUNCTION Repeat(s : STRING, n : INTEGER) RETURNS STRING
+  IF n = 1 THEN RETURN s ENDIF
+  RETURN Repeat(s, n DIV 2) & Repeat(s, n - n DIV 2)
+ENDFUNCTION
+
+FUNCTION Append(s : STRING, i : INTEGER, n : INTEGER) RETURNS STRING
+  IF i = n THEN RETURN s ENDIF
+  RETURN Append(s & Word(i) & ", ", i + 1, n)
+ENDFUNCTION
+
+FUNCTION Build(round : INTEGER) RETURNS BOOLEAN
+  DECLARE sentence : STRING
+  sentence <- Sentence(0, 399)
+  IF sentence <> Repeat("alpha, beta, gamma, delta, ", 100) THEN
+    RETURN FALSE
+  ENDIF
+  RETURN Append("", 0, 400) = sentence
+ENDFUNCTION
+
+FUNCTION Rounds(low : INTEGER, high : INTEGER) RETURNS INTEGER
+  IF low = high THEN
+    IF Build(low) THEN RETURN 1 ENDIF
+    RETURN 0
+  ENDIF
+  DECLARE middle : INTEGER
+  middle <- (low + high) DIV 2
+  RETURN Rounds(low, middle) + Rounds(middle + 1, high)
+ENDFUNCTION
+
+Rounds(1, 1000)
@@ -0,0 +1,144 @@
+#include "chunk.h"
+#include "value.h"
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_REPEAT 16U
+#define BENCH_BLOCKS 200000U
+
+#ifdef VM_COMPUTED_GOTO
+#define BENCH_DISPATCH "goto"
+#else
+#define BENCH_DISPATCH "switch"
+#endif
+
+struct bench_chunk {
+  const char *name;
+  void (*build)(chunk_t *chunk);
+};
+
+static void _write_constant(chunk_t *chunk, uint32_t constant) {
+  chunk_write(chunk, OPCODE_CONSTANT, (struct location){1});
+  chunk_write(chunk, constant, (struct location){1});
+}
+
+static void _build_integer(chunk_t *chunk) {
+  uint32_t one = chunk_add_constant(*chunk, VALUE_FROM_INTEGER(1));
+  uint32_t three = chunk_add_constant(*chunk, VALUE_FROM_INTEGER(3));
+
+  _write_constant(chunk, one);
+  for (uint32_t i = 0; i < BENCH_BLOCKS; ++i) {
+    _write_constant(chunk, three);
+    chunk_write(chunk, OPCODE_MUL, (struct location){1});
+    _write_constant(chunk, one);
+    chunk_write(chunk, OPCODE_ADD, (struct location){1});
+    _write_constant(chunk, three);
+    chunk_write(chunk, OPCODE_SUB, (struct location){1});
+  }
+  chunk_write(chunk, OPCODE_PRINT, (struct location){2});
+  chunk_write(chunk, OPCODE_RETURN, (struct location){2});
+  (*chunk)->max_stack = 2;
+}
+
+static void _build_real(chunk_t *chunk) {
+  uint32_t half = chunk_add_constant(*chunk, VALUE_FROM_REAL(0.5));
+  uint32_t two = chunk_add_constant(*chunk, VALUE_FROM_REAL(2.0));
+
+  _write_constant(chunk, two);
+  for (uint32_t i = 0; i < BENCH_BLOCKS; ++i) {
+    _write_constant(chunk, half);
+    chunk_write(chunk, OPCODE_ADD, (struct location){1});
+    _write_constant(chunk, two);
+    chunk_write(chunk, OPCODE_DIV, (struct location){1});
+    chunk_write(chunk, OPCODE_NEGATE, (struct location){1});
+  }
+  chunk_write(chunk, OPCODE_PRINT, (struct location){2});
+  chunk_write(chunk, OPCODE_RETURN, (struct location){2});
+  (*chunk)->max_stack = 2;
+}
+
+static void _build_logic(chunk_t *chunk) {
+  uint32_t one = chunk_add_constant(*chunk, VALUE_FROM_INTEGER(1));
+  uint32_t two = chunk_add_constant(*chunk, VALUE_FROM_INTEGER(2));
+
+  chunk_write(chunk, OPCODE_TRUE, (struct location){1});
+  for (uint32_t i = 0; i < BENCH_BLOCKS; ++i) {
+    chunk_write(chunk, OPCODE_FALSE, (struct location){1});
+    chunk_write(chunk, OPCODE_EQUAL, (struct location){1});
+    chunk_write(chunk, OPCODE_NOT, (struct location){1});
+    _write_constant(chunk, one);
+    _write_constant(chunk, two);
+    chunk_write(chunk, OPCODE_LESS, (struct location){1});
+    chunk_write(chunk, OPCODE_EQUAL, (struct location){1});
+  }
+  chunk_write(chunk, OPCODE_PRINT, (struct location){2});
+  chunk_write(chunk, OPCODE_RETURN, (struct location){2});
+  (*chunk)->max_stack = 3;
+}
+
+static const struct bench_chunk g_CHUNKS[] = {
+    {"integer", _build_integer},
+    {"real", _build_real},
+    {"logic", _build_logic},
+};
+
+static uint32_t _count_instructions(chunk_t chunk) {
+  uint32_t count = 0;
+  for (uint32_t offset = 0; offset < chunk->count; ++count) {
+    offset += chunk->code[offset] == OPCODE_CONSTANT ? 2 : 1;
+  }
+  return count;
+}
+
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  printf("%-8s %-8s %12s %12s %10s\n", "dispatch", "chunk", "instructions",
+         "best (ms)", "ns/instr");
+
+  for (size_t i = 0; i < sizeof(g_CHUNKS) / sizeof(*g_CHUNKS); ++i) {
+    // Each chunk ends by printing its result, which would otherwise flush to
+    // the terminal inside every timed run.
+    struct vm vm;
+    vm_init(&vm);
+    if (!output_open(&vm.output, "/dev/null")) {
+      vm_free(&vm);
+      return EXIT_FAILURE;
+    }
+
+    chunk_t chunk;
+    chunk_init(&chunk);
+    g_CHUNKS[i].build(&chunk);
+    uint32_t instructions = _count_instructions(chunk);
+
+    vm_interpret(&vm, chunk);
+
+    double best = 0;
+    for (uint32_t run = 0; run < BENCH_REPEAT; ++run) {
+      double start = _now();
+      if (vm_interpret(&vm, chunk) != INTERPRET_RESULT_OK) {
+        fprintf(stderr, "%s: interpret failed\n", g_CHUNKS[i].name);
+        return EXIT_FAILURE;
+      }
+      double elapsed = _now() - start;
+      if (!run || elapsed < best) {
+        best = elapsed;
+      }
+    }
+
+    printf("%-8s %-8s %12u %12.3f %10.3f\n", BENCH_DISPATCH, g_CHUNKS[i].name,
+           instructions, best * 1e3, best * 1e9 / instructions);
+
+    chunk_free(&chunk);
+    vm_free(&vm);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,466 @@
+#include "scanner.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_REPEAT 8U
+#define BENCH_WORDS (1U << 20)
+#define BENCH_PASSES 16U
+
+static const struct {
+  const char *text;
+  enum token_kind kind;
+} g_KEYWORDS[] = {
+#define KEYWORD(text, kind) {#text, kind},
+#include "keywords.def"
+#undef KEYWORD
+};
+
+#define KEYWORD_COUNT (sizeof(g_KEYWORDS) / sizeof(*g_KEYWORDS))
+
+struct word {
+  const char *start;
+  uint32_t length;
+};
+
+// The hand-written trie that the generated perfect hash replaced, kept
+// verbatim as the baseline.
+static enum token_kind _check_keyword(struct scanner scanner, uint32_t start,
+                                      uint32_t length, const char *rest,
+                                      enum token_kind kind) {
+  return scanner.current - scanner.start == start + length &&
+                 !memcmp(scanner.start + start, rest, length)
+             ? kind
+             : TOKEN_KIND_SP_IDENT;
+}
+
+static enum token_kind _trie_kind(struct scanner scanner) {
+  const uint16_t length = scanner.current - scanner.start;
+
+  switch (scanner.start[0]) {
+  case 'A':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'N':
+        return _check_keyword(scanner, 2, 1, "D", TOKEN_KIND_KW_AND);
+      case 'P':
+        return _check_keyword(scanner, 2, 4, "PEND", TOKEN_KIND_KW_APPEND);
+      case 'R':
+        return _check_keyword(scanner, 2, 3, "RAY", TOKEN_KIND_KW_ARRAY);
+      }
+    }
+    break;
+  case 'B':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'O':
+        return _check_keyword(scanner, 2, 5, "OLEAN", TOKEN_KIND_KW_BOOLEAN);
+      case 'Y':
+        if (length > 2) {
+          switch (scanner.start[2]) {
+          case 'V':
+            return _check_keyword(scanner, 3, 2, "AL", TOKEN_KIND_KW_BYVAL);
+          case 'R':
+            return _check_keyword(scanner, 3, 2, "EF", TOKEN_KIND_KW_BYREF);
+          }
+        }
+      }
+    }
+    break;
+  case 'C':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'A':
+        if (length > 2) {
+          switch (scanner.start[2]) {
+          case 'L':
+            return _check_keyword(scanner, 3, 1, "L", TOKEN_KIND_KW_CALL);
+          case 'S':
+            return _check_keyword(scanner, 3, 1, "E", TOKEN_KIND_KW_CASE);
+          }
+        }
+        break;
+      case 'H':
+        return _check_keyword(scanner, 2, 2, "AR", TOKEN_KIND_KW_CHAR);
+      case 'L':
+        if (length > 1) {
+          switch (scanner.start[2]) {
+          case 'A':
+            return _check_keyword(scanner, 3, 2, "SS", TOKEN_KIND_KW_CLASS);
+          case 'O':
+            return _check_keyword(scanner, 3, 6, "SEFILE",
+                                  TOKEN_KIND_KW_CLOSEFILE);
+          }
+        }
+        break;
+      case 'O':
+        return _check_keyword(scanner, 2, 6, "NSTANT", TOKEN_KIND_KW_CONSTANT);
+      }
+    }
+    break;
+  case 'D':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'A':
+        return _check_keyword(scanner, 2, 2, "TE", TOKEN_KIND_KW_DATE);
+      case 'E':
+        if (length > 2) {
+          switch (scanner.start[2]) {
+          case 'C':
+            return _check_keyword(scanner, 3, 4, "LARE", TOKEN_KIND_KW_DECLARE);
+          case 'F':
+            return _check_keyword(scanner, 3, 3, "INE", TOKEN_KIND_KW_DEFINE);
+          }
+        }
+        break;
+      case 'I':
+        return _check_keyword(scanner, 2, 1, "V", TOKEN_KIND_KW_DIV);
+      }
+    }
+    break;
+  case 'E':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'L':
+        return _check_keyword(scanner, 2, 2, "SE", TOKEN_KIND_KW_ELSE);
+      case 'N':
+        if (length > 3 && scanner.start[2] == 'D') {
+          switch (scanner.start[3]) {
+          case 'C':
+            if (length > 4) {
+              switch (scanner.start[4]) {
+              case 'A':
+                return _check_keyword(scanner, 5, 2, "SE",
+                                      TOKEN_KIND_KW_ENDCASE);
+              case 'L':
+                return _check_keyword(scanner, 5, 3, "ASS",
+                                      TOKEN_KIND_KW_ENDCLASS);
+              }
+            }
+            break;
+          case 'F':
+            return _check_keyword(scanner, 4, 7, "UNCTION",
+                                  TOKEN_KIND_KW_ENDFUNCTION);
+          case 'I':
+            return _check_keyword(scanner, 4, 1, "F", TOKEN_KIND_KW_ENDIF);
+          case 'P':
+            return _check_keyword(scanner, 4, 8, "ROCEDURE",
+                                  TOKEN_KIND_KW_ENDPROCEDURE);
+          case 'T':
+            return _check_keyword(scanner, 4, 3, "YPE", TOKEN_KIND_KW_ENDTYPE);
+          case 'W':
+            return _check_keyword(scanner, 4, 4, "HILE",
+                                  TOKEN_KIND_KW_ENDWHILE);
+          }
+        }
+      }
+    }
+    break;
+  case 'F':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'A':
+        return _check_keyword(scanner, 2, 3, "LSE", TOKEN_KIND_LT_FALSE);
+      case 'O':
+        return _check_keyword(scanner, 2, 1, "R", TOKEN_KIND_KW_FOR);
+      case 'U':
+        return _check_keyword(scanner, 2, 6, "NCTION", TOKEN_KIND_KW_FUNCTION);
+      }
+    }
+    break;
+  case 'G':
+    return _check_keyword(scanner, 1, 8, "ETRECORD", TOKEN_KIND_KW_GETRECORD);
+  case 'I':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'F':
+        return TOKEN_KIND_KW_IF;
+      case 'N':
+        if (length > 2) {
+          switch (scanner.start[2]) {
+          case 'H':
+            return _check_keyword(scanner, 3, 5, "ERITS",
+                                  TOKEN_KIND_KW_INHERITS);
+          case 'P':
+            return _check_keyword(scanner, 3, 2, "UT", TOKEN_KIND_KW_INPUT);
+          case 'T':
+            return _check_keyword(scanner, 3, 4, "EGER", TOKEN_KIND_KW_INTEGER);
+          }
+        }
+      }
+    }
+    break;
+  case 'M':
+    return _check_keyword(scanner, 1, 2, "OD", TOKEN_KIND_KW_MOD);
+  case 'N':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'E':
+        if (length > 2) {
+          switch (scanner.start[2]) {
+          case 'X':
+            return _check_keyword(scanner, 3, 1, "T", TOKEN_KIND_KW_NEXT);
+          case 'W':
+            return TOKEN_KIND_KW_NEW;
+          }
+        }
+      case 'O':
+        return _check_keyword(scanner, 2, 1, "T", TOKEN_KIND_KW_NOT);
+      }
+    }
+    break;
+  case 'O':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'P':
+        return _check_keyword(scanner, 2, 6, "ENFILE", TOKEN_KIND_KW_OPENFILE);
+      case 'R':
+        return TOKEN_KIND_KW_OR;
+      case 'T':
+        return _check_keyword(scanner, 2, 7, "HERWISE",
+                              TOKEN_KIND_KW_OTHERWISE);
+      case 'U':
+        return _check_keyword(scanner, 2, 4, "TPUT", TOKEN_KIND_KW_OUTPUT);
+      }
+    }
+    break;
+  case 'P':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'R':
+        if (length > 2) {
+          switch (scanner.start[2]) {
+          case 'O':
+            return _check_keyword(scanner, 3, 6, "CEDURE",
+                                  TOKEN_KIND_KW_PROCEDURE);
+          case 'I':
+            return _check_keyword(scanner, 3, 4, "VATE", TOKEN_KIND_KW_PRIVATE);
+          }
+          break;
+        }
+      case 'U':
+        if (length > 2) {
+          switch (scanner.start[2]) {
+          case 'B':
+            return _check_keyword(scanner, 3, 3, "LIC", TOKEN_KIND_KW_PUBLIC);
+          case 'T':
+            return _check_keyword(scanner, 3, 6, "RECORD",
+                                  TOKEN_KIND_KW_PUTRECORD);
+          }
+          break;
+        }
+      }
+    }
+    break;
+  case 'R':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'A':
+        return _check_keyword(scanner, 2, 4, "NDOM", TOKEN_KIND_KW_RANDOM);
+      case 'E':
+        if (length > 2) {
+          switch (scanner.start[2]) {
+          case 'A':
+            if (length > 3) {
+              switch (scanner.start[3]) {
+              case 'D':
+                if (length > 4) {
+                  return _check_keyword(scanner, 4, 4, "FILE",
+                                        TOKEN_KIND_KW_READFILE);
+                }
+                return _check_keyword(scanner, 4, 0, "", TOKEN_KIND_KW_READ);
+              case 'L':
+                return _check_keyword(scanner, 4, 0, "", TOKEN_KIND_KW_REAL);
+                break;
+              }
+            }
+            break;
+          case 'P':
+            return _check_keyword(scanner, 3, 3, "EAT", TOKEN_KIND_KW_REPEAT);
+          case 'T':
+            if (length == 6) {
+              return _check_keyword(scanner, 3, 3, "URN", TOKEN_KIND_KW_RETURN);
+            }
+            if (length > 6) {
+              return _check_keyword(scanner, 3, 4, "URNS",
+                                    TOKEN_KIND_KW_RETURNS);
+            }
+          }
+        }
+        break;
+      }
+    }
+    break;
+  case 'S':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'E':
+        return _check_keyword(scanner, 2, 2, "EK", TOKEN_KIND_KW_SEEK);
+      case 'T':
+        if (length > 2) {
+          switch (scanner.start[2]) {
+          case 'E':
+            return _check_keyword(scanner, 3, 1, "P", TOKEN_KIND_KW_STEP);
+          case 'R':
+            return _check_keyword(scanner, 3, 3, "ING", TOKEN_KIND_KW_STRING);
+          }
+        }
+        break;
+      case 'U':
+        return _check_keyword(scanner, 2, 3, "PER", TOKEN_KIND_KW_SUPER);
+      }
+    }
+    break;
+  case 'T':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'H':
+        return _check_keyword(scanner, 2, 2, "EN", TOKEN_KIND_KW_THEN);
+      case 'R':
+        return _check_keyword(scanner, 2, 2, "UE", TOKEN_KIND_LT_TRUE);
+      case 'Y':
+        return _check_keyword(scanner, 2, 2, "PE", TOKEN_KIND_KW_TYPE);
+      }
+    }
+    break;
+  case 'U':
+    return _check_keyword(scanner, 1, 4, "NTIL", TOKEN_KIND_KW_UNTIL);
+  case 'W':
+    if (length > 1) {
+      switch (scanner.start[1]) {
+      case 'H':
+        return _check_keyword(scanner, 2, 3, "ILE", TOKEN_KIND_KW_WHILE);
+      case 'R':
+        if (length == 5) {
+          return _check_keyword(scanner, 2, 3, "ITE", TOKEN_KIND_KW_WRITE);
+        }
+        if (length > 5) {
+          return _check_keyword(scanner, 2, 7, "ITEFILE",
+                                TOKEN_KIND_KW_WRITEFILE);
+        }
+      }
+    }
+    break;
+  }
+  return TOKEN_KIND_SP_IDENT;
+}
+
+static enum token_kind _hash_kind(struct scanner scanner) {
+  return scanner_keyword_kind(scanner.start,
+                              (uint32_t)(scanner.current - scanner.start));
+}
+
+static char *_generate(struct word *words) {
+  static const char g_IDENT[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+  char *text = malloc(BENCH_WORDS * 24);
+  char *current = text;
+  srand(1);
+  for (uint32_t i = 0; i < BENCH_WORDS; ++i) {
+    uint32_t length;
+    if (rand() % 2) {
+      const char *keyword = g_KEYWORDS[rand() % KEYWORD_COUNT].text;
+      length = strlen(keyword);
+      memcpy(current, keyword, length);
+      // Near misses: a keyword with one character changed or appended.
+      switch (rand() % 4) {
+      case 0:
+        current[rand() % length] = 'x';
+        break;
+      case 1:
+        current[length++] = 'S';
+        break;
+      }
+    } else {
+      length = 1 + rand() % 14;
+      for (uint32_t j = 0; j < length; ++j) {
+        current[j] = g_IDENT[rand() % (j ? 63 : 53)];
+      }
+    }
+    current[length] = '\0';
+    words[i] = (struct word){current, length};
+    current += length + 1;
+  }
+  return text;
+}
+
+static enum token_kind _reference_kind(struct word word) {
+  for (uint32_t i = 0; i < KEYWORD_COUNT; ++i) {
+    if (strlen(g_KEYWORDS[i].text) == word.length &&
+        !memcmp(g_KEYWORDS[i].text, word.start, word.length)) {
+      return g_KEYWORDS[i].kind;
+    }
+  }
+  return TOKEN_KIND_SP_IDENT;
+}
+
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static double _measure(const struct word *words,
+                       enum token_kind (*kind)(struct scanner),
+                       uint64_t *keywords) {
+  double best = 0;
+  for (uint32_t run = 0; run < BENCH_REPEAT; ++run) {
+    *keywords = 0;
+    double start = _now();
+    for (uint32_t pass = 0; pass < BENCH_PASSES; ++pass) {
+      for (uint32_t i = 0; i < BENCH_WORDS; ++i) {
+        struct scanner scanner = {.start = words[i].start,
+                                  .current = words[i].start + words[i].length,
+                                  .line_start = words[i].start,
+                                  .line = 1};
+        *keywords += kind(scanner) != TOKEN_KIND_SP_IDENT;
+      }
+    }
+    double elapsed = _now() - start;
+    if (!run || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+int main(void) {
+  struct word *words = malloc(BENCH_WORDS * sizeof(struct word));
+  char *text = _generate(words);
+
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < BENCH_WORDS; ++i) {
+    struct scanner scanner = {.start = words[i].start,
+                              .current = words[i].start + words[i].length,
+                              .line_start = words[i].start,
+                              .line = 1};
+    enum token_kind expected = _reference_kind(words[i]);
+    if (_hash_kind(scanner) != expected) {
+      fprintf(stderr, "%s: perfect hash disagrees with keywords.def\n",
+              words[i].start);
+      return EXIT_FAILURE;
+    }
+    mismatches += _trie_kind(scanner) != expected;
+  }
+
+  printf("%-8s %12s %10s %10s\n", "kind", "keywords", "best (ms)", "ns/word");
+  const struct {
+    const char *name;
+    enum token_kind (*kind)(struct scanner);
+  } g_RECOGNIZERS[] = {{"trie", _trie_kind}, {"hash", _hash_kind}};
+  for (uint32_t i = 0; i < 2; ++i) {
+    uint64_t keywords;
+    double best = _measure(words, g_RECOGNIZERS[i].kind, &keywords);
+    printf("%-8s %12llu %10.3f %10.2f\n", g_RECOGNIZERS[i].name,
+           (unsigned long long)keywords, best * 1e3,
+           best * 1e9 / ((double)BENCH_WORDS * BENCH_PASSES));
+  }
+  printf("trie disagrees with keywords.def on %u of %u words\n", mismatches,
+         BENCH_WORDS);
+
+  free(text);
+  free(words);
+  return EXIT_SUCCESS;
+}
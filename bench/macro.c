@@ -0,0 +1,429 @@
+#include "ast.h"
+#include "chunk.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "peephole.h"
+#include "scanner.h"
+#include "source.h"
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#ifndef CAMPSEUDO_CORPUS_DIR
+#define CAMPSEUDO_CORPUS_DIR "bench/corpus"
+#endif
+
+#define BENCH_REPEAT 5U
+#define BENCH_THRESHOLD 5.0
+#define BENCH_FLOOR_MS 0.1
+#define BENCH_FLOOR_RSS_KB 256.0
+#define BENCH_NAME_MAX 64U
+#define BENCH_PATH_MAX 4096U
+#define BENCH_LINE_MAX 512U
+
+static const char *g_CORPUS[] = {
+    "fib", "primes", "sort", "strings", "classify", "output",
+};
+
+enum bench_phase : uint8_t {
+  BENCH_PHASE_SCAN,
+  BENCH_PHASE_PARSE,
+  BENCH_PHASE_COMPILE,
+  BENCH_PHASE_RUN,
+  BENCH_PHASE_COUNT,
+};
+
+static const char *g_PHASE_NAMES[] = {"scan", "parse", "compile", "run"};
+
+// Best wall time of each phase in seconds. Each program is measured by a
+// child process, so `peak_rss` is that program's own high-water mark.
+struct bench_result {
+  double phases[BENCH_PHASE_COUNT];
+  uint64_t instructions;
+  long peak_rss;
+};
+
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static char *_read_file(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  rewind(file);
+  char *source = malloc(size + 1);
+  if (source && fread(source, 1, size, file) != (size_t)size) {
+    free(source);
+    source = NULL;
+  }
+  fclose(file);
+  if (source) {
+    source[size] = '\0';
+  }
+  return source;
+}
+
+static void _scan(const char *source) {
+  struct scanner scanner;
+  scanner_init(&scanner, source);
+  while (scanner_scan_token(&scanner).kind != TOKEN_KIND_SP_EOF) {
+  }
+}
+
+// Runs every phase once on a fresh VM, storing the time of each in `times`.
+// Parsing pulls tokens from the scanner, so the parse phase is the parse
+// time less the scan time. Counting instructions goes through the opcode
+// pair loop, so those runs are not timed.
+static bool _measure(const char *source, double times[BENCH_PHASE_COUNT],
+                     uint64_t *instructions) {
+  double start = _now();
+  _scan(source);
+  times[BENCH_PHASE_SCAN] = _now() - start;
+
+  struct scanner scanner;
+  struct parser parser;
+  struct ast_arena arena;
+  start = _now();
+  scanner_init(&scanner, source);
+  ast_arena_new(&arena);
+  parser_init(&parser, &arena, &scanner);
+  struct ast *ast = parser_parse(&parser);
+  times[BENCH_PHASE_PARSE] = _now() - start - times[BENCH_PHASE_SCAN];
+  if (times[BENCH_PHASE_PARSE] < 0) {
+    times[BENCH_PHASE_PARSE] = 0;
+  }
+  if (parser.had_error) {
+    ast_arena_free(&arena);
+    return false;
+  }
+
+  // The program's own output would swamp the report, but is still written.
+  struct vm vm;
+  vm_init(&vm);
+  if (!output_open(&vm.output, "/dev/null")) {
+    vm_free(&vm);
+    ast_arena_free(&arena);
+    return false;
+  }
+  chunk_t chunk;
+  globals_t globals;
+  start = _now();
+  ast = optimizer_run(&arena, ast, OPTIMIZE_LEVEL_PEEPHOLE);
+  chunk_init(&chunk);
+  globals_init(&globals);
+  gc_pause(&vm.gc);
+  bool compiled =
+      chunk_write_from_ast(&chunk, ast, &globals, &vm.objects, &vm.strings);
+  if (compiled) {
+    peephole_run(chunk);
+  }
+  gc_resume(&vm.gc);
+  times[BENCH_PHASE_COMPILE] = _now() - start;
+
+  bool ok = compiled;
+  if (ok) {
+    if (instructions) {
+      vm_count_opcode_pairs(&vm);
+    }
+    start = _now();
+    ok = vm_interpret(&vm, chunk) == INTERPRET_RESULT_OK;
+    times[BENCH_PHASE_RUN] = _now() - start;
+  }
+  if (ok && instructions) {
+    *instructions = 1;
+    for (uint32_t i = 0; i < OPCODE_COUNT * OPCODE_COUNT; ++i) {
+      *instructions += vm.opcode_pairs[i];
+    }
+  }
+
+  chunk_free(&chunk);
+  globals_free(&globals);
+  vm_free(&vm);
+  ast_arena_free(&arena);
+  return ok;
+}
+
+static bool _bench(const char *source, uint32_t repeat,
+                   struct bench_result *result) {
+  double times[BENCH_PHASE_COUNT];
+  if (!_measure(source, times, &result->instructions)) {
+    return false;
+  }
+  // The program's error messages would swamp the report.
+  if (!freopen("/dev/null", "w", stderr)) {
+    return false;
+  }
+
+  for (uint32_t run = 0; run < repeat; ++run) {
+    if (!_measure(source, times, NULL)) {
+      return false;
+    }
+    for (uint32_t phase = 0; phase < BENCH_PHASE_COUNT; ++phase) {
+      if (!run || times[phase] < result->phases[phase]) {
+        result->phases[phase] = times[phase];
+      }
+    }
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  result->peak_rss = usage.ru_maxrss;
+  return true;
+}
+
+static void _name(char *name, const char *path) {
+  const char *base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+  size_t length = strcspn(base, ".");
+  if (length >= BENCH_NAME_MAX) {
+    length = BENCH_NAME_MAX - 1;
+  }
+  memcpy(name, base, length);
+  name[length] = '\0';
+}
+
+// Measures the program at `path`, loaded the way campseudo loads it, and
+// prints its report line.
+static int _child(const char *path, uint32_t repeat) {
+  struct source_manager sources;
+  source_manager_init(&sources);
+  const struct source *source = source_manager_open(&sources, path);
+  struct bench_result result;
+  bool ok = source && _bench(source->chars, repeat, &result);
+  source_manager_free(&sources);
+  if (!ok) {
+    return EXIT_FAILURE;
+  }
+
+  char name[BENCH_NAME_MAX];
+  _name(name, path);
+  printf("    {\"name\": \"%s\"", name);
+  for (uint32_t phase = 0; phase < BENCH_PHASE_COUNT; ++phase) {
+    printf(", \"%s_ms\": %.3f", g_PHASE_NAMES[phase],
+           result.phases[phase] * 1e3);
+  }
+  double run = result.phases[BENCH_PHASE_RUN];
+  printf(", \"instructions\": %llu, \"instructions_per_second\": %.0f, "
+         "\"peak_rss_kb\": %ld}\n",
+         (unsigned long long)result.instructions,
+         run > 0 ? result.instructions / run : 0.0, result.peak_rss);
+  return EXIT_SUCCESS;
+}
+
+// Runs `self --child` on `path` through the shell and reads back its line.
+static bool _run_child(const char *self, const char *path, uint32_t repeat,
+                       char *line) {
+  if (strchr(self, '\'') || strchr(path, '\'')) {
+    return false;
+  }
+  char command[2 * BENCH_PATH_MAX];
+  snprintf(command, sizeof(command), "'%s' --child --repeat=%u '%s'", self,
+           repeat, path);
+  fflush(stdout);
+  FILE *child = popen(command, "r");
+  if (!child) {
+    return false;
+  }
+  bool ok = fgets(line, BENCH_LINE_MAX, child) != NULL;
+  return !pclose(child) && ok;
+}
+
+static int _run(const char *self, const char **paths, uint32_t count,
+                uint32_t repeat) {
+  const char *corpus[sizeof(g_CORPUS) / sizeof(*g_CORPUS)];
+  char storage[sizeof(g_CORPUS) / sizeof(*g_CORPUS)][BENCH_PATH_MAX];
+  if (!count) {
+    for (uint32_t i = 0; i < sizeof(g_CORPUS) / sizeof(*g_CORPUS); ++i) {
+      snprintf(storage[i], BENCH_PATH_MAX, "%s/%s.p", CAMPSEUDO_CORPUS_DIR,
+               g_CORPUS[i]);
+      corpus[count++] = storage[i];
+    }
+    paths = corpus;
+  }
+
+  int status = EXIT_SUCCESS;
+  bool first = true;
+  puts("{\n  \"benchmarks\": [");
+  for (uint32_t i = 0; i < count; ++i) {
+    char line[BENCH_LINE_MAX];
+    if (!_run_child(self, paths[i], repeat, line)) {
+      fprintf(stderr, "%s: failed to compile or run\n", paths[i]);
+      status = EXIT_FAILURE;
+      continue;
+    }
+    line[strcspn(line, "\n")] = '\0';
+    printf("%s%s", first ? "" : ",\n", line);
+    first = false;
+  }
+  puts("\n  ]\n}");
+  return status;
+}
+
+// One benchmark as read back from a report. The reader only understands
+// the layout `_child` writes: one object per line, keys in a fixed order.
+struct bench_entry {
+  char name[BENCH_NAME_MAX];
+  double phases[BENCH_PHASE_COUNT];
+  double instructions_per_second;
+  long peak_rss;
+};
+
+static uint32_t _read_report(const char *path, struct bench_entry **entries) {
+  char *text = _read_file(path);
+  if (!text) {
+    return 0;
+  }
+
+  uint32_t count = 0, capacity = 0;
+  *entries = NULL;
+  for (char *line = strstr(text, "{\"name\""); line;
+       line = strstr(line + 1, "{\"name\"")) {
+    struct bench_entry entry;
+    unsigned long long instructions;
+    if (sscanf(line,
+               "{\"name\": \"%63[^\"]\", \"scan_ms\": %lf, \"parse_ms\": %lf, "
+               "\"compile_ms\": %lf, \"run_ms\": %lf, \"instructions\": %llu, "
+               "\"instructions_per_second\": %lf, \"peak_rss_kb\": %ld}",
+               entry.name, &entry.phases[BENCH_PHASE_SCAN],
+               &entry.phases[BENCH_PHASE_PARSE],
+               &entry.phases[BENCH_PHASE_COMPILE],
+               &entry.phases[BENCH_PHASE_RUN], &instructions,
+               &entry.instructions_per_second, &entry.peak_rss) != 8) {
+      continue;
+    }
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 8;
+      *entries = realloc(*entries, capacity * sizeof(struct bench_entry));
+    }
+    (*entries)[count++] = entry;
+  }
+  free(text);
+  return count;
+}
+
+// Prints one metric and returns whether it got worse by more than
+// `threshold` percent and by more than `floor`, which keeps timer noise on
+// phases that take microseconds from counting. `higher_is_better` flips the
+// direction.
+static bool _compare_metric(const char *name, const char *metric, double base,
+                            double current, double threshold, double floor,
+                            bool higher_is_better) {
+  double change = base > 0 ? (current - base) / base * 100 : 0;
+  double worse = higher_is_better ? base - current : current - base;
+  bool regressed =
+      base > 0 && worse > floor && worse > base * threshold / 100;
+  printf("%-12s %-12s %14.3f %14.3f %+8.1f%%%s\n", name, metric, base, current,
+         change, regressed ? "  REGRESSION" : "");
+  return regressed;
+}
+
+static int _compare(const char *base_path, const char *current_path,
+                    double threshold) {
+  struct bench_entry *base, *current;
+  uint32_t base_count = _read_report(base_path, &base);
+  uint32_t current_count = _read_report(current_path, &current);
+  if (!base_count || !current_count) {
+    fprintf(stderr, "Could not read benchmarks from \"%s\" and \"%s\".\n",
+            base_path, current_path);
+    free(base);
+    free(current);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-12s %-12s %14s %14s %9s\n", "benchmark", "metric", "base",
+         "current", "change");
+  uint32_t regressions = 0;
+  for (uint32_t i = 0; i < current_count; ++i) {
+    const struct bench_entry *now = current + i, *then = NULL;
+    for (uint32_t j = 0; j < base_count && !then; ++j) {
+      if (!strcmp(base[j].name, now->name)) {
+        then = base + j;
+      }
+    }
+    if (!then) {
+      printf("%-12s (new)\n", now->name);
+      continue;
+    }
+
+    for (uint32_t phase = 0; phase < BENCH_PHASE_COUNT; ++phase) {
+      char metric[16];
+      snprintf(metric, sizeof(metric), "%s_ms", g_PHASE_NAMES[phase]);
+      regressions +=
+          _compare_metric(now->name, metric, then->phases[phase],
+                          now->phases[phase], threshold, BENCH_FLOOR_MS, false);
+    }
+    regressions += _compare_metric(
+        now->name, "Minstr/s", then->instructions_per_second * 1e-6,
+        now->instructions_per_second * 1e-6, threshold, 0, true);
+    regressions +=
+        _compare_metric(now->name, "peak_rss_kb", then->peak_rss,
+                        now->peak_rss, threshold, BENCH_FLOOR_RSS_KB, false);
+  }
+
+  printf("%u regression%s over %.1f%%\n", regressions,
+         regressions == 1 ? "" : "s", threshold);
+  free(base);
+  free(current);
+  return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void _usage(void) {
+  fputs("Usage: bench_macro [--repeat=N] [--output=PATH] [path]...\n"
+        "       bench_macro --compare BASE CURRENT [--threshold=PERCENT]\n",
+        stderr);
+}
+
+int main(int argc, const char *argv[]) {
+  uint32_t repeat = BENCH_REPEAT;
+  double threshold = BENCH_THRESHOLD;
+  bool compare = false;
+  bool child = false;
+  const char *paths[argc];
+  uint32_t count = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strncmp(argv[i], "--repeat=", 9)) {
+      repeat = strtoul(argv[i] + 9, NULL, 10);
+    } else if (!strncmp(argv[i], "--threshold=", 12)) {
+      threshold = strtod(argv[i] + 12, NULL);
+    } else if (!strncmp(argv[i], "--output=", 9)) {
+      if (!freopen(argv[i] + 9, "w", stdout)) {
+        fprintf(stderr, "Could not open \"%s\".\n", argv[i] + 9);
+        return EXIT_FAILURE;
+      }
+    } else if (!strcmp(argv[i], "--compare")) {
+      compare = true;
+    } else if (!strcmp(argv[i], "--child")) {
+      child = true;
+    } else if (argv[i][0] == '-') {
+      _usage();
+      return EXIT_FAILURE;
+    } else {
+      paths[count++] = argv[i];
+    }
+  }
+
+  if (compare) {
+    if (count != 2) {
+      _usage();
+      return EXIT_FAILURE;
+    }
+    return _compare(paths[0], paths[1], threshold);
+  }
+  if (!repeat || (child && count != 1)) {
+    _usage();
+    return EXIT_FAILURE;
+  }
+  return child ? _child(paths[0], repeat)
+               : _run(argv[0], paths, count, repeat);
+}
@@ -0,0 +1,502 @@
+#include "ast.h"
+#include "chunk.h"
+#include "obj.h"
+#include "parser.h"
+#include "scanner.h"
+#include "table.h"
+#include "value.h"
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SEED 1U
+#define BENCH_WARMUP 3U
+#define BENCH_SAMPLES 15U
+#define BENCH_SOURCE_LINES 50000U
+#define BENCH_KEYS 100000U
+#define BENCH_KEY_WIDTH 24U
+#define BENCH_TABLE_SLOTS (1U << 16)
+#define BENCH_BLOCKS 100000U
+
+// One component under test. `setup` builds its input from BENCH_SEED and
+// `sample` times one pass over it, storing how many operations it did.
+// Samples must leave the state as they found it.
+struct micro {
+  const char *name;
+  const char *unit;
+  uint32_t arg;
+  void (*setup)(struct micro *micro);
+  double (*sample)(struct micro *micro, uint64_t *operations);
+  void (*teardown)(struct micro *micro);
+};
+
+struct key {
+  const char *chars;
+  uint32_t length, hash;
+};
+
+// Inputs shared by the benchmarks that are set up one at a time.
+static struct {
+  char *source;
+  uint64_t nodes;
+  char *text;
+  struct key *keys;
+  struct key *misses;
+  obj_t objects;
+  table_t strings;
+  obj_string_t *interned;
+  table_t table;
+  uint32_t count;
+  struct vm vm;
+  chunk_t chunk;
+} g_state;
+
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static void _generate_source(void) {
+  static const char *g_LINES[] = {
+      "v%u <- (v%u + %d) * v%u - %d\n",
+      "IF v%u > %d THEN v%u <- v%u DIV 2 ENDIF\n",
+      "s%u <- \"item \" & \"%d\" & s%u\n",
+      "CALL Update(v%u, %d, v%u + v%u)\n",
+  };
+  size_t capacity = (size_t)BENCH_SOURCE_LINES * 64;
+  g_state.source = malloc(capacity);
+  size_t length = 0;
+
+  srand(BENCH_SEED);
+  for (uint32_t i = 0; i < BENCH_SOURCE_LINES; ++i) {
+    uint32_t a = rand() % 100, b = rand() % 100, c = rand() % 100;
+    int x = rand() % 1000, y = rand() % 1000;
+    if (i % 8 == 0) {
+      length += snprintf(g_state.source + length, capacity - length,
+                         "DECLARE v%u : INTEGER\n", a);
+    }
+    const char *line = g_LINES[rand() % 4];
+    if (line == g_LINES[1]) {
+      length += snprintf(g_state.source + length, capacity - length, line, a,
+                         x, b, a);
+    } else if (line == g_LINES[2]) {
+      length += snprintf(g_state.source + length, capacity - length, line, a,
+                         x, b);
+    } else {
+      length += snprintf(g_state.source + length, capacity - length, line, a,
+                         b, x, c, y);
+    }
+  }
+}
+
+static void _free_source(struct micro *micro) {
+  free(g_state.source);
+}
+
+static void _setup_scan(struct micro *micro) {
+  _generate_source();
+}
+
+static double _sample_scan(struct micro *micro, uint64_t *operations) {
+  struct scanner scanner;
+  double start = _now();
+  scanner_init(&scanner, g_state.source);
+  uint64_t tokens = 0;
+  while (scanner_scan_token(&scanner).kind != TOKEN_KIND_SP_EOF) {
+    ++tokens;
+  }
+  double elapsed = _now() - start;
+  *operations = tokens;
+  return elapsed;
+}
+
+static uint64_t _count_nodes(const struct ast *ast) {
+  if (!ast) {
+    return 0;
+  }
+  if (ast->kind <= NODE_KIND_VARIABLE) {
+    return 1;
+  }
+  if (ast->kind <= NODE_KIND_GROUP) {
+    return 1 + _count_nodes(ast->as.expr);
+  }
+  if (ast->kind <= NODE_KIND_CALL) {
+    return 1 + _count_nodes(ast->as.binary.lhs) +
+           _count_nodes(ast->as.binary.rhs);
+  }
+
+  switch (ast->kind) {
+  case NODE_KIND_CALL_STMT:
+  case NODE_KIND_RETURN:
+    return 1 + _count_nodes(ast->as.expr);
+  case NODE_KIND_IF:
+    return 1 + _count_nodes(ast->as.branch.condition) +
+           _count_nodes(ast->as.branch.then) +
+           _count_nodes(ast->as.branch.otherwise);
+  case NODE_KIND_BLOCK:
+  case NODE_KIND_ARGUMENTS: {
+    uint64_t count = 0;
+    for (; ast; ast = ast->as.list.next) {
+      count += 1 + _count_nodes(ast->as.list.item);
+    }
+    return count;
+  }
+  default:
+    return 1 + _count_nodes(ast->as.variable.expr);
+  }
+}
+
+static struct ast *_parse(struct ast_arena *arena, bool *ok) {
+  struct scanner scanner;
+  struct parser parser;
+  scanner_init(&scanner, g_state.source);
+  ast_arena_new(arena);
+  parser_init(&parser, arena, &scanner);
+  struct ast *ast = parser_parse(&parser);
+  *ok = !parser.had_error;
+  return ast;
+}
+
+static void _setup_parse(struct micro *micro) {
+  _generate_source();
+  struct ast_arena arena;
+  bool ok;
+  g_state.nodes = _count_nodes(_parse(&arena, &ok));
+  ast_arena_free(&arena);
+  if (!ok) {
+    fputs("parse: generated source does not parse\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Includes the scanning the parser drives and the arena it allocates from.
+static double _sample_parse(struct micro *micro, uint64_t *operations) {
+  struct ast_arena arena;
+  bool ok;
+  double start = _now();
+  _parse(&arena, &ok);
+  double elapsed = _now() - start;
+  ast_arena_free(&arena);
+  *operations = g_state.nodes;
+  return elapsed;
+}
+
+static struct key *_generate_keys(char *text, const char *prefix) {
+  struct key *keys = malloc(BENCH_KEYS * sizeof(struct key));
+  for (uint32_t i = 0; i < BENCH_KEYS; ++i) {
+    char *chars = text + (size_t)i * BENCH_KEY_WIDTH;
+    int length = snprintf(chars, BENCH_KEY_WIDTH, "%s%u_%u", prefix,
+                          (uint32_t)rand(), i);
+    keys[i] = (struct key){chars, (uint32_t)length,
+                           table_hash(chars, (uint32_t)length)};
+  }
+  return keys;
+}
+
+static void _setup_keys(void) {
+  srand(BENCH_SEED);
+  g_state.text = malloc((size_t)BENCH_KEYS * BENCH_KEY_WIDTH * 2);
+  g_state.keys = _generate_keys(g_state.text, "k");
+  g_state.misses =
+      _generate_keys(g_state.text + (size_t)BENCH_KEYS * BENCH_KEY_WIDTH, "m");
+  g_state.objects = NULL;
+  table_init(&g_state.strings);
+  g_state.interned = malloc(BENCH_KEYS * sizeof(obj_string_t));
+}
+
+static void _free_keys(void) {
+  free(g_state.interned);
+  table_free(&g_state.strings);
+  objects_free(&g_state.objects);
+  free(g_state.misses);
+  free(g_state.keys);
+  free(g_state.text);
+}
+
+static void _setup_intern(struct micro *micro) {
+  _setup_keys();
+  for (uint32_t i = 0; i < BENCH_KEYS; ++i) {
+    obj_string_copy(&g_state.objects, &g_state.strings, g_state.keys[i].chars,
+                    g_state.keys[i].length);
+  }
+}
+
+static void _teardown_intern(struct micro *micro) {
+  _free_keys();
+}
+
+// Interns every key into an empty table, so each one allocates.
+static double _sample_intern_new(struct micro *micro, uint64_t *operations) {
+  obj_t objects = NULL;
+  table_t strings;
+  table_init(&strings);
+  double start = _now();
+  for (uint32_t i = 0; i < BENCH_KEYS; ++i) {
+    obj_string_copy(&objects, &strings, g_state.keys[i].chars,
+                    g_state.keys[i].length);
+  }
+  double elapsed = _now() - start;
+  table_free(&strings);
+  objects_free(&objects);
+  *operations = BENCH_KEYS;
+  return elapsed;
+}
+
+// Interns keys that are already interned, so each one is a lookup.
+static double _sample_intern_hit(struct micro *micro, uint64_t *operations) {
+  double start = _now();
+  for (uint32_t i = 0; i < BENCH_KEYS; ++i) {
+    obj_string_copy(&g_state.objects, &g_state.strings, g_state.keys[i].chars,
+                    g_state.keys[i].length);
+  }
+  double elapsed = _now() - start;
+  *operations = BENCH_KEYS;
+  return elapsed;
+}
+
+// Inserts the first `count` interned keys into a table of BENCH_TABLE_SLOTS
+// slots. Reserving seven sixteenths of the slots fixes the capacity, which
+// then stays put up to the maximum load of seven eighths.
+static void _fill_table(table_t *table, uint32_t count) {
+  table_init(table);
+  table_reserve(table, BENCH_TABLE_SLOTS / 16 * 7);
+  for (uint32_t i = 0; i < count; ++i) {
+    table_insert(table, g_state.interned[i], TABLE_NIL);
+  }
+}
+
+static void _setup_table(struct micro *micro) {
+  _setup_keys();
+  g_state.count = BENCH_TABLE_SLOTS / 100 * micro->arg;
+  for (uint32_t i = 0; i < g_state.count; ++i) {
+    g_state.interned[i] =
+        obj_string_copy(&g_state.objects, &g_state.strings,
+                        g_state.keys[i].chars, g_state.keys[i].length);
+  }
+  _fill_table(&g_state.table, g_state.count);
+  if (g_state.table->capacity != BENCH_TABLE_SLOTS) {
+    fprintf(stderr, "%s: table grew to %u slots\n", micro->name,
+            g_state.table->capacity);
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void _teardown_table(struct micro *micro) {
+  table_free(&g_state.table);
+  _free_keys();
+}
+
+static double _sample_table_insert(struct micro *micro, uint64_t *operations) {
+  table_t table;
+  table_init(&table);
+  table_reserve(&table, BENCH_TABLE_SLOTS / 16 * 7);
+  double start = _now();
+  for (uint32_t i = 0; i < g_state.count; ++i) {
+    table_insert(&table, g_state.interned[i], TABLE_NIL);
+  }
+  double elapsed = _now() - start;
+  table_free(&table);
+  *operations = g_state.count;
+  return elapsed;
+}
+
+static double _sample_table_hit(struct micro *micro, uint64_t *operations) {
+  const struct key *keys = g_state.keys;
+  uint64_t found = 0;
+  double start = _now();
+  for (uint32_t i = 0; i < g_state.count; ++i) {
+    found += table_find_string(g_state.table, keys[i].chars, keys[i].length,
+                               keys[i].hash) != NULL;
+  }
+  double elapsed = _now() - start;
+  *operations = found;
+  return elapsed;
+}
+
+static double _sample_table_miss(struct micro *micro, uint64_t *operations) {
+  const struct key *misses = g_state.misses;
+  uint64_t missed = 0;
+  double start = _now();
+  for (uint32_t i = 0; i < g_state.count; ++i) {
+    missed += !table_find_string(g_state.table, misses[i].chars,
+                                 misses[i].length, misses[i].hash);
+  }
+  double elapsed = _now() - start;
+  *operations = missed;
+  return elapsed;
+}
+
+// Straight-line chunks of one repeated pattern, ending in POP and RETURN.
+// `arg` picks the pattern; each leaves the stack as it found it.
+enum dispatch_pattern : uint8_t {
+  DISPATCH_PATTERN_CONSTANT_POP,
+  DISPATCH_PATTERN_ADD_INT,
+  DISPATCH_PATTERN_ADD_QUICK,
+  DISPATCH_PATTERN_ADD_INT_CONST,
+  DISPATCH_PATTERN_GLOBAL,
+};
+
+static void _setup_dispatch(struct micro *micro) {
+  vm_init(&g_state.vm);
+  chunk_init(&g_state.chunk);
+  chunk_t *chunk = &g_state.chunk;
+  struct location location = {1};
+  uint32_t one = chunk_add_constant(*chunk, VALUE_FROM_INTEGER(1));
+
+  chunk_write(chunk, OPCODE_CONSTANT, location);
+  chunk_write(chunk, one, location);
+  for (uint32_t i = 0; i < BENCH_BLOCKS; ++i) {
+    switch (micro->arg) {
+    case DISPATCH_PATTERN_CONSTANT_POP:
+      chunk_write(chunk, OPCODE_CONSTANT, location);
+      chunk_write(chunk, one, location);
+      chunk_write(chunk, OPCODE_POP, location);
+      break;
+    case DISPATCH_PATTERN_ADD_INT:
+    case DISPATCH_PATTERN_ADD_QUICK:
+      chunk_write(chunk, OPCODE_CONSTANT, location);
+      chunk_write(chunk, one, location);
+      chunk_write(chunk,
+                  micro->arg == DISPATCH_PATTERN_ADD_INT ? OPCODE_ADD_INT
+                                                         : OPCODE_ADD,
+                  location);
+      break;
+    case DISPATCH_PATTERN_ADD_INT_CONST:
+      chunk_write(chunk, OPCODE_ADD_INT_CONST, location);
+      chunk_write(chunk, one, location);
+      chunk_write(chunk, OPCODE_ADD_INT_CONST, location);
+      chunk_write(chunk, one, location);
+      break;
+    case DISPATCH_PATTERN_GLOBAL:
+      chunk_write(chunk, OPCODE_SET_GLOBAL, location);
+      chunk_write(chunk, 0, location);
+      chunk_write(chunk, 0, location);
+      chunk_write(chunk, OPCODE_GET_GLOBAL, location);
+      chunk_write(chunk, 0, location);
+      chunk_write(chunk, 0, location);
+      break;
+    }
+  }
+  chunk_write(chunk, OPCODE_POP, location);
+  chunk_write(chunk, OPCODE_RETURN, location);
+  (*chunk)->globals = 1;
+  (*chunk)->max_stack = 2;
+}
+
+static void _teardown_dispatch(struct micro *micro) {
+  chunk_free(&g_state.chunk);
+  vm_free(&g_state.vm);
+}
+
+// Runs quickened code once warm-up has rewritten the generic opcodes.
+static double _sample_dispatch(struct micro *micro, uint64_t *operations) {
+  double start = _now();
+  enum interpret_result result = vm_interpret(&g_state.vm, g_state.chunk);
+  double elapsed = _now() - start;
+  if (result != INTERPRET_RESULT_OK) {
+    fprintf(stderr, "%s: interpret failed\n", micro->name);
+    exit(EXIT_FAILURE);
+  }
+  *operations = 2ULL * BENCH_BLOCKS + 3;
+  return elapsed;
+}
+
+#define TABLE_MICROS(load)                                                     \
+  {"table_insert/" #load "%", "inserts", load, _setup_table,                   \
+   _sample_table_insert, _teardown_table},                                     \
+      {"table_hit/" #load "%", "finds", load, _setup_table, _sample_table_hit, \
+       _teardown_table},                                                       \
+      {"table_miss/" #load "%", "finds", load, _setup_table,                   \
+       _sample_table_miss, _teardown_table}
+
+#define DISPATCH_MICRO(name, pattern)                                          \
+  {"dispatch/" name, "opcodes", DISPATCH_PATTERN_##pattern, _setup_dispatch,   \
+   _sample_dispatch, _teardown_dispatch}
+
+static struct micro g_MICROS[] = {
+    {"scan", "tokens", 0, _setup_scan, _sample_scan, _free_source},
+    {"parse", "nodes", 0, _setup_parse, _sample_parse, _free_source},
+    {"intern_new", "strings", 0, _setup_intern, _sample_intern_new,
+     _teardown_intern},
+    {"intern_hit", "strings", 0, _setup_intern, _sample_intern_hit,
+     _teardown_intern},
+    TABLE_MICROS(25),
+    TABLE_MICROS(50),
+    TABLE_MICROS(75),
+    TABLE_MICROS(87),
+    DISPATCH_MICRO("constant_pop", CONSTANT_POP),
+    DISPATCH_MICRO("add_int", ADD_INT),
+    DISPATCH_MICRO("add_quick", ADD_QUICK),
+    DISPATCH_MICRO("add_int_const", ADD_INT_CONST),
+    DISPATCH_MICRO("global", GLOBAL),
+};
+
+static int _compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// Sorts `values` and returns their median.
+static double _median(double *values, uint32_t count) {
+  qsort(values, count, sizeof(double), _compare_doubles);
+  return count % 2 ? values[count / 2]
+                   : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+// Median absolute deviation from `median`.
+static double _mad(const double *values, uint32_t count, double median) {
+  double deviations[BENCH_SAMPLES];
+  for (uint32_t i = 0; i < count; ++i) {
+    double deviation = values[i] - median;
+    deviations[i] = deviation < 0 ? -deviation : deviation;
+  }
+  return _median(deviations, count);
+}
+
+static bool _selected(const char *name, int argc, const char *argv[]) {
+  if (argc < 2) {
+    return true;
+  }
+  for (int i = 1; i < argc; ++i) {
+    if (strstr(name, argv[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int main(int argc, const char *argv[]) {
+  printf("%-24s %-8s %12s %12s %8s %10s\n", "benchmark", "unit", "operations",
+         "median (M/s)", "MAD", "ns/op");
+
+  for (size_t i = 0; i < sizeof(g_MICROS) / sizeof(*g_MICROS); ++i) {
+    struct micro *micro = g_MICROS + i;
+    if (!_selected(micro->name, argc, argv)) {
+      continue;
+    }
+
+    micro->setup(micro);
+    uint64_t operations = 0;
+    for (uint32_t run = 0; run < BENCH_WARMUP; ++run) {
+      micro->sample(micro, &operations);
+    }
+    double rates[BENCH_SAMPLES];
+    for (uint32_t run = 0; run < BENCH_SAMPLES; ++run) {
+      double elapsed = micro->sample(micro, &operations);
+      rates[run] = operations / elapsed;
+    }
+    micro->teardown(micro);
+
+    double median = _median(rates, BENCH_SAMPLES);
+    double mad = _mad(rates, BENCH_SAMPLES, median);
+    printf("%-24s %-8s %12llu %12.2f %7.2f%% %10.2f\n", micro->name,
+           micro->unit, (unsigned long long)operations, median * 1e-6,
+           mad / median * 100, 1e9 / median);
+  }
+
+  return EXIT_SUCCESS;
+}
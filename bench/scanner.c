@@ -0,0 +1,154 @@
+#include "scanner.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_REPEAT 8U
+#define BENCH_BYTES (16U * 1024U * 1024U)
+
+struct bench_input {
+  const char *name;
+  uint32_t (*emit)(char *dest);
+};
+
+static const char *g_ISA_NAMES[] = {"scalar", "sse2", "avx2"};
+
+static uint32_t _emit_mixed(char *dest) {
+  static const char *g_LINES[] = {
+      "DECLARE counter_total : INTEGER\n",
+      "counter_total <- counter_total + 12345 * (value_index - 7)\n",
+      "    message <- \"Processed \" & name & \" records\"  // progress\n",
+      "IF average_score >= 3.75 AND NOT finished THEN\n",
+  };
+  const char *line = g_LINES[rand() % 4];
+  size_t length = strlen(line);
+  memcpy(dest, line, length);
+  return length;
+}
+
+static uint32_t _emit_comments(char *dest) {
+  uint32_t length = 2 + rand() % 120;
+  memcpy(dest, "//", 2);
+  memset(dest + 2, 'c', length - 2);
+  dest[length] = '\n';
+  return length + 1;
+}
+
+static uint32_t _emit_strings(char *dest) {
+  uint32_t length = 2 + rand() % 200;
+  memset(dest, 's', length);
+  dest[0] = dest[length - 1] = '"';
+  dest[length / 2] = '\n';
+  dest[length] = ' ';
+  return length + 1;
+}
+
+static uint32_t _emit_identifiers(char *dest) {
+  uint32_t length = 1 + rand() % 40;
+  for (uint32_t i = 0; i < length; ++i) {
+    dest[i] = "abcdefghijklmnopqrstuvwxyz_0123456789"[rand() % (i ? 37 : 27)];
+  }
+  dest[length] = ' ';
+  return length + 1;
+}
+
+static uint32_t _emit_numbers(char *dest) {
+  uint32_t length = 1 + rand() % 18;
+  for (uint32_t i = 0; i < length; ++i) {
+    dest[i] = '0' + rand() % 10;
+  }
+  dest[length] = '\t';
+  return length + 1;
+}
+
+static const struct bench_input g_INPUTS[] = {
+    {"mixed", _emit_mixed},
+    {"comments", _emit_comments},
+    {"strings", _emit_strings},
+    {"idents", _emit_identifiers},
+    {"numbers", _emit_numbers},
+};
+
+static char *_generate(const struct bench_input *input, size_t *length) {
+  char *source = malloc(BENCH_BYTES + 512);
+  *length = 0;
+  srand(1);
+  while (*length < BENCH_BYTES) {
+    *length += input->emit(source + *length);
+  }
+  source[*length] = '\0';
+  return source;
+}
+
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static uint64_t _scan(const char *source, uint32_t *lines) {
+  struct scanner scanner;
+  scanner_init(&scanner, source);
+  uint64_t tokens = 0;
+  for (;;) {
+    struct token token = scanner_scan_token(&scanner);
+    if (token.kind == TOKEN_KIND_SP_EOF) {
+      break;
+    }
+    ++tokens;
+  }
+  *lines = scanner.line;
+  return tokens;
+}
+
+int main(void) {
+  printf("%-8s %-8s %12s %10s %10s\n", "input", "isa", "tokens", "best (ms)",
+         "MB/s");
+
+  for (size_t i = 0; i < sizeof(g_INPUTS) / sizeof(*g_INPUTS); ++i) {
+    size_t length;
+    char *source = _generate(g_INPUTS + i, &length);
+    uint64_t expected_tokens = 0;
+    uint32_t expected_lines = 0;
+
+    for (enum scanner_isa isa = SCANNER_ISA_SCALAR; isa <= SCANNER_ISA_AVX2;
+         ++isa) {
+      if (!scanner_use_isa(isa)) {
+        continue;
+      }
+
+      uint32_t lines;
+      uint64_t tokens = _scan(source, &lines);
+      if (isa == SCANNER_ISA_SCALAR) {
+        expected_tokens = tokens;
+        expected_lines = lines;
+      } else if (tokens != expected_tokens || lines != expected_lines) {
+        fprintf(stderr, "%s/%s: scanned %llu tokens on %u lines, expected "
+                        "%llu on %u\n",
+                g_INPUTS[i].name, g_ISA_NAMES[isa], (unsigned long long)tokens,
+                lines, (unsigned long long)expected_tokens, expected_lines);
+        return EXIT_FAILURE;
+      }
+
+      double best = 0;
+      for (uint32_t run = 0; run < BENCH_REPEAT; ++run) {
+        double start = _now();
+        _scan(source, &lines);
+        double elapsed = _now() - start;
+        if (!run || elapsed < best) {
+          best = elapsed;
+        }
+      }
+
+      printf("%-8s %-8s %12llu %10.3f %10.1f\n", g_INPUTS[i].name,
+             g_ISA_NAMES[isa], (unsigned long long)tokens, best * 1e3,
+             length / best / (1024.0 * 1024.0));
+    }
+
+    free(source);
+  }
+
+  return EXIT_SUCCESS;
+}
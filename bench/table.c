@@ -0,0 +1,144 @@
+#include "obj.h"
+#include "table.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_REPEAT 4U
+#define BENCH_KEYS (1U << 22)
+#define BENCH_KEY_WIDTH 24U
+
+enum bench_phase : uint8_t {
+  BENCH_PHASE_INTERN,
+  BENCH_PHASE_HIT,
+  BENCH_PHASE_MISS,
+  BENCH_PHASE_MEMBER,
+  BENCH_PHASE_DELETE,
+  BENCH_PHASE_REINSERT,
+  BENCH_PHASE_COUNT,
+};
+
+static const char *g_PHASE_NAMES[] = {
+    "intern", "hit", "miss", "member", "delete", "reinsert",
+};
+
+struct key {
+  const char *chars;
+  uint32_t length;
+};
+
+static char *_generate(struct key *keys, const char *prefix) {
+  char *text = malloc((size_t)BENCH_KEYS * BENCH_KEY_WIDTH);
+  for (uint32_t i = 0; i < BENCH_KEYS; ++i) {
+    char *chars = text + (size_t)i * BENCH_KEY_WIDTH;
+    int length = snprintf(chars, BENCH_KEY_WIDTH, "%s%u_%u", prefix,
+                          i * 2654435761U, i);
+    keys[i] = (struct key){chars, (uint32_t)length};
+  }
+  return text;
+}
+
+static double _now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static uint64_t _run(const struct key *keys, const struct key *misses,
+                     obj_string_t *strings, double *elapsed) {
+  obj_t objects = NULL;
+  table_t table;
+  table_init(&table);
+  uint64_t checksum = 0;
+
+  double start = _now();
+  for (uint32_t i = 0; i < BENCH_KEYS; ++i) {
+    strings[i] =
+        obj_string_copy(&objects, &table, keys[i].chars, keys[i].length);
+  }
+  elapsed[BENCH_PHASE_INTERN] = _now() - start;
+
+  start = _now();
+  for (uint32_t i = 0; i < BENCH_KEYS; ++i) {
+    checksum += obj_string_copy(&objects, &table, keys[i].chars,
+                                keys[i].length) == strings[i];
+  }
+  elapsed[BENCH_PHASE_HIT] = _now() - start;
+
+  start = _now();
+  for (uint32_t i = 0; i < BENCH_KEYS; ++i) {
+    uint32_t hash = table_hash(misses[i].chars, misses[i].length);
+    checksum +=
+        !table_find_string(table, misses[i].chars, misses[i].length, hash);
+  }
+  elapsed[BENCH_PHASE_MISS] = _now() - start;
+
+  start = _now();
+  for (uint32_t i = 0; i < BENCH_KEYS; ++i) {
+    struct value value;
+    checksum += table_member(table, strings[i], &value);
+  }
+  elapsed[BENCH_PHASE_MEMBER] = _now() - start;
+
+  start = _now();
+  for (uint32_t i = 0; i < BENCH_KEYS; i += 2) {
+    checksum += table_delete(table, strings[i]);
+  }
+  elapsed[BENCH_PHASE_DELETE] = _now() - start;
+
+  start = _now();
+  for (uint32_t i = 0; i < BENCH_KEYS; i += 2) {
+    checksum += table_insert(&table, strings[i], TABLE_NIL);
+  }
+  elapsed[BENCH_PHASE_REINSERT] = _now() - start;
+
+  table_free(&table);
+  while (objects) {
+    obj_t next = objects->next;
+    obj_free(objects);
+    objects = next;
+  }
+  return checksum;
+}
+
+int main(void) {
+  struct key *keys = malloc(BENCH_KEYS * sizeof(struct key));
+  struct key *misses = malloc(BENCH_KEYS * sizeof(struct key));
+  obj_string_t *strings = malloc(BENCH_KEYS * sizeof(obj_string_t));
+  char *key_text = _generate(keys, "k");
+  char *miss_text = _generate(misses, "m");
+
+  const uint64_t expected = 4ULL * BENCH_KEYS;
+  double best[BENCH_PHASE_COUNT] = {0};
+  for (uint32_t run = 0; run < BENCH_REPEAT; ++run) {
+    double elapsed[BENCH_PHASE_COUNT];
+    uint64_t checksum = _run(keys, misses, strings, elapsed);
+    if (checksum != expected) {
+      fprintf(stderr, "checksum %llu, expected %llu\n",
+              (unsigned long long)checksum, (unsigned long long)expected);
+      return EXIT_FAILURE;
+    }
+    for (uint32_t phase = 0; phase < BENCH_PHASE_COUNT; ++phase) {
+      if (!run || elapsed[phase] < best[phase]) {
+        best[phase] = elapsed[phase];
+      }
+    }
+  }
+
+  printf("%-10s %12s %10s %10s\n", "phase", "operations", "best (ms)",
+         "ns/op");
+  for (uint32_t phase = 0; phase < BENCH_PHASE_COUNT; ++phase) {
+    uint32_t operations = phase >= BENCH_PHASE_DELETE ? BENCH_KEYS / 2
+                                                      : BENCH_KEYS;
+    printf("%-10s %12u %10.3f %10.2f\n", g_PHASE_NAMES[phase], operations,
+           best[phase] * 1e3, best[phase] * 1e9 / operations);
+  }
+
+  free(miss_text);
+  free(key_text);
+  free(strings);
+  free(misses);
+  free(keys);
+  return EXIT_SUCCESS;
+}
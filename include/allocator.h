@@ -0,0 +1,63 @@
+#ifndef CAMPSEUDO_ALLOCATOR_H
+#define CAMPSEUDO_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define POOL_GRANULE 16U
+#define POOL_CLASSES 16U
+#define POOL_MAX (POOL_GRANULE * POOL_CLASSES)
+#define POOL_SLAB_SIZE (64U * 1024U)
+#define ARENA_BLOCK_SIZE (64U * 1024U)
+
+// Allocates, resizes and frees with `reallocate`'s contract: `old_size` is
+// always the size the block was allocated with, so backends keep no block
+// headers. Backends embed this as their first member.
+struct allocator {
+  void *(*reallocate)(struct allocator *allocator, void *pointer,
+                      size_t old_size, size_t new_size);
+};
+
+struct pool_block {
+  struct pool_block *next;
+};
+
+struct pool_slab {
+  struct pool_slab *next;
+  max_align_t data[];
+};
+
+// Size-class free lists for blocks up to POOL_MAX bytes, in steps of
+// POOL_GRANULE, carved from slabs that are only returned by `pool_free`.
+// Larger blocks go to the system allocator.
+struct pool {
+  struct allocator allocator;
+  struct pool_block *free[POOL_CLASSES];
+  struct pool_slab *slabs;
+  uint8_t *cursor, *end;
+};
+
+struct arena_block {
+  struct arena_block *next;
+  max_align_t data[];
+};
+
+// A bump allocator for data that dies all at once. Freeing is a no-op
+// unless the block is the latest one, which can also grow in place.
+struct arena {
+  struct allocator allocator;
+  struct arena_block *blocks;
+  uint8_t *cursor, *end;
+};
+
+struct allocator *allocator_system(void);
+
+void pool_init(struct pool *pool);
+void pool_free(struct pool *pool);
+void pool_adopt(struct pool *pool, struct pool *from);
+
+void arena_init(struct arena *arena);
+void arena_free(struct arena *arena);
+void *arena_allocate(struct arena *arena, size_t size);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef COMPSEUDO_AST_H
 #define COMPSEUDO_AST_H
 
+#include "allocator.h"
 #include "common.h"
 #include <stdint.h>
 
@@ -14,6 +15,7 @@ enum node_kind : uint8_t {
   NODE_KIND_REAL,
   NODE_KIND_INTEGER,
   NODE_KIND_STRING,
+  NODE_KIND_VARIABLE,
 
   // Unary Expresions
   NODE_KIND_NOT,
@@ -37,11 +39,30 @@ enum node_kind : uint8_t {
   NODE_KIND_GREATER_EQUAL,
   NODE_KIND_LESS,
   NODE_KIND_LESS_EQUAL,
+  NODE_KIND_CALL,
+
+  // Statements
+  NODE_KIND_DECLARE,
+  NODE_KIND_CONSTANT,
+  NODE_KIND_ASSIGN,
+  NODE_KIND_CALL_STMT,
+  NODE_KIND_IF,
+  NODE_KIND_RETURN,
+  NODE_KIND_FUNCTION,
+  NODE_KIND_PROCEDURE,
+  NODE_KIND_PARAMETER,
+
+  // Lists
+  NODE_KIND_BLOCK,
+  NODE_KIND_ARGUMENTS,
 
 };
 
+// `column` is where the node's first token, or a binary node's operator,
+// starts on `line`; columns past UINT16_MAX are stored as UINT16_MAX.
 struct ast {
   uint32_t line;
+  uint16_t column;
   enum node_kind kind;
   union {
     bool boolean;
@@ -50,6 +71,7 @@ struct ast {
     int64_t integer;
     struct {
       uint32_t length;
+      bool in_arena;
       const char *chars;
     } string;
 
@@ -59,23 +81,42 @@ struct ast {
       struct ast *lhs;
       struct ast *rhs;
     } binary;
+
+    // Named nodes. `type` is the literal kind a DECLARE or PARAMETER names,
+    // or a FUNCTION returns. `expr` is the value a CONSTANT or ASSIGN stores,
+    // or the body of a FUNCTION or PROCEDURE: a BLOCK list that starts with
+    // its PARAMETERs.
+    struct {
+      const char *name;
+      uint32_t length;
+      enum node_kind type;
+      struct ast *expr;
+    } variable;
+
+    struct {
+      struct ast *condition;
+      struct ast *then;
+      struct ast *otherwise;
+    } branch;
+
+    // BLOCK (statements) and ARGUMENTS (expressions) lists hold one item per
+    // node and end with NULL. A CALL is a binary node: callee and ARGUMENTS.
+    struct {
+      struct ast *item;
+      struct ast *next;
+    } list;
   } as;
 };
 
-typedef struct ast_block {
-  uint32_t size;
-  struct ast *offset;
-  struct ast_block *next;
-  struct ast data[];
-} *ast_block_t;
-
+// Nodes and folded strings live until the whole compilation is done, so they
+// come from a bump arena rather than `reallocate`.
 struct ast_arena {
-  struct ast_block *current;
-  ast_block_t blocks;
+  struct arena arena;
 };
 
 void ast_arena_new(struct ast_arena *arena);
 struct ast *ast_arena_make(struct ast_arena *arena);
+char *ast_arena_chars(struct ast_arena *arena, uint32_t length);
 void ast_arena_free(struct ast_arena *arena);
 
 #ifdef DEBUG_AST
@@ -0,0 +1,22 @@
+#ifndef CAMPSEUDO_CACHE_H
+#define CAMPSEUDO_CACHE_H
+
+#include "chunk.h"
+#include "vm.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_MAGIC "CPBC"
+#define CACHE_VERSION 10U
+
+struct cache {
+  void *map;
+  size_t size;
+};
+
+bool cache_load(struct cache *cache, struct vm *vm, const char *source,
+                uint32_t flags, chunk_t *chunk);
+void cache_store(const char *source, uint32_t flags, const chunk_t chunk);
+void cache_unload(struct cache *cache);
+
+#endif
@@ -3,52 +3,88 @@
 
 #include "ast.h"
 #include "common.h"
+#include "debug_info.h"
 #include "table.h"
 #include "value.h"
 #include <stdint.h>
 
 enum opcode : uint8_t {
-  OPCODE_CONSTANT,
-  OPCODE_CONSTANT_LONG,
-  OPCODE_TRUE,
-  OPCODE_FALSE,
-  OPCODE_ADD,
-  OPCODE_SUB,
-  OPCODE_MUL,
-  OPCODE_DIV,
-  OPCODE_CONCAT,
-  OPCODE_NEGATE,
-  OPCODE_NOT,
-  OPCODE_EQUAL,
-  OPCODE_NOT_EQUAL,
-  OPCODE_LESS,
-  OPCODE_LESS_EQUAL,
-  OPCODE_GREATER,
-  OPCODE_GREATER_EQUAL,
-  OPCODE_RETURN,
+#define OPCODE(name, length, effect) OPCODE_##name,
+#include "opcodes.def"
+#undef OPCODE
+  OPCODE_COUNT,
 };
 
-typedef struct line_array {
-  uint32_t count, capacity;
-  uint32_t lines[];
-} *line_array_t;
+#define CHUNK_GLOBALS_MAX (UINT16_MAX + 1U)
+#define CHUNK_LOCALS_MAX (UINT8_MAX + 1U)
 
+// `globals` is the number of global slots the code may touch; the VM sizes
+// its global array to at least that many before running the chunk.
+// `max_stack` is the deepest the code takes the operand stack above its
+// locals. `max_frame` is the most stack any routine the code may call needs
+// for its locals and operands, so that the VM reserves the whole stack once,
+// for `max_stack` and VM_FRAMES_MAX such frames, instead of on every call.
+// `name` is the routine the chunk is the body of, pointing into the program
+// source, or NULL for top-level code and chunks loaded from the cache.
 typedef struct chunk {
   uint32_t count, capacity;
+  uint32_t globals, max_stack, max_frame;
+  uint32_t name_length;
+  const char *name;
   value_array_t constants;
-  line_array_t lines;
+  debug_info_t debug;
   enum opcode code[];
 } *chunk_t;
 
+enum global_kind : uint8_t {
+  GLOBAL_KIND_VARIABLE,
+  GLOBAL_KIND_CONSTANT,
+  GLOBAL_KIND_FUNCTION,
+  GLOBAL_KIND_PROCEDURE,
+};
+
+// `type` is a variable's or constant's type, or a function's return type.
+// A routine's `arity` parameter types are in `parameters`, owned by the map.
+struct global {
+  const char *name;
+  uint32_t length, hash;
+  enum global_kind kind;
+  enum node_kind type;
+  uint8_t arity;
+  enum node_kind *parameters;
+};
+
+// Compile-time map from global names to slots: a global lives at its index
+// here and in `vm->globals`. Names point into the program source. The map
+// outlives a single chunk so that REPL lines see earlier declarations, and
+// `max_frame` is the largest frame of any routine it has declared. Declaring
+// reports "Already declared." and the like itself and returns -1; a routine
+// is declared with its parameter and return types, so that calls compiled
+// before its body are checked as well.
+typedef struct globals {
+  uint32_t count, capacity;
+  uint32_t max_frame;
+  struct global globals[];
+} *globals_t;
+
+void globals_init(globals_t *globals);
+void globals_free(globals_t *globals);
+int32_t globals_resolve(const struct globals *globals, const struct ast *ast);
+int32_t globals_declare(globals_t *globals, const struct ast *ast,
+                        enum global_kind kind, enum node_kind type);
+int32_t globals_declare_routine(globals_t *globals, const struct ast *ast);
+
 void chunk_init(chunk_t *chunk);
 void chunk_free(chunk_t *chunk);
-void chunk_write(chunk_t *chunk, enum opcode byte, uint32_t line);
+void chunk_write(chunk_t *chunk, enum opcode byte, struct location location);
 uint32_t chunk_add_constant(chunk_t chunk, struct value value);
-uint32_t chunk_get_line(chunk_t chunk, uint32_t index);
+struct location chunk_get_location(const struct chunk *chunk, uint32_t index);
+uint32_t chunk_opcode_length(enum opcode opcode);
+const char *chunk_opcode_name(enum opcode opcode);
 uint32_t chunk_write_constant(chunk_t *chunk, struct value value,
-                              uint32_t line);
-void chunk_write_from_ast(chunk_t *chunk, struct ast *ast, obj_t *objects,
-                          table_t *table);
+                              struct location location);
+bool chunk_write_from_ast(chunk_t *chunk, struct ast *ast, globals_t *globals,
+                          obj_t *objects, table_t *strings);
 
 #ifdef DEBUG_CHUNK
 void chunk_disassemble(chunk_t chunk, const char *name);
@@ -8,8 +8,6 @@
 #define DEBUG_AST
 #define DEBUG_OBJ
 
-#define DEBUG_TRACE_EXECUTION
-
 #ifdef DEBUG_TRACE_EXECUTION
 #define DEBUG_CHUNK
 #endif
@@ -0,0 +1,58 @@
+#ifndef CAMPSEUDO_DEBUG_INFO_H
+#define CAMPSEUDO_DEBUG_INFO_H
+
+#include <stdint.h>
+
+#define DEBUG_INFO_STRIDE 16U
+
+// A position in the program source. Lines and columns count from 1; a
+// column of 0 means the position only knows its line.
+struct location {
+  uint32_t line, column;
+};
+
+// The decoded state at every DEBUG_INFO_STRIDE-th record, and the byte of
+// `data` the record starts at.
+struct debug_anchor {
+  uint32_t offset, line, column, position;
+};
+
+typedef struct debug_index {
+  uint32_t count, capacity;
+  struct debug_anchor anchors[];
+} *debug_index_t;
+
+// Maps code offsets to source locations. Each run of code bytes that share a
+// location is one record: the deltas of its first offset, line and column
+// from the previous record, as LEB128 varints, the line and column deltas
+// zigzag-encoded. `index` anchors every DEBUG_INFO_STRIDE-th record, so a
+// lookup is a binary search followed by at most DEBUG_INFO_STRIDE decodes.
+// `offset` and `location` are those of the last record, `records` their
+// number.
+typedef struct debug_info {
+  uint32_t count, capacity;
+  uint32_t records, offset;
+  struct location location;
+  debug_index_t index;
+  uint8_t data[];
+} *debug_info_t;
+
+// Decodes records front to back for forward scans over the code.
+struct debug_cursor {
+  const struct debug_info *info;
+  uint32_t position, next_offset;
+  struct location location, next;
+};
+
+void debug_info_new(debug_info_t *info);
+void debug_info_free(debug_info_t *info);
+void debug_info_write(debug_info_t *info, uint32_t offset,
+                      struct location location);
+struct location debug_info_lookup(const struct debug_info *info,
+                                  uint32_t offset, uint32_t *start);
+
+void debug_cursor_init(struct debug_cursor *cursor,
+                       const struct debug_info *info);
+struct location debug_cursor_at(struct debug_cursor *cursor, uint32_t offset);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef CAMPSEUDO_GC_H
+#define CAMPSEUDO_GC_H
+
+#include "obj.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define GC_THRESHOLD_INIT (1024U * 1024U)
+#define GC_GROWTH_INIT 200U
+
+struct vm;
+
+struct gc_stats {
+  uint64_t collections;
+  uint64_t allocations;
+  uint64_t objects_freed;
+  size_t bytes_freed;
+  size_t bytes_peak;
+};
+
+struct gc {
+  struct vm *vm;
+  size_t bytes_allocated;
+  size_t next_collection;
+  size_t threshold;
+  uint32_t growth;
+  uint32_t paused;
+  bool stress;
+  uint32_t gray_count, gray_capacity;
+  obj_t *gray;
+  struct gc_stats stats;
+};
+
+static inline bool gc_should_collect(const struct gc *gc) {
+  return !gc->paused &&
+         (gc->stress || gc->bytes_allocated > gc->next_collection);
+}
+
+void gc_init(struct gc *gc, struct vm *vm);
+void gc_free(struct gc *gc);
+void gc_collect(struct gc *gc);
+void gc_safepoint(struct gc *gc);
+void gc_pause(struct gc *gc);
+void gc_resume(struct gc *gc);
+void gc_print_stats(const struct gc *gc);
+
+#endif
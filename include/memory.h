@@ -13,6 +13,12 @@
 #define MEM_ALLOC(size) reallocate(NULL, 0, size)
 #define MEM_FREE(pointer, size) reallocate(pointer, size, 0)
 
+struct allocator;
+struct gc;
+
+// Both return the calling thread's previous setting.
+struct gc *memory_set_gc(struct gc *gc);
+struct allocator *memory_set_allocator(struct allocator *allocator);
 void *reallocate(void *pointer, size_t old_size, size_t new_size);
 
-#endif
\ No newline at end of file
+#endif
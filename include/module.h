@@ -0,0 +1,33 @@
+#ifndef CAMPSEUDO_MODULE_H
+#define CAMPSEUDO_MODULE_H
+
+#include "allocator.h"
+#include "chunk.h"
+#include "gc.h"
+#include "optimizer.h"
+#include "vm.h"
+#include <stdint.h>
+
+#define MODULE_JOBS_MAX 64U
+
+// One source file of a multi-file program. `modules_compile` fills in the
+// rest on a worker thread: until `modules_link` hands them to the VM, the
+// chunk, objects and interned strings come from the module's own `pool` and
+// are counted by its own, always paused, `gc`. After linking, `function`
+// holds the module's top-level code.
+struct module {
+  const char *source;
+  bool compiled;
+  chunk_t chunk;
+  obj_t objects;
+  table_t strings;
+  struct pool pool;
+  struct gc gc;
+  obj_function_t function;
+};
+
+void modules_compile(struct module *modules, uint32_t count,
+                     enum optimize_level level, uint32_t jobs);
+bool modules_link(struct vm *vm, struct module *modules, uint32_t count);
+
+#endif
@@ -7,14 +7,29 @@
 
 #define AS_OBJ(obj) ((obj_t)obj)
 #define OBJ_AS_STRING(obj) ((obj_string_t)obj)
+#define OBJ_AS_INTEGER(obj) ((obj_integer_t)obj)
+#define OBJ_AS_BUFFER(obj) ((obj_buffer_t)obj)
+#define OBJ_AS_ROPE(obj) ((obj_rope_t)obj)
+#define OBJ_AS_FUNCTION(obj) ((obj_function_t)obj)
 #define OBJ_AS_CSTRING(obj)                                                    \
   (OBJ_AS_STRING(obj)->is_owned ? OBJ_AS_STRING(obj)->as.owned                 \
                                 : OBJ_AS_STRING(obj)->as.ref)
 
-enum obj_kind { OBJ_KIND_STRING };
+#define ROPE_MIN_LENGTH 64U
+
+enum obj_kind {
+  OBJ_KIND_STRING,
+  OBJ_KIND_INTEGER,
+  OBJ_KIND_BUFFER,
+  OBJ_KIND_ROPE,
+  OBJ_KIND_FUNCTION,
+};
+
+typedef struct chunk *chunk_t;
 
 typedef struct obj {
   enum obj_kind kind;
+  bool is_marked;
   struct obj *next;
 } *obj_t;
 
@@ -29,12 +44,54 @@ typedef struct obj_string {
   } as;
 } *obj_string_t;
 
+typedef struct obj_integer {
+  struct obj obj;
+  int64_t value;
+} *obj_integer_t;
+
+typedef struct obj_buffer {
+  struct obj obj;
+  uint32_t length, capacity;
+  char *chars;
+} *obj_buffer_t;
+
+typedef struct obj_rope {
+  struct obj obj;
+  uint32_t length;
+  obj_buffer_t buffer;
+} *obj_rope_t;
+
+// A compiled FUNCTION or PROCEDURE. `locals` counts every frame slot the
+// routine uses, its `arity` parameters included.
+typedef struct obj_function {
+  struct obj obj;
+  uint32_t arity, locals;
+  chunk_t chunk;
+} *obj_function_t;
+
+static inline const char *obj_text_chars(const struct obj *obj) {
+  return obj->kind == OBJ_KIND_ROPE ? OBJ_AS_ROPE(obj)->buffer->chars
+                                    : OBJ_AS_CSTRING(obj);
+}
+
+static inline uint32_t obj_text_length(const struct obj *obj) {
+  return obj->kind == OBJ_KIND_ROPE ? OBJ_AS_ROPE(obj)->length
+                                    : OBJ_AS_STRING(obj)->length;
+}
+
 void obj_print(const obj_t obj);
+bool obj_is_equal(const struct obj *a, const struct obj *b);
+
+obj_integer_t obj_integer_new(obj_t *objects, int64_t value);
+obj_function_t obj_function_new(obj_t *objects);
 
 obj_string_t obj_string_copy(obj_t *objects, table_t *strings,
                              const char *chars, uint32_t length);
+obj_t obj_text_concat(obj_t *objects, table_t *strings, const struct obj *a,
+                      const struct obj *b);
 obj_string_t obj_string_ref(obj_t *objects, table_t *strings, const char *chars,
                             uint32_t length);
+void obj_free(obj_t obj);
 void objects_free(obj_t *objects);
 
 #endif
\ No newline at end of file
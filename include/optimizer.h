@@ -0,0 +1,16 @@
+#ifndef CAMPSEUDO_OPTIMIZER_H
+#define CAMPSEUDO_OPTIMIZER_H
+
+#include "ast.h"
+#include <stdint.h>
+
+enum optimize_level : uint8_t {
+  OPTIMIZE_LEVEL_NONE,
+  OPTIMIZE_LEVEL_FOLD,
+  OPTIMIZE_LEVEL_PEEPHOLE,
+};
+
+struct ast *optimizer_run(struct ast_arena *arena, struct ast *ast,
+                          enum optimize_level level);
+
+#endif
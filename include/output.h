@@ -0,0 +1,38 @@
+#ifndef CAMPSEUDO_OUTPUT_H
+#define CAMPSEUDO_OUTPUT_H
+
+#include "value.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OUTPUT_BUFFER_SIZE (64U * 1024U)
+
+// Where a program's output goes. Writes collect in `buffer` and reach
+// `file` in one call when it fills up or on `output_flush`, which the VM
+// calls when a program ends or stops with an error. `is_owned` is set when
+// the file was opened by `output_open` and must be closed.
+struct output {
+  FILE *file;
+  bool is_owned;
+  uint32_t count;
+  char buffer[OUTPUT_BUFFER_SIZE];
+};
+
+void output_init(struct output *output, FILE *file);
+void output_free(struct output *output);
+bool output_open(struct output *output, const char *path);
+void output_flush(struct output *output);
+void output_write(struct output *output, const char *chars, size_t length);
+void output_write_integer(struct output *output, int64_t integer);
+void output_write_value(struct output *output, struct value value);
+
+static inline void output_write_char(struct output *output, char c) {
+  if (output->count == OUTPUT_BUFFER_SIZE) {
+    output_flush(output);
+  }
+  output->buffer[output->count++] = c;
+}
+
+#endif
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 struct parser {
   bool had_error;
+  bool panic_mode;
   struct token current;
   struct ast_arena *arena;
   struct scanner *scanner;
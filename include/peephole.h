@@ -0,0 +1,11 @@
+#ifndef CAMPSEUDO_PEEPHOLE_H
+#define CAMPSEUDO_PEEPHOLE_H
+
+#include "chunk.h"
+
+// Rewrites common instruction sequences in `chunk`, and in the routines among
+// its constants, into superinstructions. The code only ever shrinks, so the
+// chunk is rewritten in place.
+void peephole_run(chunk_t chunk);
+
+#endif
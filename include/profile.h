@@ -0,0 +1,54 @@
+#ifndef CAMPSEUDO_PROFILE_H
+#define CAMPSEUDO_PROFILE_H
+
+#include "chunk.h"
+#include <stdint.h>
+
+#define PROFILE_INTERVAL_INIT 1000U
+#define PROFILE_DEPTH_MAX 128U
+#define PROFILE_SAMPLES_MAX (1U << 18)
+#define PROFILE_FRAMES_MAX (1U << 21)
+#define PROFILE_REPORT_MAX 20U
+
+struct vm;
+
+// A code position caught by the sampler, as the chunk and instruction
+// pointer of one frame.
+struct profile_frame {
+  chunk_t chunk;
+  const uint8_t *ip;
+};
+
+// A frame mapped back to source: the routine it is in, NULL for top-level
+// code, and the line.
+struct profile_site {
+  const char *name;
+  uint32_t length, line;
+};
+
+// Samples the running VM from a SIGPROF handler every `interval`
+// microseconds of CPU time. The handler only copies frames into the fixed
+// `raw` buffers, outermost first, counting samples it has no room for as
+// `dropped`. `profile_stop` maps them to sites while their chunks are alive:
+// sample `i` is the `depths[i]` sites after those of the samples before it.
+struct profile {
+  struct vm *vm;
+  uint32_t interval;
+  uint32_t dropped;
+  uint32_t raw_count, raw_frame_count;
+  uint32_t *raw_depths;
+  struct profile_frame *raw_frames;
+  uint32_t count, capacity;
+  uint32_t site_count, site_capacity;
+  uint32_t *depths;
+  struct profile_site *sites;
+};
+
+bool profile_init(struct profile *profile, struct vm *vm, uint32_t interval);
+void profile_free(struct profile *profile);
+void profile_start(struct profile *profile);
+void profile_stop(struct profile *profile);
+void profile_print(const struct profile *profile);
+bool profile_write_folded(const struct profile *profile, const char *path);
+
+#endif
\ No newline at end of file
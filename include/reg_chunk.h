@@ -0,0 +1,94 @@
+#ifndef CAMPSEUDO_REG_CHUNK_H
+#define CAMPSEUDO_REG_CHUNK_H
+
+#include "ast.h"
+#include "chunk.h"
+#include "common.h"
+#include "table.h"
+#include "value.h"
+#include <stdint.h>
+
+#define REG_MAX 128U
+#define REG_RK_CONSTANT 0x80U
+
+#define REG_ENCODE(op, a, b, c)                                                \
+  ((uint32_t)(op) | (uint32_t)(a) << 8 | (uint32_t)(b) << 16 |                 \
+   (uint32_t)(c) << 24)
+#define REG_ENCODE_BX(op, a, bx)                                               \
+  ((uint32_t)(op) | (uint32_t)(a) << 8 | (uint32_t)(bx) << 16)
+
+#define REG_OP(instruction) ((enum reg_opcode)((instruction) & 0xFFU))
+#define REG_A(instruction) (((instruction) >> 8) & 0xFFU)
+#define REG_B(instruction) (((instruction) >> 16) & 0xFFU)
+#define REG_C(instruction) ((instruction) >> 24)
+#define REG_BX(instruction) ((instruction) >> 16)
+
+#define REG_IS_CONSTANT(operand) ((operand) & REG_RK_CONSTANT)
+#define REG_CONSTANT_INDEX(operand) ((operand) & ~REG_RK_CONSTANT)
+
+// A, B and C are 8-bit operands; B and C are RK operands that name a
+// constant when REG_RK_CONSTANT is set and a frame register otherwise, and
+// so is A where it is read rather than written. Bx is a 16-bit operand; jumps
+// only go forward, by Bx instructions from the next one.
+// The compiler checks types as the stack compiler does and widens INTEGER
+// operands with TO_REAL, so both operands of an instruction have one kind.
+enum reg_opcode : uint8_t {
+  REG_OPCODE_LOADK,         // R[A] = K[Bx]
+  REG_OPCODE_MOVE,          // R[A] = RK[B]
+  REG_OPCODE_GET_GLOBAL,    // R[A] = G[Bx]
+  REG_OPCODE_SET_GLOBAL,    // G[Bx] = RK[A]
+  REG_OPCODE_ADD,           // R[A] = RK[B] + RK[C]
+  REG_OPCODE_SUB,           // R[A] = RK[B] - RK[C]
+  REG_OPCODE_MUL,           // R[A] = RK[B] * RK[C]
+  REG_OPCODE_DIV,           // R[A] = RK[B] / RK[C]
+  REG_OPCODE_MOD,           // R[A] = RK[B] MOD RK[C]
+  REG_OPCODE_CONCAT,        // R[A] = RK[B] & RK[C]
+  REG_OPCODE_TO_REAL,       // R[A] = (REAL)RK[B]
+  REG_OPCODE_NEGATE,        // R[A] = -RK[B]
+  REG_OPCODE_NOT,           // R[A] = NOT RK[B]
+  REG_OPCODE_EQUAL,         // R[A] = RK[B] = RK[C]
+  REG_OPCODE_NOT_EQUAL,     // R[A] = RK[B] <> RK[C]
+  REG_OPCODE_LESS,          // R[A] = RK[B] < RK[C]
+  REG_OPCODE_LESS_EQUAL,    // R[A] = RK[B] <= RK[C]
+  REG_OPCODE_GREATER,       // R[A] = RK[B] > RK[C]
+  REG_OPCODE_GREATER_EQUAL, // R[A] = RK[B] >= RK[C]
+  REG_OPCODE_JUMP,          // pc += Bx
+  REG_OPCODE_JUMP_IF_FALSE, // if NOT RK[A] then pc += Bx
+  REG_OPCODE_JUMP_IF_TRUE,  // if RK[A] then pc += Bx
+  REG_OPCODE_CALL,          // R[A] = routine Bx(R[A], R[A + 1], ...)
+  REG_OPCODE_PRINT,         // print RK[B]
+  REG_OPCODE_RETURN,        // return RK[B]
+};
+
+// A routine's frame starts at the register its caller passed the first
+// argument in, so its parameters are its first registers, followed by its
+// locals, and its result replaces the first argument. `registers` is the
+// size of the frame. The program's chunk owns the `routine_count` routine
+// chunks in `routines`, indexed by CALL; `globals` is the number of global
+// slots the program touches and `max_frame` the largest routine frame.
+typedef struct reg_chunk {
+  uint32_t count, capacity;
+  uint32_t registers;
+  uint32_t globals, max_frame;
+  uint32_t routine_count;
+  struct reg_chunk **routines;
+  const char *name;
+  uint32_t name_length;
+  value_array_t constants;
+  debug_info_t debug;
+  uint32_t code[];
+} *reg_chunk_t;
+
+void reg_chunk_init(reg_chunk_t *chunk);
+void reg_chunk_free(reg_chunk_t *chunk);
+void reg_chunk_write(reg_chunk_t *chunk, uint32_t instruction,
+                     struct location location);
+bool reg_chunk_write_from_ast(reg_chunk_t *chunk, struct ast *ast,
+                              obj_t *objects, table_t *strings);
+
+#ifdef DEBUG_CHUNK
+void reg_chunk_disassemble(reg_chunk_t chunk, const char *name);
+uint32_t reg_chunk_disassemble_instruction(reg_chunk_t chunk, uint32_t offset);
+#endif
+
+#endif
@@ -108,22 +108,33 @@ enum token_kind : uint8_t {
   TOKEN_KIND_KW_WHILE,
   TOKEN_KIND_KW_WRITEFILE,
   TOKEN_KIND_KW_WRITE,
+  TOKEN_KIND_COUNT,
 };
 
+// `column` counts bytes from the start of the line, from 1.
 struct token {
   enum token_kind kind;
   const char *start;
   uint32_t length;
-  uint32_t line;
+  uint32_t line, column;
+};
+
+enum scanner_isa : uint8_t {
+  SCANNER_ISA_SCALAR,
+  SCANNER_ISA_SSE2,
+  SCANNER_ISA_AVX2,
 };
 
 struct scanner {
   const char *start;
   const char *current;
+  const char *line_start;
   uint32_t line;
 };
 
 void scanner_init(struct scanner *scanner, const char *source);
 struct token scanner_scan_token(struct scanner *scanner);
+bool scanner_use_isa(enum scanner_isa isa);
+enum token_kind scanner_keyword_kind(const char *start, uint32_t length);
 
 #endif
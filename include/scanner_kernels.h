@@ -0,0 +1,18 @@
+#ifndef CAMPSEUDO_SCANNER_KERNELS_H
+#define CAMPSEUDO_SCANNER_KERNELS_H
+
+#include "scanner.h"
+#include <stdint.h>
+
+struct scanner_kernels {
+  const char *(*skip_blank)(const char *current);
+  const char *(*skip_line)(const char *current);
+  const char *(*skip_digits)(const char *current);
+  const char *(*skip_identifier)(const char *current);
+  const char *(*skip_string)(const char *current, uint32_t *lines);
+};
+
+const struct scanner_kernels *scanner_kernels_get(enum scanner_isa isa);
+enum scanner_isa scanner_kernels_best(void);
+
+#endif
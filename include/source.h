@@ -0,0 +1,27 @@
+#ifndef CAMPSEUDO_SOURCE_H
+#define CAMPSEUDO_SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct source {
+  struct source *next;
+  const char *chars;
+  size_t length;
+  size_t size;
+  bool is_mapped;
+} *source_t;
+
+struct source_manager {
+  source_t sources;
+};
+
+void source_manager_init(struct source_manager *manager);
+void source_manager_free(struct source_manager *manager);
+const struct source *source_manager_open(struct source_manager *manager,
+                                         const char *path);
+const struct source *source_manager_add(struct source_manager *manager,
+                                        const char *chars, size_t length);
+
+#endif
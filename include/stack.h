@@ -10,8 +10,7 @@ typedef struct stack {
 } *stack_t;
 
 void stack_init(stack_t *stack);
-void stack_put(stack_t *stack, struct value value);
-struct value stack_pop(stack_t stack);
+void stack_reserve(stack_t *stack, uint32_t count);
 void stack_reset(stack_t stack);
 void stack_free(stack_t *stack);
 
@@ -5,6 +5,7 @@
 #include <stdint.h>
 
 #define TABLE_NIL VALUE_FROM_BOOL(false)
+#define TABLE_GROUP_WIDTH 16U
 
 typedef struct obj_string *obj_string_t;
 
@@ -13,14 +14,19 @@ struct entry {
   struct value value;
 };
 
+// Open-addressed table probed a group of TABLE_GROUP_WIDTH slots at a time.
+// `entries` is followed in the same allocation by `capacity` control bytes,
+// one per slot: the low 7 bits of the key's hash when the slot is full, or
+// one of the TABLE_CONTROL_* markers in table.c.
 typedef struct table {
-  uint32_t count, capacity;
+  uint32_t count, capacity, growth_left;
   struct entry entries[];
 } *table_t;
 
 void table_init(table_t *table);
 void table_free(table_t *table);
 uint32_t table_hash(const char *key, uint32_t length);
+void table_reserve(table_t *table, uint32_t count);
 bool table_insert(table_t *table, struct obj_string *key, struct value value);
 bool table_member(const struct table *table, const struct obj_string *key,
                   struct value *value);
@@ -28,5 +34,8 @@ bool table_delete(table_t table, const struct obj_string *key);
 void table_add_all(const struct table *from, table_t *to);
 obj_string_t table_find_string(table_t table, const char *chars,
                                uint32_t length, uint32_t hash);
+// Inserts the keys of `from` whose text `to` does not hold yet.
+void table_intern_all(const struct table *from, table_t *to);
+void table_remove_unmarked(table_t table);
 
-#endif
\ No newline at end of file
+#endif
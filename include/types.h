@@ -0,0 +1,34 @@
+#ifndef CAMPSEUDO_TYPES_H
+#define CAMPSEUDO_TYPES_H
+
+#include "ast.h"
+#include "common.h"
+#include <stdint.h>
+
+// Types are the literal kinds DECLARE names. An expression that failed to
+// check has the type TYPE_ERROR, which no value has, so the expressions
+// around it report nothing more.
+#define TYPE_ERROR NODE_KIND_VARIABLE
+
+// How both backends compile an operator or a conversion. `type` is the
+// result, or TYPE_ERROR with the error in `message` when the operands do not
+// type; `message` is empty when an operand already failed. `operand` is the
+// type both operands have once the INTEGER ones flagged by `widen_lhs` and
+// `widen_rhs` are widened to REAL, and picks the INTEGER, REAL or generic
+// form of the operation. A unary operand or a converted value is the right
+// operand.
+struct type_rule {
+  enum node_kind type, operand;
+  bool widen_lhs, widen_rhs;
+  char message[64];
+};
+
+const char *type_name(enum node_kind type);
+bool type_is_number(enum node_kind type);
+struct type_rule type_unary(enum node_kind op, enum node_kind operand);
+struct type_rule type_binary(enum node_kind op, enum node_kind lhs,
+                             enum node_kind rhs);
+struct type_rule type_convert(enum node_kind from, enum node_kind to);
+void type_error(const struct ast *ast, const char *message);
+
+#endif
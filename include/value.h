@@ -2,6 +2,49 @@
 #define CAMPSEUDO_VALUE_H
 
 #include "common.h"
+#include <stdint.h>
+#include <string.h>
+
+#ifdef VALUE_NAN_BOXING
+
+#define VALUE_SIGN 0x8000000000000000ULL
+#define VALUE_QNAN 0x7FFC000000000000ULL
+#define VALUE_CANONICAL_NAN 0x7FF8000000000000ULL
+#define VALUE_TAG_BOOL 0x0001000000000000ULL
+#define VALUE_TAG_CHAR 0x0002000000000000ULL
+#define VALUE_TAG_INTEGER 0x0003000000000000ULL
+#define VALUE_TAG_BOXED 0x0001000000000000ULL
+#define VALUE_PAYLOAD_MASK 0x0000FFFFFFFFFFFFULL
+
+#define VALUE_INTEGER_MIN (-(INT64_C(1) << 47))
+#define VALUE_INTEGER_MAX ((INT64_C(1) << 47) - 1)
+#define VALUE_INTEGER_FITS(int)                                                \
+  ((int) >= VALUE_INTEGER_MIN && (int) <= VALUE_INTEGER_MAX)
+
+#define VALUE_KIND(value) value_kind(value)
+
+#define VALUE_AS_OBJ(value)                                                    \
+  ((obj_t)(uintptr_t)((value).bits & VALUE_PAYLOAD_MASK))
+#define VALUE_AS_BOOL(value) ((bool)((value).bits & 1))
+#define VALUE_AS_CHAR(value) ((uint8_t)(value).bits)
+#define VALUE_AS_REAL(value) value_as_real(value)
+#define VALUE_AS_INTEGER(value) value_as_integer(value)
+#define VALUE_AS_STRING(value) ((obj_string_t)VALUE_AS_OBJ(value))
+
+#define VALUE_FROM_OBJ(object)                                                 \
+  ((struct value){VALUE_SIGN | VALUE_QNAN | (uint64_t)(uintptr_t)(object)})
+#define VALUE_FROM_BOOL(bool)                                                  \
+  ((struct value){VALUE_QNAN | VALUE_TAG_BOOL | (uint64_t)!!(bool)})
+#define VALUE_FROM_CHAR(char)                                                  \
+  ((struct value){VALUE_QNAN | VALUE_TAG_CHAR | (uint8_t)(char)})
+#define VALUE_FROM_REAL(real_) value_from_real(real_)
+#define VALUE_FROM_INTEGER(int)                                                \
+  ((struct value){VALUE_QNAN | VALUE_TAG_INTEGER |                             \
+                  ((uint64_t)(int64_t)(int) & VALUE_PAYLOAD_MASK)})
+
+#else
+
+#define VALUE_KIND(value) (value).kind
 
 #define VALUE_AS_OBJ(value) (value).as.obj
 #define VALUE_AS_BOOL(value) (value).as.boolean
@@ -21,6 +64,8 @@
 #define VALUE_FROM_INTEGER(int)                                                \
   (struct value) { VALUE_KIND_INTEGER, .as.integer = int }
 
+#endif
+
 typedef struct obj *obj_t;
 typedef struct obj_string *obj_string_t;
 
@@ -32,6 +77,16 @@ enum value_kind : uint8_t {
   VALUE_KIND_OBJ,
 };
 
+#ifdef VALUE_NAN_BOXING
+
+struct value {
+  uint64_t bits;
+};
+
+_Static_assert(sizeof(void *) == 8, "NaN boxing needs 48-bit pointers");
+
+#else
+
 struct value {
   enum value_kind kind;
   union {
@@ -43,6 +98,8 @@ struct value {
   } as;
 };
 
+#endif
+
 typedef struct value_array {
   uint32_t count, capacity;
   struct value values[];
@@ -54,6 +111,74 @@ void value_array_write(value_array_t *array, struct value value);
 
 bool value_is_equal(struct value a, struct value b);
 
+#ifdef VALUE_NAN_BOXING
+
+struct value value_box_integer(obj_t *objects, int64_t integer);
+int64_t value_unbox_integer(struct value value);
+
+static inline enum value_kind value_kind(struct value value) {
+  static const enum value_kind kinds[] = {
+      VALUE_KIND_REAL, VALUE_KIND_BOOL,    VALUE_KIND_CHAR, VALUE_KIND_INTEGER,
+      VALUE_KIND_OBJ,  VALUE_KIND_INTEGER, VALUE_KIND_REAL, VALUE_KIND_REAL,
+  };
+  if ((value.bits & VALUE_QNAN) != VALUE_QNAN) {
+    return VALUE_KIND_REAL;
+  }
+  return kinds[(value.bits >> 61 & 4) | (value.bits >> 48 & 3)];
+}
+
+static inline double value_as_real(struct value value) {
+  double real;
+  memcpy(&real, &value.bits, sizeof(real));
+  return real;
+}
+
+static inline struct value value_from_real(double real) {
+  struct value value = {VALUE_CANONICAL_NAN};
+  if (real == real) {
+    memcpy(&value.bits, &real, sizeof(real));
+  }
+  return value;
+}
+
+static inline int64_t value_as_integer(struct value value) {
+  if (value.bits & VALUE_SIGN) {
+    return value_unbox_integer(value);
+  }
+  return (int64_t)(value.bits << 16) >> 16;
+}
+
+#endif
+
+static inline struct value value_from_integer(obj_t *objects,
+                                              int64_t integer) {
+#ifdef VALUE_NAN_BOXING
+  if (!VALUE_INTEGER_FITS(integer)) {
+    return value_box_integer(objects, integer);
+  }
+#else
+  (void)objects;
+#endif
+  return VALUE_FROM_INTEGER(integer);
+}
+
+static inline bool value_is_obj(struct value value) {
+#ifdef VALUE_NAN_BOXING
+  return (value.bits & (VALUE_SIGN | VALUE_QNAN)) == (VALUE_SIGN | VALUE_QNAN);
+#else
+  return value.kind == VALUE_KIND_OBJ;
+#endif
+}
+
+static inline struct value value_with_obj(struct value value, obj_t obj) {
+#ifdef VALUE_NAN_BOXING
+  value.bits = (value.bits & ~VALUE_PAYLOAD_MASK) | (uint64_t)(uintptr_t)obj;
+#else
+  value.as.obj = obj;
+#endif
+  return value;
+}
+
 #ifdef DEBUG_CHUNK
 void value_print(struct value value);
 #endif
@@ -1,16 +1,69 @@
 #ifndef CAMPSEUDO_VM_H
 #define CAMPSEUDO_VM_H
 
+#include "allocator.h"
 #include "chunk.h"
+#include "gc.h"
+#include "output.h"
+#include "profile.h"
+#include "reg_chunk.h"
+#include "source.h"
 #include "stack.h"
 #include "table.h"
 
+#define VM_FRAMES_MAX 1024U
+
+// The caller's state, saved by OPCODE_CALL and restored by OPCODE_RETURN.
+struct frame {
+  chunk_t chunk;
+  uint8_t *ip;
+  uint32_t base;
+};
+
+// Quickening counts: generic opcodes rewritten into a `_QUICK` form, `_QUICK`
+// forms run on the operand kinds they expect, and ones that met other kinds
+// and turned back into the generic opcode. Hits are only counted by the
+// instrumented dispatch loop.
+struct vm_stats {
+  uint64_t quickened, quick_hits, quick_misses;
+};
+
+// Per-opcode dispatch counts and the cycles spent from each dispatch to the
+// next, and the allocations made while running, for `--stats`.
+struct vm_opcode_stats {
+  uint64_t counts[OPCODE_COUNT];
+  uint64_t cycles[OPCODE_COUNT];
+  uint64_t allocations;
+};
+
+// `base` is the stack index of the running routine's first local slot.
+// `opcode_pairs` counts dispatched opcode bigrams, indexed by
+// `first * OPCODE_COUNT + second`, or is NULL when not profiling, and
+// `opcode_stats` likewise. Runs with either set, or with `trace` or
+// `count_hits`, take the instrumented dispatch loop. `profile` samples every
+// run when set by `vm_profile`. Programs write through `output`. Everything
+// allocated through `reallocate` while the VM is alive comes from `pool`.
 struct vm {
   uint8_t *ip;
+  uint32_t base;
+  uint32_t frame_count;
   obj_t objects;
   chunk_t chunk;
+  reg_chunk_t reg_chunk;
   stack_t stack;
+  value_array_t globals;
   table_t strings;
+  struct gc gc;
+  struct pool pool;
+  struct source_manager sources;
+  struct output output;
+  bool trace;
+  bool count_hits;
+  uint64_t *opcode_pairs;
+  struct vm_opcode_stats *opcode_stats;
+  struct profile *profile;
+  struct vm_stats stats;
+  struct frame frames[VM_FRAMES_MAX];
 };
 
 enum interpret_result {
@@ -22,6 +75,14 @@ enum interpret_result {
 void vm_init(struct vm *vm);
 void vm_free(struct vm *vm);
 enum interpret_result vm_interpret(struct vm *vm, const chunk_t chunk);
-void obj_free(obj_t obj);
+enum interpret_result vm_interpret_registers(struct vm *vm,
+                                             const reg_chunk_t chunk);
+obj_t vm_concat(struct vm *vm, obj_t a, obj_t b);
+void vm_count_opcode_pairs(struct vm *vm);
+void vm_count_opcodes(struct vm *vm);
+bool vm_profile(struct vm *vm, uint32_t interval);
+void vm_print_opcode_pairs(const struct vm *vm);
+void vm_print_opcode_stats(const struct vm *vm);
+void vm_print_stats(const struct vm *vm);
 
 #endif
\ No newline at end of file
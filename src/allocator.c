@@ -0,0 +1,176 @@
+#include "allocator.h"
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN(size)                                                            \
+  (((size) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+static void *_system_reallocate(struct allocator *allocator, void *pointer,
+                                size_t old_size, size_t new_size) {
+  (void)allocator;
+  (void)old_size;
+  if (!new_size) {
+    free(pointer);
+    return NULL;
+  }
+  return realloc(pointer, new_size);
+}
+
+static struct allocator g_SYSTEM = {_system_reallocate};
+
+struct allocator *allocator_system(void) { return &g_SYSTEM; }
+
+static inline uint32_t _class(size_t size) {
+  return (uint32_t)((size - 1) / POOL_GRANULE);
+}
+
+static void *_pool_allocate(struct pool *pool, uint32_t class) {
+  struct pool_block *block = pool->free[class];
+  if (block) {
+    pool->free[class] = block->next;
+    return block;
+  }
+
+  size_t size = (class + 1) * POOL_GRANULE;
+  if ((size_t)(pool->end - pool->cursor) < size) {
+    struct pool_slab *slab =
+        malloc(sizeof(struct pool_slab) + POOL_SLAB_SIZE);
+    if (!slab) {
+      return NULL;
+    }
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->cursor = (uint8_t *)slab->data;
+    pool->end = pool->cursor + POOL_SLAB_SIZE;
+  }
+  void *result = pool->cursor;
+  pool->cursor += size;
+  return result;
+}
+
+static void *_pool_reallocate(struct allocator *allocator, void *pointer,
+                              size_t old_size, size_t new_size) {
+  struct pool *pool = (struct pool *)allocator;
+  bool old_pooled = pointer && old_size && old_size <= POOL_MAX;
+  bool new_pooled = new_size && new_size <= POOL_MAX;
+  if (!old_pooled && !new_pooled) {
+    return _system_reallocate(allocator, pointer, old_size, new_size);
+  }
+  if (old_pooled && new_pooled && _class(old_size) == _class(new_size)) {
+    return pointer;
+  }
+
+  void *result = NULL;
+  if (new_size) {
+    result = new_pooled ? _pool_allocate(pool, _class(new_size))
+                        : malloc(new_size);
+    if (!result) {
+      return NULL;
+    }
+    if (pointer) {
+      memcpy(result, pointer, old_size < new_size ? old_size : new_size);
+    }
+  }
+  if (old_pooled) {
+    struct pool_block *block = pointer;
+    uint32_t class = _class(old_size);
+    block->next = pool->free[class];
+    pool->free[class] = block;
+  } else {
+    free(pointer);
+  }
+  return result;
+}
+
+void pool_init(struct pool *pool) {
+  *pool = (struct pool){.allocator = {_pool_reallocate}};
+}
+
+void pool_free(struct pool *pool) {
+  while (pool->slabs) {
+    struct pool_slab *next = pool->slabs->next;
+    free(pool->slabs);
+    pool->slabs = next;
+  }
+  pool_init(pool);
+}
+
+// Takes over `from`'s slabs and free blocks, leaving it empty, so blocks
+// allocated from either pool can be freed into `pool`.
+void pool_adopt(struct pool *pool, struct pool *from) {
+  struct pool_slab **slab = &from->slabs;
+  while (*slab) {
+    slab = &(*slab)->next;
+  }
+  *slab = pool->slabs;
+  pool->slabs = from->slabs;
+
+  for (uint32_t class = 0; class < POOL_CLASSES; ++class) {
+    struct pool_block **block = &from->free[class];
+    while (*block) {
+      block = &(*block)->next;
+    }
+    *block = pool->free[class];
+    pool->free[class] = from->free[class];
+  }
+  pool_init(from);
+}
+
+static void *_arena_allocate(struct arena *arena, size_t size) {
+  if ((size_t)(arena->end - arena->cursor) < size) {
+    size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    struct arena_block *block = malloc(sizeof(struct arena_block) + capacity);
+    if (!block) {
+      return NULL;
+    }
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->cursor = (uint8_t *)block->data;
+    arena->end = arena->cursor + capacity;
+  }
+  void *result = arena->cursor;
+  arena->cursor += size;
+  return result;
+}
+
+static void *_arena_reallocate(struct allocator *allocator, void *pointer,
+                               size_t old_size, size_t new_size) {
+  struct arena *arena = (struct arena *)allocator;
+  old_size = ALIGN(old_size);
+  new_size = ALIGN(new_size);
+  bool is_latest = pointer && (uint8_t *)pointer + old_size == arena->cursor;
+  if (is_latest &&
+      new_size <= old_size + (size_t)(arena->end - arena->cursor)) {
+    arena->cursor = (uint8_t *)pointer + new_size;
+    return new_size ? pointer : NULL;
+  }
+  if (!new_size) {
+    return NULL;
+  }
+
+  void *result = _arena_allocate(arena, new_size);
+  if (result && pointer) {
+    memcpy(result, pointer, old_size < new_size ? old_size : new_size);
+  }
+  return result;
+}
+
+void arena_init(struct arena *arena) {
+  *arena = (struct arena){.allocator = {_arena_reallocate}};
+}
+
+void arena_free(struct arena *arena) {
+  while (arena->blocks) {
+    struct arena_block *next = arena->blocks->next;
+    free(arena->blocks);
+    arena->blocks = next;
+  }
+  arena_init(arena);
+}
+
+void *arena_allocate(struct arena *arena, size_t size) {
+  return _arena_allocate(arena, ALIGN(size));
+}
@@ -1,46 +1,18 @@
 #include "ast.h"
-#include "memory.h"
 #include <stdint.h>
 #include <stdlib.h>
 
-#define CAPACITY_INIT 1024U
-#define CAPACITY_GROW(x) ((x) * 3U / 2U)
-
-static void _block_new(ast_block_t *block, uint32_t size) {
-  *block =
-      reallocate(NULL, 0, sizeof(struct ast_block) + size * sizeof(struct ast));
-  **block =
-      (struct ast_block){.size = size, .next = NULL, .offset = (*block)->data};
-}
-
-void ast_arena_new(struct ast_arena *arena) {
-  _block_new(&arena->blocks, CAPACITY_INIT);
-  arena->current = arena->blocks;
-}
+void ast_arena_new(struct ast_arena *arena) { arena_init(&arena->arena); }
 
 struct ast *ast_arena_make(struct ast_arena *arena) {
-  if (arena->current->offset - arena->current->data >= arena->current->size) {
-    uint32_t new_size = CAPACITY_GROW(arena->current->size);
-    _block_new(&arena->current->next, new_size);
-    arena->current = arena->current->next;
-  }
-  return arena->current->offset++;
+  return arena_allocate(&arena->arena, sizeof(struct ast));
 }
 
-static void _block_free(ast_block_t block) {
-  while (block) {
-    ast_block_t next = block->next;
-    reallocate(block,
-               sizeof(struct ast_block) + block->size * sizeof(struct ast), 0);
-    block = next;
-  }
+char *ast_arena_chars(struct ast_arena *arena, uint32_t length) {
+  return arena_allocate(&arena->arena, length);
 }
 
-void ast_arena_free(struct ast_arena *arena) {
-  _block_free(arena->blocks);
-  arena->blocks = NULL;
-  arena->current = NULL;
-}
+void ast_arena_free(struct ast_arena *arena) { arena_free(&arena->arena); }
 
 #ifdef DEBUG_AST
 
@@ -58,6 +30,8 @@ static const char *node_kind_to_str(enum node_kind kind) {
     return "REAL";
   case NODE_KIND_INTEGER:
     return "INTEGER";
+  case NODE_KIND_STRING:
+    return "STRING";
   case NODE_KIND_NOT:
     return "NOT";
   case NODE_KIND_NEGATE:
@@ -94,6 +68,26 @@ static const char *node_kind_to_str(enum node_kind kind) {
     return "<";
   case NODE_KIND_LESS_EQUAL:
     return "<=";
+  case NODE_KIND_DECLARE:
+    return "DECLARE";
+  case NODE_KIND_CONSTANT:
+    return "CONSTANT";
+  case NODE_KIND_ASSIGN:
+    return "<-";
+  case NODE_KIND_CALL:
+    return "CALL";
+  case NODE_KIND_CALL_STMT:
+    return "CALL";
+  case NODE_KIND_IF:
+    return "IF";
+  case NODE_KIND_RETURN:
+    return "RETURN";
+  case NODE_KIND_FUNCTION:
+    return "FUNCTION";
+  case NODE_KIND_PROCEDURE:
+    return "PROCEDURE";
+  case NODE_KIND_PARAMETER:
+    return "PARAMETER";
   default:
     return "UNKNOWN";
   }
@@ -119,7 +113,10 @@ void ast_print(const struct ast *ast) {
     fprintf(stderr, "'%c'", ast->as.cha);
     break;
   case NODE_KIND_STRING:
-    fprintf(stderr, "%.*s", ast->as.string.length, ast->as.string.chars);
+    fprintf(stderr, "\"%.*s\"", ast->as.string.length, ast->as.string.chars);
+    break;
+  case NODE_KIND_VARIABLE:
+    fprintf(stderr, "%.*s", ast->as.variable.length, ast->as.variable.name);
     break;
   case NODE_KIND_GROUP:
     fputc('(', stderr);
@@ -129,7 +126,7 @@ void ast_print(const struct ast *ast) {
   case NODE_KIND_NOT:
   case NODE_KIND_NEGATE:
   case NODE_KIND_POINTER:
-    printf("(%s ", node_kind_to_str(ast->kind));
+    fprintf(stderr, "(%s ", node_kind_to_str(ast->kind));
     ast_print(ast->as.expr);
     fputc(')', stderr);
     break;
@@ -154,6 +151,69 @@ void ast_print(const struct ast *ast) {
     ast_print(ast->as.binary.rhs);
     fputc(')', stderr);
     break;
+  case NODE_KIND_DECLARE:
+    fprintf(stderr, "(DECLARE %.*s : %s)", ast->as.variable.length,
+            ast->as.variable.name, node_kind_to_str(ast->as.variable.type));
+    break;
+  case NODE_KIND_CONSTANT:
+  case NODE_KIND_ASSIGN:
+    fprintf(stderr, "(%s %.*s ", node_kind_to_str(ast->kind),
+            ast->as.variable.length, ast->as.variable.name);
+    ast_print(ast->as.variable.expr);
+    fputc(')', stderr);
+    break;
+  case NODE_KIND_CALL:
+    fputc('(', stderr);
+    ast_print(ast->as.binary.lhs);
+    fputc(' ', stderr);
+    ast_print(ast->as.binary.rhs);
+    fputc(')', stderr);
+    break;
+  case NODE_KIND_CALL_STMT:
+  case NODE_KIND_RETURN:
+    fprintf(stderr, "(%s ", node_kind_to_str(ast->kind));
+    ast_print(ast->as.expr);
+    fputc(')', stderr);
+    break;
+  case NODE_KIND_IF:
+    fputs("(IF ", stderr);
+    ast_print(ast->as.branch.condition);
+    fputc('\n', stderr);
+    ast_print(ast->as.branch.then);
+    if (ast->as.branch.otherwise) {
+      fputs("\nELSE\n", stderr);
+      ast_print(ast->as.branch.otherwise);
+    }
+    fputc(')', stderr);
+    break;
+  case NODE_KIND_FUNCTION:
+  case NODE_KIND_PROCEDURE:
+    fprintf(stderr, "(%s %.*s : %s\n", node_kind_to_str(ast->kind),
+            ast->as.variable.length, ast->as.variable.name,
+            node_kind_to_str(ast->as.variable.type));
+    ast_print(ast->as.variable.expr);
+    fputc(')', stderr);
+    break;
+  case NODE_KIND_PARAMETER:
+    fprintf(stderr, "(PARAMETER %.*s : %s)", ast->as.variable.length,
+            ast->as.variable.name, node_kind_to_str(ast->as.variable.type));
+    break;
+  case NODE_KIND_BLOCK:
+    for (const struct ast *block = ast; block; block = block->as.list.next) {
+      ast_print(block->as.list.item);
+      if (block->as.list.next) {
+        fputc('\n', stderr);
+      }
+    }
+    break;
+  case NODE_KIND_ARGUMENTS:
+    for (const struct ast *list = ast; list; list = list->as.list.next) {
+      ast_print(list->as.list.item);
+      if (list->as.list.next) {
+        fputs(", ", stderr);
+      }
+    }
+    break;
   }
 }
 
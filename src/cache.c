@@ -0,0 +1,601 @@
+#include "cache.h"
+#include "chunk.h"
+#include "gc.h"
+#include "obj.h"
+#include "table.h"
+#include "value.h"
+#include "vm.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_ALIGN 8U
+#define CACHE_PATH_MAX 4096U
+
+#define ALIGN(size) (((size) + CACHE_ALIGN - 1) & ~(size_t)(CACHE_ALIGN - 1))
+
+// An image is the header, one record per chunk, the table of record offsets
+// and then the objects the chunks' constants point to. Record 0 is the
+// program; the others are the bodies of its routines. Stored pointers are
+// offsets: from the image start for a chunk's parts, from `objects_offset`
+// for constants, and record indices for a function's chunk.
+struct cache_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t layout;
+  uint32_t flags;
+  uint64_t hash;
+  uint64_t checksum;
+  uint64_t length;
+  uint64_t size;
+  uint64_t records_offset;
+  uint64_t record_count;
+  uint64_t objects_offset;
+};
+
+// Where the parts of one chunk go in the image.
+struct cache_record {
+  const struct chunk *chunk;
+  size_t chunk_offset, debug_offset, index_offset, constants_offset;
+  size_t name_offset;
+};
+
+struct cache_slot {
+  const struct obj *obj;
+  size_t offset;
+};
+
+static uint32_t _layout(void) {
+  uint32_t layout = sizeof(struct value) | sizeof(struct obj_string) << 8 |
+                    sizeof(struct chunk) << 16;
+#ifdef VALUE_NAN_BOXING
+  layout |= 1U << 31;
+#endif
+  return layout;
+}
+
+static uint64_t _hash(const void *data, size_t length) {
+  const uint8_t *bytes = data;
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static bool _directory(char *path, size_t size) {
+  const char *dir;
+  int length;
+  if ((dir = getenv("CAMPSEUDO_CACHE_DIR"))) {
+    length = snprintf(path, size, "%s", dir);
+  } else if ((dir = getenv("XDG_CACHE_HOME"))) {
+    length = snprintf(path, size, "%s/campseudo", dir);
+  } else if ((dir = getenv("HOME"))) {
+    length = snprintf(path, size, "%s/.cache/campseudo", dir);
+  } else {
+    return false;
+  }
+  return length > 0 && (size_t)length < size;
+}
+
+static bool _path(char *path, size_t size, uint64_t hash, uint32_t flags) {
+  char dir[CACHE_PATH_MAX];
+  if (!_directory(dir, sizeof(dir))) {
+    return false;
+  }
+  int length = snprintf(path, size, "%s/%016llx-%08x-%u.cpbc", dir,
+                        (unsigned long long)hash, _layout(), flags);
+  return length > 0 && (size_t)length < size;
+}
+
+static bool _make_directories(char *path) {
+  for (char *slash = strchr(path + 1, '/'); slash;
+       slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    bool ok = !mkdir(path, 0755) || errno == EEXIST;
+    *slash = '/';
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static size_t _obj_size(const struct obj *obj) {
+  switch (obj->kind) {
+  case OBJ_KIND_STRING:
+    return sizeof(struct obj_string) + OBJ_AS_STRING(obj)->length + 1;
+  case OBJ_KIND_INTEGER:
+    return sizeof(struct obj_integer);
+  case OBJ_KIND_FUNCTION:
+    return sizeof(struct obj_function);
+  default:
+    return 0;
+  }
+}
+
+static void _obj_write(uint8_t *dest, const struct obj *obj, size_t record) {
+  struct obj header = {obj->kind, true, NULL};
+  switch (obj->kind) {
+  case OBJ_KIND_STRING: {
+    obj_string_t string = (obj_string_t)dest;
+    string->obj = header;
+    string->length = OBJ_AS_STRING(obj)->length;
+    string->is_owned = true;
+    string->hash = OBJ_AS_STRING(obj)->hash;
+    memcpy(string->as.owned, OBJ_AS_CSTRING(obj), string->length);
+    string->as.owned[string->length] = '\0';
+    break;
+  }
+  case OBJ_KIND_INTEGER: {
+    obj_integer_t integer = (obj_integer_t)dest;
+    integer->obj = header;
+    integer->value = OBJ_AS_INTEGER(obj)->value;
+    break;
+  }
+  case OBJ_KIND_FUNCTION: {
+    obj_function_t function = (obj_function_t)dest;
+    function->obj = header;
+    function->arity = OBJ_AS_FUNCTION(obj)->arity;
+    function->locals = OBJ_AS_FUNCTION(obj)->locals;
+    function->chunk = (chunk_t)(uintptr_t)record;
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+static struct cache_slot *_slot(struct cache_slot *slots, uint32_t capacity,
+                                const struct obj *obj) {
+  uint32_t index = (uint32_t)((uintptr_t)obj >> 3) & (capacity - 1);
+  while (slots[index].obj && slots[index].obj != obj) {
+    index = (index + 1) & (capacity - 1);
+  }
+  return slots + index;
+}
+
+static bool _write_file(const char *path, const uint8_t *data, size_t size) {
+  char temp[CACHE_PATH_MAX + 32];
+  snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)getpid());
+
+  FILE *file = fopen(temp, "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = fwrite(data, 1, size, file) == size;
+  ok = !fclose(file) && ok;
+  if (!ok || rename(temp, path)) {
+    remove(temp);
+    return false;
+  }
+  return true;
+}
+
+// Returns the index of the record for `chunk`, or `count` if it has none.
+static size_t _find_record(const struct cache_record *records, size_t count,
+                           const struct chunk *chunk) {
+  size_t index = 0;
+  while (index < count && records[index].chunk != chunk) {
+    ++index;
+  }
+  return index;
+}
+
+// Lists `chunk` and the chunks of every function reachable from its
+// constants, the program first. Returns the number of records, or 0 when
+// out of memory.
+static size_t _collect_records(const struct chunk *chunk,
+                               struct cache_record **records) {
+  size_t count = 1, capacity = 4;
+  *records = malloc(capacity * sizeof(struct cache_record));
+  if (!*records) {
+    return 0;
+  }
+  (*records)[0] = (struct cache_record){.chunk = chunk};
+
+  for (size_t i = 0; i < count; ++i) {
+    const struct value_array *constants = (*records)[i].chunk->constants;
+    for (uint32_t j = 0; j < constants->count; ++j) {
+      struct value value = constants->values[j];
+      if (!value_is_obj(value) ||
+          VALUE_AS_OBJ(value)->kind != OBJ_KIND_FUNCTION) {
+        continue;
+      }
+      const struct chunk *body = OBJ_AS_FUNCTION(VALUE_AS_OBJ(value))->chunk;
+      if (_find_record(*records, count, body) < count) {
+        continue;
+      }
+      if (count == capacity) {
+        capacity *= 2;
+        struct cache_record *grown =
+            realloc(*records, capacity * sizeof(struct cache_record));
+        if (!grown) {
+          free(*records);
+          return 0;
+        }
+        *records = grown;
+      }
+      (*records)[count++] = (struct cache_record){.chunk = body};
+    }
+  }
+  return count;
+}
+
+// Places the parts of `record`'s chunk from `offset` on and returns the end.
+static size_t _place_record(struct cache_record *record, size_t offset) {
+  const struct chunk *chunk = record->chunk;
+  record->chunk_offset = offset;
+  record->debug_offset = ALIGN(offset + sizeof(struct chunk) + chunk->count);
+  record->index_offset = ALIGN(record->debug_offset +
+                               sizeof(struct debug_info) + chunk->debug->count);
+  record->constants_offset =
+      ALIGN(record->index_offset + sizeof(struct debug_index) +
+            chunk->debug->index->count * sizeof(struct debug_anchor));
+  record->name_offset =
+      ALIGN(record->constants_offset + sizeof(struct value_array) +
+            chunk->constants->count * sizeof(struct value));
+  return ALIGN(record->name_offset + (chunk->name ? chunk->name_length : 0));
+}
+
+static void _write_record(uint8_t *data, const struct cache_record *record,
+                          struct cache_slot *slots, uint32_t capacity) {
+  const struct chunk *chunk = record->chunk;
+  const struct debug_info *debug = chunk->debug;
+  const struct debug_index *index = debug->index;
+  const struct value_array *constants = chunk->constants;
+
+  chunk_t image = (chunk_t)(data + record->chunk_offset);
+  image->count = image->capacity = chunk->count;
+  image->globals = chunk->globals;
+  image->max_stack = chunk->max_stack;
+  image->max_frame = chunk->max_frame;
+  image->name_length = chunk->name ? chunk->name_length : 0;
+  image->name = chunk->name ? (const char *)(uintptr_t)record->name_offset
+                            : NULL;
+  image->debug = (debug_info_t)(uintptr_t)record->debug_offset;
+  image->constants = (value_array_t)(uintptr_t)record->constants_offset;
+  memcpy(image->code, chunk->code, chunk->count);
+
+  debug_info_t debug_image = (debug_info_t)(data + record->debug_offset);
+  *debug_image = *debug;
+  debug_image->capacity = debug->count;
+  debug_image->index = (debug_index_t)(uintptr_t)record->index_offset;
+  memcpy(debug_image->data, debug->data, debug->count);
+
+  debug_index_t index_image = (debug_index_t)(data + record->index_offset);
+  index_image->count = index_image->capacity = index->count;
+  memcpy(index_image->anchors, index->anchors,
+         index->count * sizeof(struct debug_anchor));
+
+  value_array_t constants_image =
+      (value_array_t)(data + record->constants_offset);
+  constants_image->count = constants_image->capacity = constants->count;
+  for (uint32_t i = 0; i < constants->count; ++i) {
+    struct value value = constants->values[i];
+    if (value_is_obj(value)) {
+      struct cache_slot *slot = _slot(slots, capacity, VALUE_AS_OBJ(value));
+      value = value_with_obj(value, (obj_t)(uintptr_t)slot->offset);
+    }
+    constants_image->values[i] = value;
+  }
+
+  if (chunk->name) {
+    memcpy(data + record->name_offset, chunk->name, chunk->name_length);
+  }
+}
+
+void cache_store(const char *source, uint32_t flags, const chunk_t chunk) {
+  size_t length = strlen(source);
+  uint64_t hash = _hash(source, length);
+  char path[CACHE_PATH_MAX];
+  if (!_path(path, sizeof(path), hash, flags) || !_make_directories(path)) {
+    return;
+  }
+
+  struct cache_record *records;
+  size_t count = _collect_records(chunk, &records);
+  if (!count) {
+    return;
+  }
+
+  struct cache_header header = {
+      .magic = CACHE_MAGIC,
+      .version = CACHE_VERSION,
+      .layout = _layout(),
+      .flags = flags,
+      .hash = hash,
+      .length = length,
+      .record_count = count,
+  };
+  size_t size = ALIGN(sizeof(struct cache_header));
+  size_t constant_count = 0;
+  for (size_t i = 0; i < count; ++i) {
+    size = _place_record(records + i, size);
+    constant_count += records[i].chunk->constants->count;
+  }
+  header.records_offset = size;
+  header.objects_offset = size = ALIGN(size + count * sizeof(uint64_t));
+
+  uint32_t capacity = 1;
+  while (capacity < constant_count * 2 + 1) {
+    capacity <<= 1;
+  }
+  struct cache_slot *slots = calloc(capacity, sizeof(struct cache_slot));
+  if (!slots) {
+    free(records);
+    return;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    const struct value_array *constants = records[i].chunk->constants;
+    for (uint32_t j = 0; j < constants->count; ++j) {
+      if (!value_is_obj(constants->values[j])) {
+        continue;
+      }
+      obj_t obj = VALUE_AS_OBJ(constants->values[j]);
+      struct cache_slot *slot = _slot(slots, capacity, obj);
+      if (slot->obj) {
+        continue;
+      }
+      size_t obj_size = _obj_size(obj);
+      if (!obj_size) {
+        free(slots);
+        free(records);
+        return;
+      }
+      slot->obj = obj;
+      slot->offset = size - header.objects_offset;
+      size += ALIGN(obj_size);
+    }
+  }
+  header.size = size;
+
+  uint8_t *data = calloc(1, size);
+  if (!data) {
+    free(slots);
+    free(records);
+    return;
+  }
+
+  uint64_t *offsets = (uint64_t *)(data + header.records_offset);
+  for (size_t i = 0; i < count; ++i) {
+    _write_record(data, records + i, slots, capacity);
+    offsets[i] = records[i].chunk_offset;
+  }
+  for (uint32_t i = 0; i < capacity; ++i) {
+    const struct obj *obj = slots[i].obj;
+    if (obj) {
+      size_t record =
+          obj->kind == OBJ_KIND_FUNCTION
+              ? _find_record(records, count, OBJ_AS_FUNCTION(obj)->chunk)
+              : 0;
+      _obj_write(data + header.objects_offset + slots[i].offset, obj, record);
+    }
+  }
+
+  // Everything after the header is covered by the checksum, so a truncated
+  // or corrupted image is recompiled rather than run.
+  size_t start = ALIGN(sizeof(struct cache_header));
+  header.checksum = _hash(data + start, size - start);
+  memcpy(data, &header, sizeof(header));
+
+  _write_file(path, data, size);
+  free(data);
+  free(slots);
+  free(records);
+}
+
+// Whether `count` bytes at `offset` fit aligned between the header and
+// `end`.
+static inline bool _fits(size_t offset, size_t count, size_t end) {
+  return !(offset % CACHE_ALIGN) &&
+         offset >= ALIGN(sizeof(struct cache_header)) && offset <= end &&
+         count <= end - offset;
+}
+
+static bool _check_header(const struct cache_header *header, size_t size,
+                          uint64_t hash, size_t length, uint32_t flags) {
+  return !memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) &&
+         header->version == CACHE_VERSION && header->layout == _layout() &&
+         header->flags == flags && header->hash == hash &&
+         header->length == length && header->size == size &&
+         header->objects_offset <= size && header->record_count &&
+         header->record_count <= size / sizeof(uint64_t) &&
+         _fits(header->records_offset,
+               header->record_count * sizeof(uint64_t),
+               header->objects_offset);
+}
+
+// Points the parts of the chunk record at `offset` at where they were
+// mapped. Every part must lie before the record table at `end`.
+static chunk_t _relocate_chunk(uint8_t *base, size_t offset, size_t end) {
+  if (!_fits(offset, sizeof(struct chunk), end)) {
+    return NULL;
+  }
+  chunk_t chunk = (chunk_t)(base + offset);
+  size_t debug = (uintptr_t)chunk->debug;
+  size_t constants = (uintptr_t)chunk->constants;
+  size_t name = (uintptr_t)chunk->name;
+  if (!_fits(offset, sizeof(struct chunk) + chunk->count, end) ||
+      !_fits(debug, sizeof(struct debug_info), end) ||
+      !_fits(constants, sizeof(struct value_array), end) ||
+      (name && !_fits(name, chunk->name_length, end))) {
+    return NULL;
+  }
+  chunk->debug = (debug_info_t)(base + debug);
+  chunk->constants = (value_array_t)(base + constants);
+  chunk->name = name ? (const char *)(base + name) : NULL;
+
+  size_t index = (uintptr_t)chunk->debug->index;
+  if (!_fits(debug, sizeof(struct debug_info) + chunk->debug->count, end) ||
+      !_fits(index, sizeof(struct debug_index), end) ||
+      !_fits(constants,
+             sizeof(struct value_array) +
+                 chunk->constants->count * sizeof(struct value),
+             end)) {
+    return NULL;
+  }
+  chunk->debug->index = (debug_index_t)(base + index);
+  if (!_fits(index,
+             sizeof(struct debug_index) +
+                 chunk->debug->index->count * sizeof(struct debug_anchor),
+             end)) {
+    return NULL;
+  }
+  return chunk;
+}
+
+// Checks the objects from the end of the record table to the end of the
+// image. Their strings must be new to the VM: a constant that resolved to a
+// string the VM already had would only be kept alive while its chunk runs.
+static bool _check_objects(uint8_t *objects, size_t size, const struct vm *vm,
+                           size_t chunk_count) {
+  for (size_t offset = 0; offset < size;) {
+    obj_t obj = (obj_t)(objects + offset);
+    if (size - offset < sizeof(struct obj) ||
+        (obj->kind == OBJ_KIND_STRING &&
+         size - offset < sizeof(struct obj_string))) {
+      return false;
+    }
+    size_t obj_size = _obj_size(obj);
+    if (!obj_size || obj_size > size - offset) {
+      return false;
+    }
+    if (obj->kind == OBJ_KIND_STRING) {
+      obj_string_t string = OBJ_AS_STRING(obj);
+      if (table_find_string(vm->strings, string->as.owned, string->length,
+                            string->hash)) {
+        return false;
+      }
+    } else if (obj->kind == OBJ_KIND_FUNCTION) {
+      size_t record = (uintptr_t)OBJ_AS_FUNCTION(obj)->chunk;
+      if (!record || record >= chunk_count) {
+        return false;
+      }
+    }
+    offset += ALIGN(obj_size);
+  }
+  return true;
+}
+
+// Interns the checked strings and gives functions their chunks.
+static void _link_objects(uint8_t *objects, size_t size, struct vm *vm,
+                          const chunk_t *chunks) {
+  for (size_t offset = 0; offset < size;) {
+    obj_t obj = (obj_t)(objects + offset);
+    if (obj->kind == OBJ_KIND_STRING) {
+      table_insert(&vm->strings, OBJ_AS_STRING(obj), TABLE_NIL);
+    } else if (obj->kind == OBJ_KIND_FUNCTION) {
+      obj_function_t function = OBJ_AS_FUNCTION(obj);
+      function->chunk = chunks[(uintptr_t)function->chunk];
+    }
+    offset += ALIGN(_obj_size(obj));
+  }
+}
+
+// Points every object constant of `chunk` into the objects region.
+static bool _relocate_constants(chunk_t chunk, uint8_t *objects, size_t size) {
+  struct value *values = chunk->constants->values;
+  for (uint32_t i = 0; i < chunk->constants->count; ++i) {
+    if (!value_is_obj(values[i])) {
+      continue;
+    }
+    size_t offset = (uintptr_t)VALUE_AS_OBJ(values[i]);
+    if (offset % CACHE_ALIGN || offset >= size ||
+        size - offset < sizeof(struct obj)) {
+      return false;
+    }
+    values[i] = value_with_obj(values[i], (obj_t)(objects + offset));
+  }
+  return true;
+}
+
+static bool _relocate(uint8_t *base, const struct cache_header *header,
+                      struct vm *vm, chunk_t *chunk) {
+  size_t count = header->record_count;
+  const uint64_t *offsets = (const uint64_t *)(base + header->records_offset);
+  chunk_t *chunks = malloc(count * sizeof(chunk_t));
+  if (!chunks) {
+    return false;
+  }
+
+  uint8_t *objects = base + header->objects_offset;
+  size_t objects_size = header->size - header->objects_offset;
+  bool ok = true;
+  for (size_t i = 0; ok && i < count; ++i) {
+    ok = (chunks[i] = _relocate_chunk(base, offsets[i],
+                                      header->records_offset)) != NULL;
+  }
+  ok = ok && _check_objects(objects, objects_size, vm, count);
+  for (size_t i = 0; ok && i < count; ++i) {
+    ok = _relocate_constants(chunks[i], objects, objects_size);
+  }
+  if (ok) {
+    _link_objects(objects, objects_size, vm, chunks);
+    *chunk = chunks[0];
+  }
+  free(chunks);
+  return ok;
+}
+
+bool cache_load(struct cache *cache, struct vm *vm, const char *source,
+                uint32_t flags, chunk_t *chunk) {
+  size_t length = strlen(source);
+  uint64_t hash = _hash(source, length);
+  char path[CACHE_PATH_MAX];
+  if (!_path(path, sizeof(path), hash, flags)) {
+    return false;
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) ||
+      (size_t)info.st_size < ALIGN(sizeof(struct cache_header))) {
+    close(fd);
+    return false;
+  }
+  size_t size = info.st_size;
+  uint8_t *base =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return false;
+  }
+
+  const struct cache_header *header = (const struct cache_header *)base;
+  size_t start = ALIGN(sizeof(struct cache_header));
+  bool ok = _check_header(header, size, hash, length, flags) &&
+            _hash(base + start, size - start) == header->checksum;
+  if (ok) {
+    gc_pause(&vm->gc);
+    ok = _relocate(base, header, vm, chunk);
+    gc_resume(&vm->gc);
+  }
+  if (!ok) {
+    munmap(base, size);
+    return false;
+  }
+
+  cache->map = base;
+  cache->size = size;
+  return true;
+}
+
+void cache_unload(struct cache *cache) {
+  if (cache->map) {
+    munmap(cache->map, cache->size);
+  }
+  cache->map = NULL;
+  cache->size = 0;
+}
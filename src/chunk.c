@@ -1,68 +1,42 @@
 #include "chunk.h"
 #include "memory.h"
 #include "obj.h"
+#include "types.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define CAPACITY_INIT 8U
 #define CAPACITY_MULT 2U
 
-static void _line_write(line_array_t *array, uint32_t line) {
-  uint32_t count = (*array)->count;
-  if (count > 1 && line == (*array)->lines[count - 2]) {
-    (*array)->lines[count - 1]++;
-    return;
-  }
-
-  if ((*array)->capacity < count + 2) {
-    uint32_t new_capacity = (*array)->capacity * CAPACITY_MULT;
-    void *temp = reallocate(
-        *array,
-        sizeof(struct line_array) + (*array)->capacity * sizeof(uint32_t),
-        sizeof(struct line_array) + new_capacity * sizeof(uint32_t));
-    if (!temp) {
-      free(*array);
-      exit(1);
-    }
-    *array = temp;
-    (*array)->capacity = new_capacity;
-  }
-
-  (*array)->lines[count] = line;
-  (*array)->lines[count + 1] = 1;
-  (*array)->count += 2;
-}
-
 void chunk_init(chunk_t *chunk) {
   *chunk = reallocate(NULL, 0, sizeof(struct chunk) + CAPACITY_INIT);
   (*chunk)->count = 0;
+  (*chunk)->globals = (*chunk)->max_stack = (*chunk)->max_frame = 0;
+  (*chunk)->name = NULL;
+  (*chunk)->name_length = 0;
   value_array_new(&(*chunk)->constants);
   (*chunk)->capacity = CAPACITY_INIT;
-  (*chunk)->lines = reallocate(
-      NULL, 0, sizeof(struct line_array) + sizeof(uint32_t) * CAPACITY_INIT);
-  (*chunk)->lines->capacity = CAPACITY_INIT;
-  (*chunk)->lines->count = 0;
+  debug_info_new(&(*chunk)->debug);
 }
 
 void chunk_free(chunk_t *chunk) {
   value_array_free(&(*chunk)->constants);
-  reallocate(
-      (*chunk)->lines,
-      sizeof(line_array_t) + sizeof(uint32_t) * (*chunk)->lines->capacity, 0);
-  reallocate(*chunk, sizeof(struct chunk) + CAPACITY_INIT, 0);
+  debug_info_free(&(*chunk)->debug);
+  reallocate(*chunk, sizeof(struct chunk) + (*chunk)->capacity, 0);
   *chunk = NULL;
 }
 
-void chunk_write(chunk_t *chunk, enum opcode byte, uint32_t line) {
+void chunk_write(chunk_t *chunk, enum opcode byte, struct location location) {
   if ((*chunk)->capacity < (*chunk)->count + 1) {
     uint32_t new_capcity = (*chunk)->capacity * CAPACITY_MULT;
     *chunk = reallocate(*chunk, sizeof(struct chunk) + (*chunk)->capacity,
                         sizeof(struct chunk) + new_capcity);
     (*chunk)->capacity = new_capcity;
   }
+  debug_info_write(&(*chunk)->debug, (*chunk)->count, location);
   (*chunk)->code[(*chunk)->count++] = byte;
-  _line_write(&(*chunk)->lines, line);
 }
 
 uint32_t chunk_add_constant(chunk_t chunk, struct value value) {
@@ -71,127 +45,742 @@ uint32_t chunk_add_constant(chunk_t chunk, struct value value) {
 }
 
 uint32_t chunk_write_constant(chunk_t *chunk, struct value value,
-                              uint32_t line) {
+                              struct location location) {
   uint32_t constant = chunk_add_constant(*chunk, value);
 
-  chunk_write(chunk, constant & 0xFFU, line);
-  chunk_write(chunk, constant & 0xFF00U, line);
-  chunk_write(chunk, constant & 0xFF0000U, line);
+  chunk_write(chunk, constant & 0xFFU, location);
+  chunk_write(chunk, (constant >> 8) & 0xFFU, location);
+  chunk_write(chunk, (constant >> 16) & 0xFFU, location);
 
   return constant;
 }
 
-uint32_t chunk_get_line(chunk_t chunk, uint32_t index) {
-  line_array_t array = chunk->lines;
-  uint32_t n = 0;
-  for (uint32_t i = 1; i < array->count; i += 2) {
-    if (index < (n += array->lines[i])) {
-      return array->lines[i - 1];
+struct location chunk_get_location(const struct chunk *chunk, uint32_t index) {
+  return debug_info_lookup(chunk->debug, index, NULL);
+}
+
+static const uint8_t g_OPCODE_LENGTH[] = {
+#define OPCODE(name, length, effect) length,
+#include "opcodes.def"
+#undef OPCODE
+};
+
+static const char *const g_OPCODE_NAMES[] = {
+#define OPCODE(name, length, effect) "OP_" #name,
+#include "opcodes.def"
+#undef OPCODE
+};
+
+uint32_t chunk_opcode_length(enum opcode opcode) {
+  return g_OPCODE_LENGTH[opcode];
+}
+
+const char *chunk_opcode_name(enum opcode opcode) {
+  return g_OPCODE_NAMES[opcode];
+}
+
+struct local {
+  const char *name;
+  uint32_t length;
+  enum node_kind type;
+  bool is_constant;
+};
+
+// `routine` is the FUNCTION or PROCEDURE being compiled, or NULL for the main
+// program. A routine's parameters and locals are slots relative to the base
+// of its call frame. `depth` follows the operand stack as code is written.
+struct compiler {
+  chunk_t *chunk;
+  globals_t *globals;
+  obj_t *objects;
+  table_t *strings;
+  const struct ast *routine;
+  uint32_t local_count;
+  int32_t depth, max_depth;
+  bool had_error;
+  struct local locals[CHUNK_LOCALS_MAX];
+};
+
+void globals_init(globals_t *globals) {
+  *globals = reallocate(NULL, 0,
+                        sizeof(struct globals) +
+                            CAPACITY_INIT * sizeof(struct global));
+  (*globals)->count = 0;
+  (*globals)->capacity = CAPACITY_INIT;
+  (*globals)->max_frame = 0;
+}
+
+// Drops every global from slot `count` on.
+static void _forget(globals_t globals, uint32_t count) {
+  for (uint32_t slot = count; slot < globals->count; ++slot) {
+    struct global *global = globals->globals + slot;
+    if (global->parameters) {
+      reallocate(global->parameters, global->arity * sizeof(enum node_kind),
+                 0);
+    }
+  }
+  globals->count = count;
+}
+
+void globals_free(globals_t *globals) {
+  _forget(*globals, 0);
+  reallocate(*globals,
+             sizeof(struct globals) +
+                 (*globals)->capacity * sizeof(struct global),
+             0);
+  *globals = NULL;
+}
+
+static void _error(struct compiler *compiler, const struct ast *ast,
+                   const char *message) {
+  type_error(ast, message);
+  compiler->had_error = true;
+}
+
+static inline bool _is_routine(const struct ast *ast) {
+  return ast->kind == NODE_KIND_FUNCTION || ast->kind == NODE_KIND_PROCEDURE;
+}
+
+int32_t globals_resolve(const struct globals *globals, const struct ast *ast) {
+  uint32_t length = ast->as.variable.length;
+  uint32_t hash = table_hash(ast->as.variable.name, length);
+  for (uint32_t slot = 0; slot < globals->count; ++slot) {
+    const struct global *global = globals->globals + slot;
+    if (global->hash == hash && global->length == length &&
+        !memcmp(global->name, ast->as.variable.name, length)) {
+      return (int32_t)slot;
+    }
+  }
+  return -1;
+}
+
+static int32_t _resolve_local(const struct compiler *compiler,
+                              const struct ast *ast) {
+  uint32_t length = ast->as.variable.length;
+  for (uint32_t slot = 0; slot < compiler->local_count; ++slot) {
+    const struct local *local = compiler->locals + slot;
+    if (local->length == length &&
+        !memcmp(local->name, ast->as.variable.name, length)) {
+      return (int32_t)slot;
+    }
+  }
+  return -1;
+}
+
+int32_t globals_declare(globals_t *globals, const struct ast *ast,
+                        enum global_kind kind, enum node_kind type) {
+  if (globals_resolve(*globals, ast) >= 0) {
+    type_error(ast, "Already declared.");
+    return -1;
+  }
+  if ((*globals)->count >= CHUNK_GLOBALS_MAX) {
+    type_error(ast, "Too many global variables.");
+    return -1;
+  }
+
+  if ((*globals)->capacity < (*globals)->count + 1) {
+    uint32_t new_capacity = (*globals)->capacity * CAPACITY_MULT;
+    *globals = reallocate(
+        *globals,
+        sizeof(struct globals) + (*globals)->capacity * sizeof(struct global),
+        sizeof(struct globals) + new_capacity * sizeof(struct global));
+    (*globals)->capacity = new_capacity;
+  }
+
+  uint32_t length = ast->as.variable.length;
+  (*globals)->globals[(*globals)->count] = (struct global){
+      ast->as.variable.name, length,
+      table_hash(ast->as.variable.name, length), kind, type};
+  return (int32_t)(*globals)->count++;
+}
+
+static int32_t _declare(struct compiler *compiler, const struct ast *ast,
+                        enum global_kind kind, enum node_kind type) {
+  int32_t slot = globals_declare(compiler->globals, ast, kind, type);
+  compiler->had_error |= slot < 0;
+  return slot;
+}
+
+static int32_t _declare_local(struct compiler *compiler, const struct ast *ast,
+                              enum node_kind type, bool is_constant) {
+  if (_resolve_local(compiler, ast) >= 0) {
+    _error(compiler, ast, "Already declared.");
+    return -1;
+  }
+  if (compiler->local_count >= CHUNK_LOCALS_MAX) {
+    _error(compiler, ast, "Too many local variables.");
+    return -1;
+  }
+  compiler->locals[compiler->local_count] = (struct local){
+      ast->as.variable.name, ast->as.variable.length, type, is_constant};
+  return (int32_t)compiler->local_count++;
+}
+
+static const int8_t g_STACK_EFFECT[] = {
+#define OPCODE(name, length, effect) effect,
+#include "opcodes.def"
+#undef OPCODE
+};
+
+static void _adjust_depth(struct compiler *compiler, int32_t delta) {
+  compiler->depth += delta;
+  if (compiler->depth > compiler->max_depth) {
+    compiler->max_depth = compiler->depth;
+  }
+}
+
+static inline struct location _at(const struct ast *ast) {
+  return (struct location){ast->line, ast->column};
+}
+
+static void _write_op(struct compiler *compiler, enum opcode opcode,
+                      struct location location) {
+  chunk_write(compiler->chunk, opcode, location);
+  _adjust_depth(compiler, g_STACK_EFFECT[opcode]);
+}
+
+static void _write_value(struct compiler *compiler, struct value value,
+                         struct location location) {
+  chunk_t *chunk = compiler->chunk;
+  if (UINT8_MAX > (*chunk)->constants->count) {
+    _write_op(compiler, OPCODE_CONSTANT, location);
+    chunk_write(chunk, chunk_add_constant(*chunk, value), location);
+  } else {
+    _write_op(compiler, OPCODE_CONSTANT_LONG, location);
+    chunk_write_constant(chunk, value, location);
+  }
+}
+
+static void _write_byte(struct compiler *compiler, enum opcode opcode,
+                        uint32_t operand, struct location location) {
+  _write_op(compiler, opcode, location);
+  chunk_write(compiler->chunk, operand, location);
+}
+
+static void _write_short(struct compiler *compiler, enum opcode opcode,
+                         uint32_t operand, struct location location) {
+  _write_op(compiler, opcode, location);
+  chunk_write(compiler->chunk, operand & 0xFF, location);
+  chunk_write(compiler->chunk, (operand >> 8) & 0xFF, location);
+}
+
+// Returns the offset of the jump's operand for `_patch_jump`.
+static uint32_t _write_jump(struct compiler *compiler, enum opcode opcode,
+                            struct location location) {
+  _write_short(compiler, opcode, UINT16_MAX, location);
+  return (*compiler->chunk)->count - 2;
+}
+
+static void _patch_jump(struct compiler *compiler, const struct ast *ast,
+                        uint32_t offset) {
+  uint32_t jump = (*compiler->chunk)->count - offset - 2;
+  if (jump > UINT16_MAX) {
+    _error(compiler, ast, "Too much code to jump over.");
+    return;
+  }
+  (*compiler->chunk)->code[offset] = jump & 0xFF;
+  (*compiler->chunk)->code[offset + 1] = jump >> 8;
+}
+
+// Reports the error of a rule the operands failed and returns its type.
+static enum node_kind _check(struct compiler *compiler, const struct ast *ast,
+                             const struct type_rule *rule) {
+  if (rule->message[0]) {
+    _error(compiler, ast, rule->message);
+  }
+  return rule->type;
+}
+
+// Widens the INTEGER operands a rule flags: the right one on top of the
+// stack, the left one below it.
+static void _widen(struct compiler *compiler, const struct type_rule *rule,
+                   struct location location) {
+  if (rule->widen_lhs) {
+    _write_op(compiler, OPCODE_TO_REAL_UNDER, location);
+  }
+  if (rule->widen_rhs) {
+    _write_op(compiler, OPCODE_TO_REAL, location);
+  }
+}
+
+// Checks that the value of type `from` on top of the stack may be stored as
+// a `to`, widening an INTEGER into a REAL.
+static void _convert(struct compiler *compiler, const struct ast *ast,
+                     enum node_kind from, enum node_kind to) {
+  struct type_rule rule = type_convert(from, to);
+  if (_check(compiler, ast, &rule) != TYPE_ERROR) {
+    _widen(compiler, &rule, _at(ast));
+  }
+}
+
+static enum node_kind _expression(struct compiler *compiler, struct ast *ast);
+
+static enum node_kind _variable(struct compiler *compiler, struct ast *ast) {
+  int32_t slot = _resolve_local(compiler, ast);
+  if (slot >= 0) {
+    _write_byte(compiler, OPCODE_GET_LOCAL, slot, _at(ast));
+    return compiler->locals[slot].type;
+  }
+
+  slot = globals_resolve(*compiler->globals, ast);
+  if (slot < 0) {
+    _error(compiler, ast, "Undeclared variable.");
+    return TYPE_ERROR;
+  }
+  const struct global *global = (*compiler->globals)->globals + slot;
+  if (global->kind >= GLOBAL_KIND_FUNCTION) {
+    _error(compiler, ast, "Routines can only be called.");
+    return TYPE_ERROR;
+  }
+  _write_short(compiler, OPCODE_GET_GLOBAL, slot, _at(ast));
+  return global->type;
+}
+
+static enum node_kind _call(struct compiler *compiler, struct ast *ast,
+                            bool is_statement) {
+  const struct ast *callee = ast->as.binary.lhs;
+  if (callee->kind != NODE_KIND_VARIABLE) {
+    _error(compiler, ast, "Can only call routines.");
+    return TYPE_ERROR;
+  }
+
+  int32_t slot = -1;
+  if (_resolve_local(compiler, callee) < 0 &&
+      (slot = globals_resolve(*compiler->globals, callee)) < 0) {
+    _error(compiler, callee, "Undeclared routine.");
+    return TYPE_ERROR;
+  }
+  const struct global *global =
+      slot >= 0 ? (*compiler->globals)->globals + slot : NULL;
+  if (!global || global->kind < GLOBAL_KIND_FUNCTION) {
+    _error(compiler, callee, "Can only call routines.");
+    return TYPE_ERROR;
+  }
+  if (is_statement && global->kind != GLOBAL_KIND_PROCEDURE) {
+    _error(compiler, callee, "Only procedures can be CALLed.");
+    return TYPE_ERROR;
+  }
+  if (!is_statement && global->kind != GLOBAL_KIND_FUNCTION) {
+    _error(compiler, callee, "Procedures must be invoked with CALL.");
+    return TYPE_ERROR;
+  }
+
+  uint32_t count = 0;
+  for (struct ast *argument = ast->as.binary.rhs; argument;
+       argument = argument->as.list.next, ++count) {
+    struct ast *item = argument->as.list.item;
+    enum node_kind type = _expression(compiler, item);
+    if (count < global->arity) {
+      _convert(compiler, item, type, global->parameters[count]);
     }
   }
-  return 0;
+  if (count != global->arity) {
+    char message[64];
+    snprintf(message, sizeof(message), "Expected %u arguments but got %u.",
+             global->arity, count);
+    _error(compiler, callee, message);
+    return TYPE_ERROR;
+  }
+
+  _adjust_depth(compiler, -(int32_t)count);
+  _write_short(compiler, OPCODE_CALL, slot, _at(ast));
+  chunk_write(compiler->chunk, count, _at(ast));
+  return global->type;
+}
+
+// AND and OR short-circuit: the right operand only runs when it decides the
+// result. Each arm pushes one value onto the same starting depth.
+static enum node_kind _logical(struct compiler *compiler, struct ast *ast) {
+  enum node_kind lhs = _expression(compiler, ast->as.binary.lhs);
+  enum node_kind rhs = TYPE_ERROR;
+  uint32_t skip = _write_jump(compiler, OPCODE_JUMP_IF_FALSE, _at(ast));
+  int32_t depth = compiler->depth;
+  if (ast->kind == NODE_KIND_AND) {
+    rhs = _expression(compiler, ast->as.binary.rhs);
+  } else {
+    _write_op(compiler, OPCODE_TRUE, _at(ast));
+  }
+  uint32_t end = _write_jump(compiler, OPCODE_JUMP, _at(ast));
+  _patch_jump(compiler, ast, skip);
+  compiler->depth = depth;
+  if (ast->kind == NODE_KIND_AND) {
+    _write_op(compiler, OPCODE_FALSE, _at(ast));
+  } else {
+    rhs = _expression(compiler, ast->as.binary.rhs);
+  }
+  _patch_jump(compiler, ast, end);
+
+  struct type_rule rule = type_binary(ast->kind, lhs, rhs);
+  return _check(compiler, ast, &rule);
 }
 
-void chunk_write_from_ast(chunk_t *chunk, struct ast *ast, obj_t *objects,
-                          table_t *strings) {
-#define WRITE_VALUE(value)                                                     \
-  do {                                                                         \
-    if (255 > (*chunk)->count) {                                               \
-      chunk_write(chunk, OPCODE_CONSTANT, ast->line);                          \
-      chunk_write(chunk, chunk_add_constant(*chunk, value), ast->line);        \
-    } else {                                                                   \
-      chunk_write(chunk, OPCODE_CONSTANT_LONG, ast->line);                     \
-      chunk_write_constant(chunk, value, ast->line);                           \
-    }                                                                          \
-  } while (false)
+static enum node_kind _unary(struct compiler *compiler, struct ast *ast) {
+  enum node_kind type = _expression(compiler, ast->as.expr);
+  struct type_rule rule = type_unary(ast->kind, type);
+  if (_check(compiler, ast, &rule) == TYPE_ERROR) {
+    return TYPE_ERROR;
+  }
+  if (ast->kind == NODE_KIND_NOT) {
+    _write_op(compiler, OPCODE_NOT, _at(ast));
+  } else {
+    _write_op(compiler,
+              rule.operand == NODE_KIND_INTEGER ? OPCODE_NEGATE_INT
+                                                : OPCODE_NEGATE_REAL,
+              _at(ast));
+  }
+  return rule.type;
+}
 
-#define WRITE_UNARY(opcode)                                                    \
-  chunk_write_from_ast(chunk, ast->as.expr, objects, strings);                          \
-  chunk_write(chunk, opcode, ast->line)
+// Writes `int_opcode` when the operands are INTEGERs, `real_opcode` when
+// they are REALs once widened, and the generic `opcode` otherwise.
+static enum node_kind _binary(struct compiler *compiler, struct ast *ast,
+                              enum opcode opcode, enum opcode int_opcode,
+                              enum opcode real_opcode) {
+  enum node_kind lhs = _expression(compiler, ast->as.binary.lhs);
+  enum node_kind rhs = _expression(compiler, ast->as.binary.rhs);
+  struct type_rule rule = type_binary(ast->kind, lhs, rhs);
+  if (_check(compiler, ast, &rule) == TYPE_ERROR) {
+    return TYPE_ERROR;
+  }
+  _widen(compiler, &rule, _at(ast));
+  _write_op(compiler,
+            rule.operand == NODE_KIND_INTEGER ? int_opcode
+            : rule.operand == NODE_KIND_REAL  ? real_opcode
+                                              : opcode,
+            _at(ast));
+  return rule.type;
+}
 
-#define WRITE_BINARY(opcode)                                                   \
-  chunk_write_from_ast(chunk, ast->as.binary.lhs, objects, strings);                    \
-  chunk_write_from_ast(chunk, ast->as.binary.rhs, objects, strings);                    \
-  chunk_write(chunk, opcode, ast->line)
+// Writes the code for an expression and returns its type.
+static enum node_kind _expression(struct compiler *compiler, struct ast *ast) {
+#define WRITE_VALUE(value) _write_value(compiler, value, _at(ast))
 
   switch (ast->kind) {
   case NODE_KIND_BOOL:
-    chunk_write(chunk, ast->as.boolean ? OPCODE_TRUE : OPCODE_FALSE, ast->line);
-    break;
+    _write_op(compiler, ast->as.boolean ? OPCODE_TRUE : OPCODE_FALSE,
+              _at(ast));
+    return NODE_KIND_BOOL;
   case NODE_KIND_CHAR:
     WRITE_VALUE(VALUE_FROM_CHAR(ast->as.cha));
-    break;
+    return NODE_KIND_CHAR;
   case NODE_KIND_REAL:
     WRITE_VALUE(VALUE_FROM_REAL(ast->as.real));
-    break;
+    return NODE_KIND_REAL;
   case NODE_KIND_INTEGER:
-    WRITE_VALUE(VALUE_FROM_INTEGER(ast->as.integer));
-    break;
+    WRITE_VALUE(value_from_integer(compiler->objects, ast->as.integer));
+    return NODE_KIND_INTEGER;
   case NODE_KIND_STRING:
-    WRITE_VALUE(VALUE_FROM_OBJ(obj_string_ref(objects, strings,
-                                              ast->as.string.chars + 1,
-                                              ast->as.string.length - 2)));
-    break;
+    WRITE_VALUE(VALUE_FROM_OBJ(
+        (ast->as.string.in_arena ? obj_string_copy : obj_string_ref)(
+            compiler->objects, compiler->strings, ast->as.string.chars,
+            ast->as.string.length)));
+    return NODE_KIND_STRING;
+  case NODE_KIND_VARIABLE:
+    return _variable(compiler, ast);
   case NODE_KIND_NOT:
-    WRITE_UNARY(OPCODE_NOT);
-    break;
   case NODE_KIND_NEGATE:
-    WRITE_UNARY(OPCODE_NEGATE);
-    break;
-  case NODE_KIND_POINTER:
-    // WRITE_UNARY(OPCODE_POINTER);
-    break;
+    return _unary(compiler, ast);
   case NODE_KIND_GROUP:
-    chunk_write_from_ast(chunk, ast->as.expr, objects, strings);
-    break;
+    return _expression(compiler, ast->as.expr);
   case NODE_KIND_ADD:
-    WRITE_BINARY(OPCODE_ADD);
+    return _binary(compiler, ast, OPCODE_COUNT, OPCODE_ADD_INT,
+                   OPCODE_ADD_REAL);
   case NODE_KIND_SUB:
-    break;
-    WRITE_BINARY(OPCODE_SUB);
+    return _binary(compiler, ast, OPCODE_COUNT, OPCODE_SUB_INT,
+                   OPCODE_SUB_REAL);
   case NODE_KIND_MUL:
-    WRITE_BINARY(OPCODE_MUL);
-    break;
+    return _binary(compiler, ast, OPCODE_COUNT, OPCODE_MUL_INT,
+                   OPCODE_MUL_REAL);
   case NODE_KIND_DIV:
-    WRITE_BINARY(OPCODE_DIV);
-    break;
   case NODE_KIND_INT_DIV:
-    WRITE_BINARY(OPCODE_DIV);
-    break;
+    return _binary(compiler, ast, OPCODE_COUNT, OPCODE_DIV_INT,
+                   OPCODE_DIV_REAL);
   case NODE_KIND_MOD:
-    // WRITE_BINARY(OPCODE_MOD);
-    break;
+    return _binary(compiler, ast, OPCODE_COUNT, OPCODE_MOD_INT, OPCODE_COUNT);
   case NODE_KIND_AND:
-    // WRITE_BINARY(OPCODE_AND);
-    break;
   case NODE_KIND_OR:
-    // WRITE_BINARY(OPCODE_OR);
-    break;
+    return _logical(compiler, ast);
   case NODE_KIND_CONCAT:
-    WRITE_BINARY(OPCODE_CONCAT);
-    break;
+    return _binary(compiler, ast, OPCODE_CONCAT, OPCODE_COUNT, OPCODE_COUNT);
   case NODE_KIND_EQUAL:
-    WRITE_BINARY(OPCODE_EQUAL);
-    break;
+    return _binary(compiler, ast, OPCODE_EQUAL, OPCODE_EQUAL, OPCODE_EQUAL);
   case NODE_KIND_NOT_EQUAL:
-    WRITE_BINARY(OPCODE_NOT_EQUAL);
-    break;
+    return _binary(compiler, ast, OPCODE_NOT_EQUAL, OPCODE_NOT_EQUAL,
+                   OPCODE_NOT_EQUAL);
   case NODE_KIND_GREATER:
-    WRITE_BINARY(OPCODE_GREATER);
-    break;
+    return _binary(compiler, ast, OPCODE_GREATER, OPCODE_GREATER_INT,
+                   OPCODE_GREATER_REAL);
   case NODE_KIND_GREATER_EQUAL:
-    WRITE_BINARY(OPCODE_GREATER_EQUAL);
-    break;
+    return _binary(compiler, ast, OPCODE_GREATER_EQUAL,
+                   OPCODE_GREATER_EQUAL_INT, OPCODE_GREATER_EQUAL_REAL);
   case NODE_KIND_LESS:
-    WRITE_BINARY(OPCODE_LESS);
-    break;
+    return _binary(compiler, ast, OPCODE_LESS, OPCODE_LESS_INT,
+                   OPCODE_LESS_REAL);
   case NODE_KIND_LESS_EQUAL:
-    WRITE_BINARY(OPCODE_LESS_EQUAL);
+    return _binary(compiler, ast, OPCODE_LESS_EQUAL, OPCODE_LESS_EQUAL_INT,
+                   OPCODE_LESS_EQUAL_REAL);
+  case NODE_KIND_CALL:
+    return _call(compiler, ast, false);
+  default:
+    _error(compiler, ast, "Unsupported expression.");
+    return TYPE_ERROR;
+  }
+#undef WRITE_VALUE
+}
+
+static void _write_default(struct compiler *compiler, enum node_kind type,
+                           struct location location) {
+  switch (type) {
+  case NODE_KIND_CHAR:
+    _write_value(compiler, VALUE_FROM_CHAR(' '), location);
+    break;
+  case NODE_KIND_REAL:
+    _write_value(compiler, VALUE_FROM_REAL(0.0), location);
+    break;
+  case NODE_KIND_INTEGER:
+    _write_value(compiler, VALUE_FROM_INTEGER(0), location);
+    break;
+  case NODE_KIND_STRING:
+    _write_value(compiler,
+                 VALUE_FROM_OBJ(obj_string_copy(compiler->objects,
+                                                compiler->strings, "", 0)),
+                 location);
+    break;
+  default:
+    _write_op(compiler, OPCODE_FALSE, location);
+    break;
+  }
+}
+
+// Declares a DECLARE or CONSTANT of `type` and stores the value on top of
+// the stack in it: a local inside a routine, a global in the main program.
+static void _define(struct compiler *compiler, const struct ast *ast,
+                    enum node_kind type) {
+  bool is_constant = ast->kind == NODE_KIND_CONSTANT;
+  if (compiler->routine) {
+    int32_t slot = _declare_local(compiler, ast, type, is_constant);
+    if (slot >= 0) {
+      _write_byte(compiler, OPCODE_SET_LOCAL, slot, _at(ast));
+    }
+    return;
+  }
+
+  int32_t slot = _declare(
+      compiler, ast, is_constant ? GLOBAL_KIND_CONSTANT : GLOBAL_KIND_VARIABLE,
+      type);
+  if (slot >= 0) {
+    _write_short(compiler, OPCODE_SET_GLOBAL, slot, _at(ast));
+  }
+}
+
+static void _assign(struct compiler *compiler, struct ast *ast) {
+  int32_t slot = _resolve_local(compiler, ast);
+  if (slot >= 0) {
+    if (compiler->locals[slot].is_constant) {
+      _error(compiler, ast, "Cannot assign to a constant.");
+      return;
+    }
+    _convert(compiler, ast, _expression(compiler, ast->as.variable.expr),
+             compiler->locals[slot].type);
+    _write_byte(compiler, OPCODE_SET_LOCAL, slot, _at(ast));
+    return;
+  }
+
+  slot = globals_resolve(*compiler->globals, ast);
+  enum global_kind kind =
+      slot >= 0 ? (*compiler->globals)->globals[slot].kind
+                : GLOBAL_KIND_VARIABLE;
+  if (slot < 0) {
+    _error(compiler, ast, "Undeclared variable.");
+  } else if (kind == GLOBAL_KIND_CONSTANT) {
+    _error(compiler, ast, "Cannot assign to a constant.");
+  } else if (kind != GLOBAL_KIND_VARIABLE) {
+    _error(compiler, ast, "Routines can only be called.");
+  } else {
+    _convert(compiler, ast, _expression(compiler, ast->as.variable.expr),
+             (*compiler->globals)->globals[slot].type);
+    _write_short(compiler, OPCODE_SET_GLOBAL, slot, _at(ast));
+  }
+}
+
+static void _block(struct compiler *compiler, struct ast *block);
+
+static void _if(struct compiler *compiler, struct ast *ast) {
+  struct ast *condition = ast->as.branch.condition;
+  _convert(compiler, condition, _expression(compiler, condition),
+           NODE_KIND_BOOL);
+  uint32_t skip = _write_jump(compiler, OPCODE_JUMP_IF_FALSE, _at(ast));
+  _block(compiler, ast->as.branch.then);
+  if (!ast->as.branch.otherwise) {
+    _patch_jump(compiler, ast, skip);
+    return;
+  }
+  uint32_t end = _write_jump(compiler, OPCODE_JUMP, _at(ast));
+  _patch_jump(compiler, ast, skip);
+  _block(compiler, ast->as.branch.otherwise);
+  _patch_jump(compiler, ast, end);
+}
+
+static void _statement(struct compiler *compiler, struct ast *ast) {
+  switch (ast->kind) {
+  case NODE_KIND_DECLARE:
+    _write_default(compiler, ast->as.variable.type, _at(ast));
+    _define(compiler, ast, ast->as.variable.type);
+    break;
+  case NODE_KIND_CONSTANT:
+    _define(compiler, ast, _expression(compiler, ast->as.variable.expr));
+    break;
+  case NODE_KIND_ASSIGN:
+    _assign(compiler, ast);
+    break;
+  case NODE_KIND_CALL_STMT:
+    _call(compiler, ast->as.expr, true);
+    _write_op(compiler, OPCODE_POP, _at(ast));
     break;
+  case NODE_KIND_IF:
+    _if(compiler, ast);
+    break;
+  case NODE_KIND_RETURN:
+    if (!compiler->routine) {
+      _error(compiler, ast, "Cannot RETURN from the main program.");
+    } else if (compiler->routine->kind == NODE_KIND_PROCEDURE) {
+      _error(compiler, ast, "Procedures cannot RETURN a value.");
+    } else {
+      _convert(compiler, ast, _expression(compiler, ast->as.expr),
+               compiler->routine->as.variable.type);
+      _write_op(compiler, OPCODE_RETURN, _at(ast));
+    }
+    break;
+  case NODE_KIND_FUNCTION:
+  case NODE_KIND_PROCEDURE:
+    _error(compiler, ast, "Routines must be declared at the top level.");
+    break;
+  default:
+    _expression(compiler, ast);
+    _write_op(compiler, OPCODE_PRINT, _at(ast));
+    break;
+  }
+}
+
+static void _block(struct compiler *compiler, struct ast *block) {
+  for (; block; block = block->as.list.next) {
+    _statement(compiler, block->as.list.item);
+  }
+}
+
+int32_t globals_declare_routine(globals_t *globals, const struct ast *ast) {
+  uint32_t arity = 0;
+  for (const struct ast *body = ast->as.variable.expr;
+       body && body->as.list.item->kind == NODE_KIND_PARAMETER;
+       body = body->as.list.next) {
+    ++arity;
+  }
+  if (arity > UINT8_MAX) {
+    type_error(ast, "Too many parameters.");
+    return -1;
+  }
+
+  bool is_function = ast->kind == NODE_KIND_FUNCTION;
+  int32_t slot = globals_declare(
+      globals, ast, is_function ? GLOBAL_KIND_FUNCTION : GLOBAL_KIND_PROCEDURE,
+      is_function ? ast->as.variable.type : NODE_KIND_BOOL);
+  if (slot < 0 || !arity) {
+    return slot;
+  }
+
+  struct global *global = (*globals)->globals + slot;
+  global->arity = arity;
+  global->parameters = reallocate(NULL, 0, arity * sizeof(enum node_kind));
+  const struct ast *body = ast->as.variable.expr;
+  for (uint32_t i = 0; i < arity; ++i, body = body->as.list.next) {
+    global->parameters[i] = body->as.list.item->as.variable.type;
+  }
+  return slot;
+}
+
+// Compiles a routine into its own chunk and stores the function object in
+// the routine's global slot. Falling off the end returns the default value
+// of the return type.
+static void _routine(struct compiler *compiler, struct ast *ast) {
+  obj_function_t function = obj_function_new(compiler->objects);
+  struct compiler routine = {
+      .chunk = &function->chunk,
+      .globals = compiler->globals,
+      .objects = compiler->objects,
+      .strings = compiler->strings,
+      .routine = ast,
+  };
+  function->chunk->name = ast->as.variable.name;
+  function->chunk->name_length = ast->as.variable.length;
+
+  struct ast *body = ast->as.variable.expr;
+  for (; body && body->as.list.item->kind == NODE_KIND_PARAMETER;
+       body = body->as.list.next) {
+    struct ast *parameter = body->as.list.item;
+    _declare_local(&routine, parameter, parameter->as.variable.type, false);
   }
-#undef WRITE_CONSTANT
-#undef WRITE_UNARY
-#undef WRITE_BINARY
+  function->arity = routine.local_count;
+  _block(&routine, body);
+  _write_default(&routine,
+                 ast->kind == NODE_KIND_FUNCTION ? ast->as.variable.type
+                                                 : NODE_KIND_BOOL,
+                 _at(ast));
+  _write_op(&routine, OPCODE_RETURN, _at(ast));
+  function->locals = routine.local_count;
+  function->chunk->max_stack = routine.max_depth;
+  if ((*compiler->globals)->max_frame < function->locals + routine.max_depth) {
+    (*compiler->globals)->max_frame = function->locals + routine.max_depth;
+  }
+  compiler->had_error |= routine.had_error;
+
+  int32_t slot = globals_resolve(*compiler->globals, ast);
+  if (slot >= 0) {
+    _write_value(compiler, VALUE_FROM_OBJ(function), _at(ast));
+    _write_short(compiler, OPCODE_SET_GLOBAL, slot, _at(ast));
+  }
+}
+
+// Compiles a program (a BLOCK list) and terminates it with OPCODE_RETURN. On
+// error the globals it declared are forgotten again. Routines are hoisted:
+// every routine name is declared before any body is compiled, and their
+// function objects are stored before the rest of the program runs.
+bool chunk_write_from_ast(chunk_t *chunk, struct ast *ast, globals_t *globals,
+                          obj_t *objects, table_t *strings) {
+  struct compiler compiler = {
+      .chunk = chunk,
+      .globals = globals,
+      .objects = objects,
+      .strings = strings,
+  };
+  uint32_t declared = (*globals)->count;
+  struct location location = {1};
+
+  for (struct ast *block = ast; block; block = block->as.list.next) {
+    struct ast *item = block->as.list.item;
+    if (_is_routine(item) && globals_declare_routine(globals, item) < 0) {
+      compiler.had_error = true;
+    }
+  }
+  for (struct ast *block = ast; block; block = block->as.list.next) {
+    if (_is_routine(block->as.list.item)) {
+      _routine(&compiler, block->as.list.item);
+    }
+  }
+  for (struct ast *block = ast; block; block = block->as.list.next) {
+    if (!_is_routine(block->as.list.item)) {
+      _statement(&compiler, block->as.list.item);
+    }
+    location = (struct location){block->line};
+  }
+  chunk_write(chunk, OPCODE_RETURN, location);
+  (*chunk)->globals = (*globals)->count;
+  (*chunk)->max_stack = compiler.max_depth;
+  (*chunk)->max_frame = (*globals)->max_frame;
+
+  if (compiler.had_error) {
+    _forget(*globals, declared);
+  }
+  return !compiler.had_error;
 }
 
 #ifdef DEBUG_CHUNK
@@ -211,10 +800,49 @@ static uint32_t constant_instruction(const char *name, chunk_t chunk,
   return offset + 2;
 }
 
+static uint32_t constant_constant_instruction(const char *name, chunk_t chunk,
+                                              uint32_t offset) {
+  uint8_t a = chunk->code[offset + 1], b = chunk->code[offset + 2];
+  fprintf(stderr, "%-16s %4d '", name, a);
+  value_print(chunk->constants->values[a]);
+  fprintf(stderr, "' %4d '", b);
+  value_print(chunk->constants->values[b]);
+  fputs("'\n", stderr);
+  return offset + 3;
+}
+
+static uint32_t byte_instruction(const char *name, chunk_t chunk,
+                                 uint32_t offset) {
+  fprintf(stderr, "%-16s %4u\n", name, chunk->code[offset + 1]);
+  return offset + 2;
+}
+
+static uint32_t slot_instruction(const char *name, chunk_t chunk,
+                                 uint32_t offset) {
+  uint32_t slot = chunk->code[offset + 1] | chunk->code[offset + 2] << 8;
+  fprintf(stderr, "%-16s %4u\n", name, slot);
+  return offset + 3;
+}
+
+static uint32_t jump_instruction(const char *name, chunk_t chunk,
+                                 uint32_t offset) {
+  uint32_t jump = chunk->code[offset + 1] | chunk->code[offset + 2] << 8;
+  fprintf(stderr, "%-16s %4u -> %u\n", name, offset, offset + 3 + jump);
+  return offset + 3;
+}
+
+static uint32_t call_instruction(const char *name, chunk_t chunk,
+                                 uint32_t offset) {
+  uint32_t slot = chunk->code[offset + 1] | chunk->code[offset + 2] << 8;
+  fprintf(stderr, "%-16s %4u (%u args)\n", name, slot,
+          chunk->code[offset + 3]);
+  return offset + 4;
+}
+
 static uint32_t constant_instruction_long(const char *name, chunk_t chunk,
                                           uint32_t offset) {
-  uint32_t constant = chunk->code[offset + 1] | chunk->code[offset + 2] |
-                      chunk->code[offset + 3];
+  uint32_t constant = chunk->code[offset + 1] | chunk->code[offset + 2] << 8 |
+                      chunk->code[offset + 3] << 16;
   fprintf(stderr, "%-16s %4d '", name, constant);
   value_print(chunk->constants->values[constant]);
   fputs("'\n", stderr);
@@ -222,14 +850,15 @@ static uint32_t constant_instruction_long(const char *name, chunk_t chunk,
 }
 
 uint32_t chunk_disassemble_instruction(chunk_t chunk, uint32_t offset) {
-  uint32_t line = chunk_get_line(chunk, offset);
+  uint32_t start;
+  struct location location = debug_info_lookup(chunk->debug, offset, &start);
 
   fprintf(stderr, "%04d ", offset);
 
-  if (offset > 0 && line == chunk_get_line(chunk, offset - 1)) {
-    fputs("   | ", stderr);
+  if (start < offset) {
+    fputs("   |     ", stderr);
   } else {
-    fprintf(stderr, "%4d ", line);
+    fprintf(stderr, "%4u:%-3u ", location.line, location.column);
   }
 
   enum opcode instruction = chunk->code[offset];
@@ -270,7 +899,37 @@ uint32_t chunk_disassemble_instruction(chunk_t chunk, uint32_t offset) {
     return simple_instruction("OP_GREATER_EQUAL", offset);
   case OPCODE_CONCAT:
     return simple_instruction("OP_CONCAT", offset);
+  case OPCODE_GET_GLOBAL:
+    return slot_instruction("OP_GET_GLOBAL", chunk, offset);
+  case OPCODE_SET_GLOBAL:
+    return slot_instruction("OP_SET_GLOBAL", chunk, offset);
+  case OPCODE_GET_LOCAL:
+    return byte_instruction("OP_GET_LOCAL", chunk, offset);
+  case OPCODE_SET_LOCAL:
+    return byte_instruction("OP_SET_LOCAL", chunk, offset);
+  case OPCODE_JUMP:
+    return jump_instruction("OP_JUMP", chunk, offset);
+  case OPCODE_JUMP_IF_FALSE:
+    return jump_instruction("OP_JUMP_IF_FALSE", chunk, offset);
+  case OPCODE_CALL:
+    return call_instruction("OP_CALL", chunk, offset);
+  case OPCODE_POP:
+    return simple_instruction("OP_POP", offset);
+  case OPCODE_PRINT:
+    return simple_instruction("OP_PRINT", offset);
+  case OPCODE_CONSTANT_CONSTANT:
+    return constant_constant_instruction("OP_CONSTANT_CONSTANT", chunk,
+                                         offset);
+  case OPCODE_ADD_INT_CONST:
+  case OPCODE_SUB_INT_CONST:
+  case OPCODE_EQUAL_CONST:
+  case OPCODE_LESS_INT_CONST:
+  case OPCODE_GREATER_INT_CONST:
+    return constant_instruction(chunk_opcode_name(instruction), chunk, offset);
   default:
+    if (instruction < OPCODE_COUNT && chunk_opcode_length(instruction) == 1) {
+      return simple_instruction(chunk_opcode_name(instruction), offset);
+    }
     fprintf(stderr, "Unknown opcode %d\n", instruction);
     return offset + 1;
   }
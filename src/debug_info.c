@@ -0,0 +1,188 @@
+#include "debug_info.h"
+#include "memory.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CAPACITY_INIT 16U
+#define CAPACITY_MULT 2U
+#define VARINT_MAX 5U
+
+void debug_info_new(debug_info_t *info) {
+  *info = reallocate(NULL, 0, sizeof(struct debug_info) + CAPACITY_INIT);
+  **info = (struct debug_info){.capacity = CAPACITY_INIT};
+  (*info)->index = reallocate(NULL, 0,
+                              sizeof(struct debug_index) +
+                                  CAPACITY_INIT * sizeof(struct debug_anchor));
+  *(*info)->index = (struct debug_index){.capacity = CAPACITY_INIT};
+}
+
+void debug_info_free(debug_info_t *info) {
+  debug_index_t index = (*info)->index;
+  reallocate(index,
+             sizeof(struct debug_index) +
+                 index->capacity * sizeof(struct debug_anchor),
+             0);
+  reallocate(*info, sizeof(struct debug_info) + (*info)->capacity, 0);
+  *info = NULL;
+}
+
+static inline uint32_t _zigzag(uint32_t from, uint32_t to) {
+  uint32_t delta = to - from;
+  return delta << 1 ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+static inline uint32_t _unzigzag(uint32_t from, uint32_t value) {
+  return from + ((value >> 1) ^ -(value & 1));
+}
+
+static inline void _put_varint(struct debug_info *info, uint32_t value) {
+  while (value >= 0x80) {
+    info->data[info->count++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  info->data[info->count++] = (uint8_t)value;
+}
+
+static inline uint32_t _get_varint(const uint8_t *data, uint32_t *position) {
+  uint32_t value = 0;
+  for (uint32_t shift = 0;; shift += 7) {
+    uint8_t byte = data[(*position)++];
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+}
+
+static void _anchor(debug_info_t info, struct debug_anchor anchor) {
+  debug_index_t index = info->index;
+  if (index->count == index->capacity) {
+    uint32_t new_capacity = index->capacity * CAPACITY_MULT;
+    index = reallocate(index,
+                       sizeof(struct debug_index) +
+                           index->capacity * sizeof(struct debug_anchor),
+                       sizeof(struct debug_index) +
+                           new_capacity * sizeof(struct debug_anchor));
+    if (!index) {
+      exit(1);
+    }
+    index->capacity = new_capacity;
+    info->index = index;
+  }
+  index->anchors[index->count++] = anchor;
+}
+
+// Starts a record at `offset` unless the code before it has the same
+// location. Offsets must be written in increasing order.
+void debug_info_write(debug_info_t *info, uint32_t offset,
+                      struct location location) {
+  debug_info_t current = *info;
+  if (current->records && current->location.line == location.line &&
+      current->location.column == location.column) {
+    return;
+  }
+
+  if (current->capacity < current->count + 3 * VARINT_MAX) {
+    uint32_t new_capacity = current->capacity * CAPACITY_MULT;
+    current = reallocate(current, sizeof(struct debug_info) + current->capacity,
+                         sizeof(struct debug_info) + new_capacity);
+    if (!current) {
+      exit(1);
+    }
+    current->capacity = new_capacity;
+    *info = current;
+  }
+
+  if (!(current->records % DEBUG_INFO_STRIDE)) {
+    _anchor(current, (struct debug_anchor){offset, location.line,
+                                           location.column, current->count});
+  }
+  _put_varint(current, offset - current->offset);
+  _put_varint(current, _zigzag(current->location.line, location.line));
+  _put_varint(current, _zigzag(current->location.column, location.column));
+  current->offset = offset;
+  current->location = location;
+  ++current->records;
+}
+
+// Decodes the record at `*position`, which follows one at `*offset` and
+// `*location`, and advances all three past it.
+static void _decode(const struct debug_info *info, uint32_t *position,
+                    uint32_t *offset, struct location *location) {
+  *offset += _get_varint(info->data, position);
+  location->line = _unzigzag(location->line, _get_varint(info->data, position));
+  location->column =
+      _unzigzag(location->column, _get_varint(info->data, position));
+}
+
+// Returns the location of the code at `offset`, and stores the offset its
+// run of code starts at in `start` unless that is NULL.
+struct location debug_info_lookup(const struct debug_info *info,
+                                  uint32_t offset, uint32_t *start) {
+  const struct debug_index *index = info->index;
+  if (!index->count) {
+    if (start) {
+      *start = 0;
+    }
+    return (struct location){0};
+  }
+
+  uint32_t low = 0, high = index->count;
+  while (high - low > 1) {
+    uint32_t middle = low + (high - low) / 2;
+    if (index->anchors[middle].offset <= offset) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  const struct debug_anchor *anchor = index->anchors + low;
+  struct location location = {anchor->line, anchor->column};
+  uint32_t position = anchor->position;
+  uint32_t skipped_offset = 0;
+  struct location skipped = {0};
+  _decode(info, &position, &skipped_offset, &skipped);
+
+  uint32_t run = anchor->offset;
+  while (position < info->count) {
+    uint32_t next_offset = run;
+    struct location next = location;
+    uint32_t next_position = position;
+    _decode(info, &next_position, &next_offset, &next);
+    if (next_offset > offset) {
+      break;
+    }
+    run = next_offset;
+    location = next;
+    position = next_position;
+  }
+  if (start) {
+    *start = run;
+  }
+  return location;
+}
+
+void debug_cursor_init(struct debug_cursor *cursor,
+                       const struct debug_info *info) {
+  *cursor = (struct debug_cursor){.info = info};
+  if (info->count) {
+    _decode(info, &cursor->position, &cursor->next_offset, &cursor->next);
+    cursor->location = cursor->next;
+  }
+}
+
+// Returns the location of `offset`, which must not be below the offset the
+// cursor was last asked about.
+struct location debug_cursor_at(struct debug_cursor *cursor, uint32_t offset) {
+  const struct debug_info *info = cursor->info;
+  while (cursor->next_offset <= offset) {
+    cursor->location = cursor->next;
+    if (cursor->position >= info->count) {
+      cursor->next_offset = UINT32_MAX;
+      break;
+    }
+    _decode(info, &cursor->position, &cursor->next_offset, &cursor->next);
+  }
+  return cursor->location;
+}
@@ -0,0 +1,152 @@
+#include "gc.h"
+#include "memory.h"
+#include "obj.h"
+#include "table.h"
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CAPACITY_INIT 64U
+#define CAPACITY_MULT 2U
+
+void gc_init(struct gc *gc, struct vm *vm) {
+  *gc = (struct gc){
+      .vm = vm,
+      .next_collection = GC_THRESHOLD_INIT,
+      .threshold = GC_THRESHOLD_INIT,
+      .growth = GC_GROWTH_INIT,
+  };
+  memory_set_gc(gc);
+}
+
+void gc_free(struct gc *gc) {
+  memory_set_gc(NULL);
+  free(gc->gray);
+  gc->gray = NULL;
+  gc->gray_count = gc->gray_capacity = 0;
+}
+
+void gc_pause(struct gc *gc) { ++gc->paused; }
+
+void gc_resume(struct gc *gc) { --gc->paused; }
+
+static void _mark_obj(struct gc *gc, obj_t obj) {
+  if (!obj || obj->is_marked) {
+    return;
+  }
+  obj->is_marked = true;
+
+  if (gc->gray_count >= gc->gray_capacity) {
+    gc->gray_capacity =
+        gc->gray_capacity ? gc->gray_capacity * CAPACITY_MULT : CAPACITY_INIT;
+    obj_t *gray = realloc(gc->gray, gc->gray_capacity * sizeof(obj_t));
+    if (!gray) {
+      exit(1);
+    }
+    gc->gray = gray;
+  }
+  gc->gray[gc->gray_count++] = obj;
+}
+
+static void _mark_value(struct gc *gc, struct value value) {
+  if (value_is_obj(value)) {
+    _mark_obj(gc, VALUE_AS_OBJ(value));
+  }
+}
+
+static void _mark_array(struct gc *gc, const struct value_array *array) {
+  for (uint32_t i = 0; i < array->count; ++i) {
+    _mark_value(gc, array->values[i]);
+  }
+}
+
+static void _mark_roots(struct gc *gc) {
+  struct vm *vm = gc->vm;
+  for (struct value *slot = vm->stack->values; slot < vm->stack->top; ++slot) {
+    _mark_value(gc, *slot);
+  }
+  _mark_array(gc, vm->globals);
+  if (vm->chunk) {
+    _mark_array(gc, vm->chunk->constants);
+  }
+  for (uint32_t i = 0; i < vm->frame_count; ++i) {
+    _mark_array(gc, vm->frames[i].chunk->constants);
+  }
+  if (vm->reg_chunk) {
+    _mark_array(gc, vm->reg_chunk->constants);
+    for (uint32_t i = 0; i < vm->reg_chunk->routine_count; ++i) {
+      _mark_array(gc, vm->reg_chunk->routines[i]->constants);
+    }
+  }
+}
+
+static void _blacken(struct gc *gc, obj_t obj) {
+  switch (obj->kind) {
+  case OBJ_KIND_STRING:
+  case OBJ_KIND_INTEGER:
+  case OBJ_KIND_BUFFER:
+    break;
+  case OBJ_KIND_ROPE:
+    _mark_obj(gc, AS_OBJ(OBJ_AS_ROPE(obj)->buffer));
+    break;
+  case OBJ_KIND_FUNCTION:
+    _mark_array(gc, OBJ_AS_FUNCTION(obj)->chunk->constants);
+    break;
+  }
+}
+
+static void _trace(struct gc *gc) {
+  while (gc->gray_count) {
+    _blacken(gc, gc->gray[--gc->gray_count]);
+  }
+}
+
+static void _sweep(struct gc *gc) {
+  obj_t *link = &gc->vm->objects;
+  while (*link) {
+    obj_t obj = *link;
+    if (obj->is_marked) {
+      obj->is_marked = false;
+      link = &obj->next;
+      continue;
+    }
+
+    *link = obj->next;
+    size_t before = gc->bytes_allocated;
+    obj_free(obj);
+    gc->stats.bytes_freed += before - gc->bytes_allocated;
+    ++gc->stats.objects_freed;
+  }
+}
+
+void gc_collect(struct gc *gc) {
+  ++gc->paused;
+
+  _mark_roots(gc);
+  _trace(gc);
+  table_remove_unmarked(gc->vm->strings);
+  _sweep(gc);
+
+  size_t next = gc->bytes_allocated / 100 * gc->growth;
+  gc->next_collection = next > gc->threshold ? next : gc->threshold;
+  ++gc->stats.collections;
+
+  --gc->paused;
+}
+
+void gc_safepoint(struct gc *gc) {
+  if (gc_should_collect(gc)) {
+    gc_collect(gc);
+  }
+}
+
+void gc_print_stats(const struct gc *gc) {
+  fprintf(stderr,
+          "gc: %llu collections, %llu allocations, %llu objects freed, "
+          "%zu bytes freed, %zu bytes live, %zu bytes peak\n",
+          (unsigned long long)gc->stats.collections,
+          (unsigned long long)gc->stats.allocations,
+          (unsigned long long)gc->stats.objects_freed, gc->stats.bytes_freed,
+          gc->bytes_allocated, gc->stats.bytes_peak);
+}
@@ -1,13 +1,49 @@
 #include "ast.h"
+#include "cache.h"
 #include "chunk.h"
+#include "gc.h"
+#include "module.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "peephole.h"
+#include "reg_chunk.h"
 #include "scanner.h"
 #include "vm.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-void interpret(const char *source) {
+#define EXIT_USAGE 64
+#define EXIT_COMPILE_ERROR 65
+#define EXIT_RUNTIME_ERROR 70
+#define EXIT_IO_ERROR 74
+
+struct options {
+  bool tokens;
+  bool ast;
+  bool registers;
+  bool cache;
+  enum optimize_level level;
+  bool gc_stats;
+  bool gc_stress;
+  bool vm_stats;
+  bool trace;
+  bool stats;
+  bool opcode_pairs;
+  bool profile;
+  uint32_t profile_interval;
+  const char *profile_path;
+  const char *output_path;
+  size_t gc_threshold;
+  uint32_t gc_growth;
+  uint32_t jobs;
+  const char *path;
+  const char **paths;
+  uint32_t path_count;
+};
+
+static void _dump_tokens(const char *source) {
   struct scanner scanner;
   scanner_init(&scanner, source);
   uint32_t line = 0;
@@ -31,65 +67,331 @@ void interpret(const char *source) {
   }
 }
 
-static void repl() {
-  char line[1024];
-  for (;;) {
-    printf("> ");
+static enum interpret_result _run_stack(struct vm *vm, struct ast *ast,
+                                        globals_t *globals, const char *source,
+                                        const struct options *options) {
+  chunk_t chunk;
+  chunk_init(&chunk);
+  gc_pause(&vm->gc);
+  bool compiled =
+      chunk_write_from_ast(&chunk, ast, globals, &vm->objects, &vm->strings);
+  if (compiled && options->level >= OPTIMIZE_LEVEL_PEEPHOLE) {
+    peephole_run(chunk);
+  }
+  gc_resume(&vm->gc);
 
-    if (!fgets(line, sizeof(line), stdin)) {
-      printf("\n");
-      break;
-    }
+  if (!compiled) {
+    chunk_free(&chunk);
+    return INTERPRET_RESULT_COMPILE_ERROR;
+  }
 
-    interpret(line);
+  if (options->cache) {
+    cache_store(source, options->level, chunk);
   }
+
+  enum interpret_result result = vm_interpret(vm, chunk);
+
+  chunk_free(&chunk);
+  return result;
 }
 
-static char *readFile(const char *path) {
-  FILE *file = fopen(path, "rb");
+static enum interpret_result _run_registers(struct vm *vm, struct ast *ast) {
+  reg_chunk_t chunk;
+  reg_chunk_init(&chunk);
 
-  fseek(file, 0L, SEEK_END);
-  size_t file_size = ftell(file);
-  rewind(file);
+  gc_pause(&vm->gc);
+  bool compiled =
+      reg_chunk_write_from_ast(&chunk, ast, &vm->objects, &vm->strings);
+  gc_resume(&vm->gc);
 
-  char *buffer = malloc(file_size + 1);
-  size_t bytes_read = fread(buffer, sizeof(char), file_size, file);
-  buffer[bytes_read] = '\0';
+  enum interpret_result result = INTERPRET_RESULT_COMPILE_ERROR;
+  if (compiled) {
+    result = vm_interpret_registers(vm, chunk);
+  }
 
-  fclose(file);
-  return buffer;
+  reg_chunk_free(&chunk);
+  return result;
 }
 
-void run_file(const char *path) {
-  char *source = readFile(path);
-  interpret(source);
-  free(source);
-}
+static enum interpret_result interpret(struct vm *vm, globals_t *globals,
+                                       const char *source,
+                                       const struct options *options) {
+  if (options->tokens) {
+    _dump_tokens(source);
+    return INTERPRET_RESULT_OK;
+  }
 
-int main(int argc, const char *argv[]) {
   struct scanner scanner;
   struct parser parser;
   struct ast_arena arena;
 
-  scanner_init(&scanner, "\"st\" & \"ri\" & \"ng\"");
+  scanner_init(&scanner, source);
   ast_arena_new(&arena);
   parser_init(&parser, &arena, &scanner);
 
   struct ast *ast = parser_parse(&parser);
-  ast_print(ast);
-  puts("\n");
+  enum interpret_result result = INTERPRET_RESULT_COMPILE_ERROR;
+  if (!parser.had_error) {
+    ast = optimizer_run(&arena, ast, options->level);
+    if (options->ast) {
+      ast_print(ast);
+      fputc('\n', stderr);
+    }
+    result = options->registers ? _run_registers(vm, ast)
+                                : _run_stack(vm, ast, globals, source, options);
+  }
 
-  struct vm vm;
-  vm_init(&vm);
+  ast_arena_free(&arena);
+  return result;
+}
+
+static void repl(struct vm *vm, const struct options *options) {
+  char line[1024];
+  globals_t globals;
+  globals_init(&globals);
+  for (;;) {
+    printf("> ");
+
+    if (!fgets(line, sizeof(line), stdin)) {
+      printf("\n");
+      break;
+    }
+
+    const struct source *source =
+        source_manager_add(&vm->sources, line, strlen(line));
+    interpret(vm, &globals, source->chars, options);
+  }
+  globals_free(&globals);
+}
+
+static void _print_profile(const struct vm *vm,
+                           const struct options *options) {
+  if (!vm->profile) {
+    return;
+  }
+  profile_print(vm->profile);
+  if (!profile_write_folded(vm->profile, options->profile_path)) {
+    fprintf(stderr, "Could not write \"%s\".\n", options->profile_path);
+  }
+}
 
+static int _finish(struct vm *vm, enum interpret_result result,
+                   const struct options *options) {
+  if (options->gc_stats) {
+    gc_print_stats(&vm->gc);
+  }
+  if (options->vm_stats) {
+    vm_print_stats(vm);
+  }
+  vm_print_opcode_pairs(vm);
+  vm_print_opcode_stats(vm);
+  _print_profile(vm, options);
+  vm_free(vm);
+
+  switch (result) {
+  case INTERPRET_RESULT_COMPILE_ERROR:
+    return EXIT_COMPILE_ERROR;
+  case INTERPRET_RESULT_RUNTIME_ERROR:
+    return EXIT_RUNTIME_ERROR;
+  default:
+    return EXIT_SUCCESS;
+  }
+}
+
+static int run_file(struct vm *vm, const char *path,
+                    const struct options *options) {
+  const struct source *source = source_manager_open(&vm->sources, path);
+  if (!source) {
+    fprintf(stderr, "Could not read \"%s\".\n", path);
+    vm_free(vm);
+    return EXIT_IO_ERROR;
+  }
+
+  struct cache cache = {0};
   chunk_t chunk;
-  chunk_init(&chunk);
-  chunk_write_from_ast(&chunk, ast, &vm.objects, &vm.strings);
-  chunk_write(&chunk, OPCODE_RETURN, 2);
 
-  vm_interpret(&vm, chunk);
+  enum interpret_result result;
+  if (options->cache &&
+      cache_load(&cache, vm, source->chars, options->level, &chunk)) {
+    result = vm_interpret(vm, chunk);
+  } else {
+    globals_t globals;
+    globals_init(&globals);
+    result = interpret(vm, &globals, source->chars, options);
+    globals_free(&globals);
+  }
 
-  ast_arena_free(&arena);
+  int status = _finish(vm, result, options);
+  cache_unload(&cache);
+  return status;
+}
+
+// Compiles every path on worker threads, then runs them in the order given,
+// each with its own globals, until one fails.
+static int run_modules(struct vm *vm, const struct options *options) {
+  struct module *modules = calloc(options->path_count, sizeof(struct module));
+  if (!modules) {
+    vm_free(vm);
+    return EXIT_IO_ERROR;
+  }
+  for (uint32_t i = 0; i < options->path_count; ++i) {
+    const struct source *source =
+        source_manager_open(&vm->sources, options->paths[i]);
+    if (!source) {
+      fprintf(stderr, "Could not read \"%s\".\n", options->paths[i]);
+      free(modules);
+      vm_free(vm);
+      return EXIT_IO_ERROR;
+    }
+    modules[i].source = source->chars;
+  }
 
-  return 0;
+  modules_compile(modules, options->path_count, options->level, options->jobs);
+  enum interpret_result result = INTERPRET_RESULT_COMPILE_ERROR;
+  if (modules_link(vm, modules, options->path_count)) {
+    result = INTERPRET_RESULT_OK;
+    for (uint32_t i = 0;
+         result == INTERPRET_RESULT_OK && i < options->path_count; ++i) {
+      result = vm_interpret(vm, modules[i].function->chunk);
+    }
+  }
+  free(modules);
+  return _finish(vm, result, options);
+}
+
+static bool _parse_options(struct options *options, const char **paths,
+                           int argc, const char *argv[]) {
+  *options = (struct options){
+      .paths = paths,
+      .cache = true,
+      .level = OPTIMIZE_LEVEL_PEEPHOLE,
+      .gc_threshold = GC_THRESHOLD_INIT,
+      .gc_growth = GC_GROWTH_INIT,
+      .profile_interval = PROFILE_INTERVAL_INIT,
+      .profile_path = "campseudo.folded",
+  };
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--tokens")) {
+      options->tokens = true;
+    } else if (!strcmp(argv[i], "--ast")) {
+      options->ast = true;
+    } else if (!strcmp(argv[i], "--backend=stack")) {
+      options->registers = false;
+    } else if (!strcmp(argv[i], "--backend=register")) {
+      options->registers = true;
+    } else if (!strcmp(argv[i], "--no-cache")) {
+      options->cache = false;
+    } else if (!strcmp(argv[i], "-O0")) {
+      options->level = OPTIMIZE_LEVEL_NONE;
+    } else if (!strcmp(argv[i], "-O1")) {
+      options->level = OPTIMIZE_LEVEL_FOLD;
+    } else if (!strcmp(argv[i], "-O2")) {
+      options->level = OPTIMIZE_LEVEL_PEEPHOLE;
+    } else if (!strcmp(argv[i], "--gc-stats")) {
+      options->gc_stats = true;
+    } else if (!strcmp(argv[i], "--gc-stress")) {
+      options->gc_stress = true;
+    } else if (!strcmp(argv[i], "--vm-stats")) {
+      options->vm_stats = true;
+    } else if (!strcmp(argv[i], "--trace")) {
+      options->trace = true;
+    } else if (!strcmp(argv[i], "--stats")) {
+      options->stats = true;
+    } else if (!strcmp(argv[i], "--dump-opcode-pairs")) {
+      options->opcode_pairs = true;
+    } else if (!strcmp(argv[i], "--profile")) {
+      options->profile = true;
+    } else if (!strncmp(argv[i], "--profile=", 10)) {
+      options->profile = true;
+      options->profile_path = argv[i] + 10;
+    } else if (!strncmp(argv[i], "--profile-interval=", 19)) {
+      options->profile_interval = strtoul(argv[i] + 19, NULL, 10);
+      if (!options->profile_interval) {
+        return false;
+      }
+    } else if (!strncmp(argv[i], "--output=", 9)) {
+      options->output_path = argv[i] + 9;
+    } else if (!strncmp(argv[i], "--gc-threshold=", 15)) {
+      options->gc_threshold = strtoull(argv[i] + 15, NULL, 10);
+    } else if (!strncmp(argv[i], "--gc-growth=", 12)) {
+      options->gc_growth = strtoul(argv[i] + 12, NULL, 10);
+      if (options->gc_growth < 100) {
+        return false;
+      }
+    } else if (!strncmp(argv[i], "--jobs=", 7)) {
+      options->jobs = strtoul(argv[i] + 7, NULL, 10);
+    } else if (argv[i][0] != '-' || !strcmp(argv[i], "-")) {
+      options->paths[options->path_count++] = argv[i];
+    } else {
+      return false;
+    }
+  }
+  if (options->path_count > 1 &&
+      (options->tokens || options->ast || options->registers)) {
+    return false;
+  }
+  if ((options->profile || options->trace || options->stats) &&
+      options->registers) {
+    return false;
+  }
+  options->path = options->path_count ? options->paths[0] : NULL;
+  options->cache = options->cache && options->path && !options->tokens &&
+                   !options->ast && !options->registers;
+  return true;
+}
+
+int main(int argc, const char *argv[]) {
+  struct options options;
+  const char *paths[argc];
+  if (!_parse_options(&options, paths, argc, argv)) {
+    fputs("Usage: campseudo [--tokens] [--ast] [-O0|-O1|-O2] "
+          "[--backend=stack|register] [--no-cache] [--gc-stats] "
+          "[--gc-stress] [--gc-threshold=BYTES] [--gc-growth=PERCENT] "
+          "[--vm-stats] [--trace] [--stats] [--dump-opcode-pairs] "
+          "[--profile[=PATH]] [--profile-interval=USEC] [--output=PATH] "
+          "[--jobs=N] [path|-]...\n",
+          stderr);
+    return EXIT_USAGE;
+  }
+
+  struct vm vm;
+  vm_init(&vm);
+  vm.gc.stress = options.gc_stress;
+  vm.gc.threshold = vm.gc.next_collection = options.gc_threshold;
+  vm.gc.growth = options.gc_growth;
+  vm.trace = options.trace;
+  vm.count_hits = options.vm_stats;
+  if (options.stats) {
+    vm_count_opcodes(&vm);
+  }
+  if (options.opcode_pairs) {
+    vm_count_opcode_pairs(&vm);
+  }
+  if (options.output_path &&
+      !output_open(&vm.output, options.output_path)) {
+    fprintf(stderr, "Could not open \"%s\".\n", options.output_path);
+    vm_free(&vm);
+    return EXIT_IO_ERROR;
+  }
+  if (options.profile && !vm_profile(&vm, options.profile_interval)) {
+    vm_free(&vm);
+    return EXIT_IO_ERROR;
+  }
+
+  if (!options.path) {
+    repl(&vm, &options);
+    if (options.gc_stats) {
+      gc_print_stats(&vm.gc);
+    }
+    vm_print_opcode_pairs(&vm);
+    vm_print_opcode_stats(&vm);
+    _print_profile(&vm, &options);
+    vm_free(&vm);
+    return EXIT_SUCCESS;
+  }
+
+  if (options.path_count > 1) {
+    return run_modules(&vm, &options);
+  }
+  return run_file(&vm, options.path, &options);
 }
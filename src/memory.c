@@ -1,11 +1,37 @@
 #include "memory.h"
+#include "allocator.h"
+#include "gc.h"
+#include <threads.h>
+
+// Per thread, so that modules compiling on worker threads each account to
+// and allocate from their own collector and pool.
+static thread_local struct gc *g_gc = NULL;
+static thread_local struct allocator *g_allocator = NULL;
+
+struct gc *memory_set_gc(struct gc *gc) {
+  struct gc *previous = g_gc;
+  g_gc = gc;
+  return previous;
+}
+
+struct allocator *memory_set_allocator(struct allocator *allocator) {
+  struct allocator *previous = g_allocator;
+  g_allocator = allocator;
+  return previous;
+}
 
 void *reallocate(void *pointer, size_t old_size, size_t new_size) {
-  if (!new_size) {
-    free(pointer);
-    return NULL;
+  if (g_gc) {
+    g_gc->stats.allocations += !pointer && new_size;
+    g_gc->bytes_allocated += new_size - old_size;
+    if (g_gc->bytes_allocated > g_gc->stats.bytes_peak) {
+      g_gc->stats.bytes_peak = g_gc->bytes_allocated;
+    }
+    if (new_size > old_size) {
+      gc_safepoint(g_gc);
+    }
   }
 
-  void *result = realloc(pointer, new_size);
-  return result;
-}
\ No newline at end of file
+  struct allocator *allocator = g_allocator ? g_allocator : allocator_system();
+  return allocator->reallocate(allocator, pointer, old_size, new_size);
+}
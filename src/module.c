@@ -0,0 +1,206 @@
+#include "module.h"
+#include "memory.h"
+#include "parser.h"
+#include "peephole.h"
+#include "scanner.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+#include <unistd.h>
+
+struct workers {
+  struct module *modules;
+  uint32_t count;
+  enum optimize_level level;
+  atomic_uint next;
+};
+
+static void _compile(struct module *module, enum optimize_level level) {
+  pool_init(&module->pool);
+  module->gc = (struct gc){.paused = 1};
+  struct allocator *allocator = memory_set_allocator(&module->pool.allocator);
+  struct gc *gc = memory_set_gc(&module->gc);
+  module->objects = NULL;
+  table_init(&module->strings);
+  chunk_init(&module->chunk);
+
+  struct scanner scanner;
+  struct parser parser;
+  struct ast_arena arena;
+  globals_t globals;
+
+  scanner_init(&scanner, module->source);
+  ast_arena_new(&arena);
+  parser_init(&parser, &arena, &scanner);
+  globals_init(&globals);
+
+  struct ast *ast = parser_parse(&parser);
+  module->compiled = !parser.had_error;
+  if (module->compiled) {
+    ast = optimizer_run(&arena, ast, level);
+    module->compiled = chunk_write_from_ast(&module->chunk, ast, &globals,
+                                            &module->objects, &module->strings);
+  }
+  if (module->compiled && level >= OPTIMIZE_LEVEL_PEEPHOLE) {
+    peephole_run(module->chunk);
+  }
+
+  globals_free(&globals);
+  ast_arena_free(&arena);
+  memory_set_gc(gc);
+  memory_set_allocator(allocator);
+}
+
+static int _work(void *arg) {
+  struct workers *workers = arg;
+  for (;;) {
+    uint32_t i = atomic_fetch_add(&workers->next, 1);
+    if (i >= workers->count) {
+      return 0;
+    }
+    _compile(workers->modules + i, workers->level);
+  }
+}
+
+// Compiles every module on up to `jobs` worker threads, or one per core when
+// `jobs` is zero. Modules share no state until they are linked.
+void modules_compile(struct module *modules, uint32_t count,
+                     enum optimize_level level, uint32_t jobs) {
+  if (!jobs) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = cores > 0 ? (uint32_t)cores : 1;
+  }
+  jobs = jobs < count ? jobs : count;
+  jobs = jobs < MODULE_JOBS_MAX ? jobs : MODULE_JOBS_MAX;
+
+  struct workers workers = {modules, count, level, 0};
+  thrd_t threads[MODULE_JOBS_MAX];
+  uint32_t started = 0;
+  while (started < jobs &&
+         thrd_create(threads + started, _work, &workers) == thrd_success) {
+    ++started;
+  }
+  if (!started) {
+    _work(&workers);
+  }
+  for (uint32_t i = 0; i < started; ++i) {
+    thrd_join(threads[i], NULL);
+  }
+}
+
+static obj_string_t _canonical(struct vm *vm, obj_string_t string) {
+  return table_find_string(vm->strings, OBJ_AS_CSTRING(string), string->length,
+                           string->hash);
+}
+
+// Points the chunk's string constants at the VM's interned copies and moves
+// its global slots, and those of its routines, up by `base`.
+static void _link_chunk(struct vm *vm, chunk_t chunk, uint32_t base) {
+  struct value *constants = chunk->constants->values;
+  for (uint32_t i = 0; i < chunk->constants->count; ++i) {
+    if (!value_is_obj(constants[i])) {
+      continue;
+    }
+    obj_t obj = VALUE_AS_OBJ(constants[i]);
+    if (obj->kind == OBJ_KIND_STRING) {
+      constants[i] = VALUE_FROM_OBJ(AS_OBJ(_canonical(vm, OBJ_AS_STRING(obj))));
+    } else if (obj->kind == OBJ_KIND_FUNCTION) {
+      _link_chunk(vm, OBJ_AS_FUNCTION(obj)->chunk, base);
+    }
+  }
+
+  for (uint32_t offset = 0; offset < chunk->count;
+       offset += chunk_opcode_length(chunk->code[offset])) {
+    enum opcode opcode = chunk->code[offset];
+    if (opcode != OPCODE_GET_GLOBAL && opcode != OPCODE_SET_GLOBAL &&
+        opcode != OPCODE_CALL) {
+      continue;
+    }
+    uint32_t slot = chunk->code[offset + 1] | chunk->code[offset + 2] << 8;
+    slot += base;
+    chunk->code[offset + 1] = slot & 0xFF;
+    chunk->code[offset + 2] = (slot >> 8) & 0xFF;
+  }
+}
+
+// Hands the module's memory and interned strings to the VM.
+static void _adopt(struct vm *vm, struct module *module) {
+  pool_adopt(&vm->pool, &module->pool);
+  vm->gc.bytes_allocated += module->gc.bytes_allocated;
+  if (vm->gc.bytes_allocated > vm->gc.stats.bytes_peak) {
+    vm->gc.stats.bytes_peak = vm->gc.bytes_allocated;
+  }
+
+  table_intern_all(module->strings, &vm->strings);
+  table_free(&module->strings);
+}
+
+// Moves the module's objects to the VM, freeing the strings that lost to a
+// copy the VM had already interned.
+static void _adopt_objects(struct vm *vm, struct module *module) {
+  while (module->objects) {
+    obj_t obj = module->objects;
+    module->objects = obj->next;
+    if (obj->kind == OBJ_KIND_STRING &&
+        _canonical(vm, OBJ_AS_STRING(obj)) != OBJ_AS_STRING(obj)) {
+      obj_free(obj);
+      continue;
+    }
+    obj->next = vm->objects;
+    vm->objects = obj;
+  }
+}
+
+// Links compiled modules into the VM. Each module's globals get their own
+// range of slots, so modules do not see each other's declarations, and its
+// top-level code is wrapped in a function stored in a slot past all of them,
+// which keeps the constants of modules that have not run yet reachable.
+// Every module is handed to the VM even when linking fails.
+bool modules_link(struct vm *vm, struct module *modules, uint32_t count) {
+  bool linked = true;
+  uint32_t globals = vm->globals->count;
+  for (uint32_t i = 0; i < count; ++i) {
+    linked = linked && modules[i].compiled;
+    globals += modules[i].chunk->globals;
+  }
+  if (globals + count > CHUNK_GLOBALS_MAX) {
+    fputs("Too many globals across modules.\n", stderr);
+    linked = false;
+  }
+
+  gc_pause(&vm->gc);
+  uint32_t base = vm->globals->count;
+  for (uint32_t i = 0; i < count; ++i) {
+    struct module *module = modules + i;
+    _adopt(vm, module);
+    if (linked) {
+      uint32_t length = module->chunk->globals;
+      _link_chunk(vm, module->chunk, base);
+      module->chunk->globals = base += length;
+    }
+    _adopt_objects(vm, module);
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    struct module *module = modules + i;
+    module->function = NULL;
+    if (!linked) {
+      chunk_free(&module->chunk);
+      continue;
+    }
+    module->function = obj_function_new(&vm->objects);
+    chunk_free(&module->function->chunk);
+    module->function->chunk = module->chunk;
+    module->chunk = NULL;
+  }
+  while (linked && vm->globals->count < base) {
+    value_array_write(&vm->globals, VALUE_FROM_BOOL(false));
+  }
+  for (uint32_t i = 0; linked && i < count; ++i) {
+    value_array_write(&vm->globals,
+                      VALUE_FROM_OBJ(AS_OBJ(modules[i].function)));
+  }
+  gc_resume(&vm->gc);
+  return linked;
+}
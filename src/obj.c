@@ -1,4 +1,5 @@
 #include "obj.h"
+#include "chunk.h"
 #include "common.h"
 #include "memory.h"
 #include "table.h"
@@ -6,11 +7,15 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define ALLOCATE_OBJ(type, kind) (type *)_allocate_obj(kind, sizeof(type))
+#define CAPACITY_MULT 2U
+
+#define ALLOCATE_OBJ(objects, type, kind)                                      \
+  (type *)_allocate_obj(objects, kind, sizeof(type))
 
 static obj_t _allocate_obj(obj_t *objects, enum obj_kind kind, size_t size) {
   obj_t obj = reallocate(NULL, 0, size);
   obj->kind = kind;
+  obj->is_marked = false;
   obj->next = *objects;
   *objects = obj;
   return obj;
@@ -19,24 +24,38 @@ static obj_t _allocate_obj(obj_t *objects, enum obj_kind kind, size_t size) {
 static obj_string_t _allocate_obj_string(obj_t *objects, table_t *strings,
                                          const char *chars, uint32_t length,
                                          uint32_t hash) {
-  obj_string_t string =
-      reallocate(NULL, 0, sizeof(struct obj_string) + length + 1);
+  table_reserve(strings, 1);
+
+  obj_string_t string = (obj_string_t)_allocate_obj(
+      objects, OBJ_KIND_STRING, sizeof(struct obj_string) + length + 1);
   string->length = length;
   string->is_owned = true;
-  string->obj.kind = OBJ_KIND_STRING;
   string->hash = hash;
 
   memcpy(string->as.owned, chars, length);
   string->as.owned[length] = 0;
 
-  string->obj.next = *objects;
-  *objects = AS_OBJ(string);
-
   table_insert(strings, string, TABLE_NIL);
 
   return string;
 }
 
+obj_integer_t obj_integer_new(obj_t *objects, int64_t value) {
+  obj_integer_t integer =
+      ALLOCATE_OBJ(objects, struct obj_integer, OBJ_KIND_INTEGER);
+  integer->value = value;
+  return integer;
+}
+
+obj_function_t obj_function_new(obj_t *objects) {
+  obj_function_t function =
+      ALLOCATE_OBJ(objects, struct obj_function, OBJ_KIND_FUNCTION);
+  function->arity = function->locals = 0;
+  function->chunk = NULL;
+  chunk_init(&function->chunk);
+  return function;
+}
+
 obj_string_t obj_string_copy(obj_t *objects, table_t *strings,
                              const char *chars, uint32_t length) {
   uint32_t hash = table_hash(chars, length);
@@ -57,28 +76,121 @@ obj_string_t obj_string_ref(obj_t *objects, table_t *strings, const char *chars,
     return interned;
   }
 
-  obj_string_t string = reallocate(NULL, 0, sizeof(struct obj_string));
+  table_reserve(strings, 1);
+
+  obj_string_t string =
+      ALLOCATE_OBJ(objects, struct obj_string, OBJ_KIND_STRING);
   string->is_owned = false;
   string->as.ref = chars;
   string->length = length;
   string->hash = hash;
-  string->obj.kind = OBJ_KIND_STRING;
 
   table_insert(strings, string, TABLE_NIL);
 
   return string;
 }
 
-static void obj_free(obj_t obj) {
+static obj_buffer_t _buffer_new(obj_t *objects, uint32_t capacity) {
+  char *chars = reallocate(NULL, 0, capacity);
+  obj_buffer_t buffer =
+      ALLOCATE_OBJ(objects, struct obj_buffer, OBJ_KIND_BUFFER);
+  buffer->length = 0;
+  buffer->capacity = capacity;
+  buffer->chars = chars;
+  return buffer;
+}
+
+static void _buffer_append(obj_buffer_t buffer, const char *chars,
+                           uint32_t length) {
+  if (buffer->capacity < buffer->length + length) {
+    uint32_t capacity = buffer->capacity;
+    while (capacity < buffer->length + length) {
+      capacity *= CAPACITY_MULT;
+    }
+    buffer->chars = reallocate(buffer->chars, buffer->capacity, capacity);
+    buffer->capacity = capacity;
+  }
+  memcpy(buffer->chars + buffer->length, chars, length);
+  buffer->length += length;
+}
+
+static bool _can_append(const struct obj *a, const struct obj *b) {
+  if (a->kind != OBJ_KIND_ROPE) {
+    return false;
+  }
+  obj_buffer_t buffer = OBJ_AS_ROPE(a)->buffer;
+  return OBJ_AS_ROPE(a)->length == buffer->length &&
+         (b->kind != OBJ_KIND_ROPE || OBJ_AS_ROPE(b)->buffer != buffer);
+}
+
+obj_t obj_text_concat(obj_t *objects, table_t *strings, const struct obj *a,
+                      const struct obj *b) {
+  uint32_t a_length = obj_text_length(a);
+  uint32_t b_length = obj_text_length(b);
+  uint32_t length = a_length + b_length;
+
+  if (length < ROPE_MIN_LENGTH) {
+    char chars[ROPE_MIN_LENGTH];
+    memcpy(chars, obj_text_chars(a), a_length);
+    memcpy(chars + a_length, obj_text_chars(b), b_length);
+    return AS_OBJ(obj_string_copy(objects, strings, chars, length));
+  }
+
+  obj_buffer_t buffer;
+  if (_can_append(a, b)) {
+    buffer = OBJ_AS_ROPE(a)->buffer;
+  } else {
+    buffer = _buffer_new(objects, length * CAPACITY_MULT);
+    _buffer_append(buffer, obj_text_chars(a), a_length);
+  }
+  _buffer_append(buffer, obj_text_chars(b), b_length);
+
+  obj_rope_t rope = ALLOCATE_OBJ(objects, struct obj_rope, OBJ_KIND_ROPE);
+  rope->length = length;
+  rope->buffer = buffer;
+  return AS_OBJ(rope);
+}
+
+static inline bool _is_text(const struct obj *obj) {
+  return obj->kind == OBJ_KIND_STRING || obj->kind == OBJ_KIND_ROPE;
+}
+
+bool obj_is_equal(const struct obj *a, const struct obj *b) {
+  if (a == b) {
+    return true;
+  }
+  if (!_is_text(a) || !_is_text(b) ||
+      (a->kind == OBJ_KIND_STRING && b->kind == OBJ_KIND_STRING)) {
+    return false;
+  }
+
+  uint32_t length = obj_text_length(a);
+  return length == obj_text_length(b) &&
+         !memcmp(obj_text_chars(a), obj_text_chars(b), length);
+}
+
+void obj_free(obj_t obj) {
   switch (obj->kind) {
   case OBJ_KIND_STRING: {
     obj_string_t string = OBJ_AS_STRING(obj);
-    if (string->is_owned) {
-      MEM_FREE(string->as.owned, string->length + 1);
-    }
-    MEM_FREE(obj, sizeof(struct obj));
+    MEM_FREE(obj, sizeof(struct obj_string) +
+                      (string->is_owned ? string->length + 1 : 0));
     break;
   }
+  case OBJ_KIND_INTEGER:
+    MEM_FREE(obj, sizeof(struct obj_integer));
+    break;
+  case OBJ_KIND_BUFFER:
+    MEM_FREE(OBJ_AS_BUFFER(obj)->chars, OBJ_AS_BUFFER(obj)->capacity);
+    MEM_FREE(obj, sizeof(struct obj_buffer));
+    break;
+  case OBJ_KIND_ROPE:
+    MEM_FREE(obj, sizeof(struct obj_rope));
+    break;
+  case OBJ_KIND_FUNCTION:
+    chunk_free(&OBJ_AS_FUNCTION(obj)->chunk);
+    MEM_FREE(obj, sizeof(struct obj_function));
+    break;
   }
 }
 
@@ -104,6 +216,20 @@ void obj_print(const obj_t obj) {
               OBJ_AS_STRING(obj)->as.ref);
     }
     break;
+  case OBJ_KIND_INTEGER:
+    fprintf(stderr, "%lli", OBJ_AS_INTEGER(obj)->value);
+    break;
+  case OBJ_KIND_BUFFER:
+    fprintf(stderr, "<buffer %u/%u>", OBJ_AS_BUFFER(obj)->length,
+            OBJ_AS_BUFFER(obj)->capacity);
+    break;
+  case OBJ_KIND_ROPE:
+    fprintf(stderr, "\"%.*s\"", OBJ_AS_ROPE(obj)->length,
+            OBJ_AS_ROPE(obj)->buffer->chars);
+    break;
+  case OBJ_KIND_FUNCTION:
+    fputs("<function>", stderr);
+    break;
   }
 }
 #endif
\ No newline at end of file
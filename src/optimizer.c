@@ -0,0 +1,511 @@
+#include "optimizer.h"
+#include "ast.h"
+#include "memory.h"
+#include <stdint.h>
+#include <string.h>
+
+#define FOLD(node_kind, field, value)                                          \
+  (*ast = (struct ast){ast->line, ast->column, node_kind,                    \
+                      .as.field = (value)},                                    \
+   ast)
+#define FOLD_BOOL(value) FOLD(NODE_KIND_BOOL, boolean, value)
+#define FOLD_INTEGER(value) FOLD(NODE_KIND_INTEGER, integer, value)
+#define FOLD_REAL(value) FOLD(NODE_KIND_REAL, real, value)
+
+#define CAPACITY_INIT 16U
+#define CAPACITY_MULT 2U
+
+// The type of an expression the compiler would reject, or whose names were
+// declared outside the tree being optimized, such as earlier REPL lines.
+#define TYPE_UNKNOWN NODE_KIND_VARIABLE
+
+// A declared name and the type the compiler will resolve it to: a variable's
+// or constant's type, or the type a function returns.
+struct name {
+  const char *chars;
+  uint32_t length;
+  enum node_kind type;
+};
+
+// Names are in scope in the order the compiler declares them, so the latest
+// match is the one it resolves to.
+struct optimizer {
+  struct ast_arena *arena;
+  struct name *names;
+  uint32_t count, capacity;
+};
+
+static inline bool _is_literal(const struct ast *ast) {
+  return ast->kind <= NODE_KIND_STRING;
+}
+
+static void _declare(struct optimizer *optimizer, const struct ast *ast,
+                     enum node_kind type) {
+  if (optimizer->count == optimizer->capacity) {
+    uint32_t capacity = optimizer->capacity
+                            ? optimizer->capacity * CAPACITY_MULT
+                            : CAPACITY_INIT;
+    optimizer->names = MEM_ARRAY_REALLOC(struct name, optimizer->names,
+                                         optimizer->capacity, capacity);
+    optimizer->capacity = capacity;
+  }
+  optimizer->names[optimizer->count++] = (struct name){
+      ast->as.variable.name, ast->as.variable.length, type};
+}
+
+static enum node_kind _lookup(const struct optimizer *optimizer,
+                              const struct ast *ast) {
+  for (uint32_t i = optimizer->count; i-- > 0;) {
+    const struct name *name = optimizer->names + i;
+    if (name->length == ast->as.variable.length &&
+        !memcmp(name->chars, ast->as.variable.name, name->length)) {
+      return name->type;
+    }
+  }
+  return TYPE_UNKNOWN;
+}
+
+// The type the compiler gives an expression, following its rules for
+// widening mixed INTEGER and REAL operands.
+static enum node_kind _type(const struct optimizer *optimizer,
+                            const struct ast *ast) {
+  enum node_kind lhs, rhs;
+  switch (ast->kind) {
+  case NODE_KIND_BOOL:
+  case NODE_KIND_CHAR:
+  case NODE_KIND_REAL:
+  case NODE_KIND_INTEGER:
+  case NODE_KIND_STRING:
+    return ast->kind;
+  case NODE_KIND_VARIABLE:
+    return _lookup(optimizer, ast);
+  case NODE_KIND_CALL:
+    return ast->as.binary.lhs->kind == NODE_KIND_VARIABLE
+               ? _lookup(optimizer, ast->as.binary.lhs)
+               : TYPE_UNKNOWN;
+  case NODE_KIND_GROUP:
+    return _type(optimizer, ast->as.expr);
+  case NODE_KIND_NEGATE:
+    lhs = _type(optimizer, ast->as.expr);
+    return lhs == NODE_KIND_INTEGER || lhs == NODE_KIND_REAL ? lhs
+                                                             : TYPE_UNKNOWN;
+  case NODE_KIND_NOT:
+    return _type(optimizer, ast->as.expr) == NODE_KIND_BOOL ? NODE_KIND_BOOL
+                                                            : TYPE_UNKNOWN;
+  case NODE_KIND_ADD:
+  case NODE_KIND_SUB:
+  case NODE_KIND_MUL:
+  case NODE_KIND_DIV:
+  case NODE_KIND_INT_DIV:
+  case NODE_KIND_MOD:
+    lhs = _type(optimizer, ast->as.binary.lhs);
+    rhs = _type(optimizer, ast->as.binary.rhs);
+    if (lhs == NODE_KIND_INTEGER && rhs == NODE_KIND_INTEGER) {
+      return NODE_KIND_INTEGER;
+    }
+    if (ast->kind == NODE_KIND_INT_DIV || ast->kind == NODE_KIND_MOD ||
+        (lhs != NODE_KIND_INTEGER && lhs != NODE_KIND_REAL) ||
+        (rhs != NODE_KIND_INTEGER && rhs != NODE_KIND_REAL)) {
+      return TYPE_UNKNOWN;
+    }
+    return NODE_KIND_REAL;
+  case NODE_KIND_AND:
+  case NODE_KIND_OR:
+  case NODE_KIND_CONCAT:
+    lhs = ast->kind == NODE_KIND_CONCAT ? NODE_KIND_STRING : NODE_KIND_BOOL;
+    return _type(optimizer, ast->as.binary.lhs) == lhs &&
+                   _type(optimizer, ast->as.binary.rhs) == lhs
+               ? lhs
+               : TYPE_UNKNOWN;
+  case NODE_KIND_EQUAL:
+  case NODE_KIND_NOT_EQUAL:
+  case NODE_KIND_GREATER:
+  case NODE_KIND_GREATER_EQUAL:
+  case NODE_KIND_LESS:
+  case NODE_KIND_LESS_EQUAL:
+    return NODE_KIND_BOOL;
+  default:
+    return TYPE_UNKNOWN;
+  }
+}
+
+static inline bool _has_kind(const struct optimizer *optimizer,
+                             const struct ast *ast, enum node_kind kind) {
+  return _type(optimizer, ast) == kind;
+}
+
+static inline bool _is_numeric(const struct optimizer *optimizer,
+                               const struct ast *ast) {
+  enum node_kind type = _type(optimizer, ast);
+  return type == NODE_KIND_INTEGER || type == NODE_KIND_REAL;
+}
+
+static inline bool _is_integer(const struct ast *ast, int64_t value) {
+  return ast->kind == NODE_KIND_INTEGER && ast->as.integer == value;
+}
+
+static inline bool _is_real(const struct ast *ast, double value) {
+  return ast->kind == NODE_KIND_REAL && ast->as.real == value;
+}
+
+static inline bool _is_bool(const struct ast *ast, bool value) {
+  return ast->kind == NODE_KIND_BOOL && ast->as.boolean == value;
+}
+
+static inline bool _is_empty_string(const struct ast *ast) {
+  return ast->kind == NODE_KIND_STRING && !ast->as.string.length;
+}
+
+static struct ast *_concat(struct ast_arena *arena, struct ast *ast,
+                           const struct ast *lhs, const struct ast *rhs) {
+  uint32_t length = lhs->as.string.length + rhs->as.string.length;
+  char *chars = ast_arena_chars(arena, length);
+  memcpy(chars, lhs->as.string.chars, lhs->as.string.length);
+  memcpy(chars + lhs->as.string.length, rhs->as.string.chars,
+         rhs->as.string.length);
+  *ast = (struct ast){ast->line, ast->column, NODE_KIND_STRING,
+                      .as.string = {length, true, chars}};
+  return ast;
+}
+
+static bool _literal_equal(const struct ast *lhs, const struct ast *rhs) {
+  if (lhs->kind != rhs->kind) {
+    return false;
+  }
+  switch (lhs->kind) {
+  case NODE_KIND_BOOL:
+    return lhs->as.boolean == rhs->as.boolean;
+  case NODE_KIND_CHAR:
+    return lhs->as.cha == rhs->as.cha;
+  case NODE_KIND_REAL:
+    return lhs->as.real == rhs->as.real;
+  case NODE_KIND_INTEGER:
+    return lhs->as.integer == rhs->as.integer;
+  case NODE_KIND_STRING:
+    return lhs->as.string.length == rhs->as.string.length &&
+           !memcmp(lhs->as.string.chars, rhs->as.string.chars,
+                   lhs->as.string.length);
+  default:
+    return false;
+  }
+}
+
+static struct ast *_fold_integer(struct ast *ast, int64_t a, int64_t b) {
+  int64_t result;
+  switch (ast->kind) {
+  case NODE_KIND_ADD:
+    return __builtin_add_overflow(a, b, &result) ? ast : FOLD_INTEGER(result);
+  case NODE_KIND_SUB:
+    return __builtin_sub_overflow(a, b, &result) ? ast : FOLD_INTEGER(result);
+  case NODE_KIND_MUL:
+    return __builtin_mul_overflow(a, b, &result) ? ast : FOLD_INTEGER(result);
+  case NODE_KIND_DIV:
+  case NODE_KIND_INT_DIV:
+    return !b || (a == INT64_MIN && b == -1) ? ast : FOLD_INTEGER(a / b);
+  case NODE_KIND_MOD:
+    return !b || (a == INT64_MIN && b == -1) ? ast : FOLD_INTEGER(a % b);
+  case NODE_KIND_GREATER:
+    return FOLD_BOOL(a > b);
+  case NODE_KIND_GREATER_EQUAL:
+    return FOLD_BOOL(a >= b);
+  case NODE_KIND_LESS:
+    return FOLD_BOOL(a < b);
+  case NODE_KIND_LESS_EQUAL:
+    return FOLD_BOOL(a <= b);
+  default:
+    return ast;
+  }
+}
+
+static struct ast *_fold_real(struct ast *ast, double a, double b) {
+  switch (ast->kind) {
+  case NODE_KIND_ADD:
+    return FOLD_REAL(a + b);
+  case NODE_KIND_SUB:
+    return FOLD_REAL(a - b);
+  case NODE_KIND_MUL:
+    return FOLD_REAL(a * b);
+  case NODE_KIND_DIV:
+    return FOLD_REAL(a / b);
+  case NODE_KIND_GREATER:
+    return FOLD_BOOL(a > b);
+  case NODE_KIND_GREATER_EQUAL:
+    return FOLD_BOOL(a >= b);
+  case NODE_KIND_LESS:
+    return FOLD_BOOL(a < b);
+  case NODE_KIND_LESS_EQUAL:
+    return FOLD_BOOL(a <= b);
+  default:
+    return ast;
+  }
+}
+
+static struct ast *_fold_ordered(struct ast *ast, int64_t a, int64_t b) {
+  switch (ast->kind) {
+  case NODE_KIND_GREATER:
+    return FOLD_BOOL(a > b);
+  case NODE_KIND_GREATER_EQUAL:
+    return FOLD_BOOL(a >= b);
+  case NODE_KIND_LESS:
+    return FOLD_BOOL(a < b);
+  case NODE_KIND_LESS_EQUAL:
+    return FOLD_BOOL(a <= b);
+  default:
+    return ast;
+  }
+}
+
+static struct ast *_fold_literals(struct ast_arena *arena, struct ast *ast) {
+  struct ast *lhs = ast->as.binary.lhs;
+  struct ast *rhs = ast->as.binary.rhs;
+
+  // Mixed literals are left to the compiler, which widens or rejects them.
+  if (lhs->kind != rhs->kind) {
+    return ast;
+  }
+
+  switch (ast->kind) {
+  case NODE_KIND_EQUAL:
+    return FOLD_BOOL(_literal_equal(lhs, rhs));
+  case NODE_KIND_NOT_EQUAL:
+    return FOLD_BOOL(!_literal_equal(lhs, rhs));
+  case NODE_KIND_CONCAT:
+    if (lhs->kind == NODE_KIND_STRING && rhs->kind == NODE_KIND_STRING) {
+      return _concat(arena, ast, lhs, rhs);
+    }
+    return ast;
+  default:
+    break;
+  }
+
+  switch (lhs->kind) {
+  case NODE_KIND_INTEGER:
+    return _fold_integer(ast, lhs->as.integer, rhs->as.integer);
+  case NODE_KIND_REAL:
+    return _fold_real(ast, lhs->as.real, rhs->as.real);
+  case NODE_KIND_CHAR:
+    return _fold_ordered(ast, lhs->as.cha, rhs->as.cha);
+  case NODE_KIND_BOOL:
+    if (ast->kind == NODE_KIND_AND) {
+      return FOLD_BOOL(lhs->as.boolean && rhs->as.boolean);
+    }
+    if (ast->kind == NODE_KIND_OR) {
+      return FOLD_BOOL(lhs->as.boolean || rhs->as.boolean);
+    }
+    return _fold_ordered(ast, lhs->as.boolean, rhs->as.boolean);
+  default:
+    return ast;
+  }
+}
+
+static struct ast *_simplify(struct optimizer *optimizer, struct ast *ast) {
+  struct ast *lhs = ast->as.binary.lhs;
+  struct ast *rhs = ast->as.binary.rhs;
+
+  switch (ast->kind) {
+  case NODE_KIND_ADD:
+    if (_is_integer(rhs, 0) && _has_kind(optimizer, lhs, NODE_KIND_INTEGER)) {
+      return lhs;
+    }
+    if (_is_integer(lhs, 0) && _has_kind(optimizer, rhs, NODE_KIND_INTEGER)) {
+      return rhs;
+    }
+    break;
+  case NODE_KIND_SUB:
+    if ((_is_integer(rhs, 0) && _is_numeric(optimizer, lhs)) ||
+        (_is_real(rhs, 0) && _has_kind(optimizer, lhs, NODE_KIND_REAL))) {
+      return lhs;
+    }
+    break;
+  case NODE_KIND_MUL:
+    if ((_is_integer(rhs, 1) && _is_numeric(optimizer, lhs)) ||
+        (_is_real(rhs, 1) && _has_kind(optimizer, lhs, NODE_KIND_REAL))) {
+      return lhs;
+    }
+    if ((_is_integer(lhs, 1) && _is_numeric(optimizer, rhs)) ||
+        (_is_real(lhs, 1) && _has_kind(optimizer, rhs, NODE_KIND_REAL))) {
+      return rhs;
+    }
+    break;
+  case NODE_KIND_DIV:
+    if ((_is_integer(rhs, 1) && _is_numeric(optimizer, lhs)) ||
+        (_is_real(rhs, 1) && _has_kind(optimizer, lhs, NODE_KIND_REAL))) {
+      return lhs;
+    }
+    break;
+  case NODE_KIND_INT_DIV:
+    if (_is_integer(rhs, 1) && _has_kind(optimizer, lhs, NODE_KIND_INTEGER)) {
+      return lhs;
+    }
+    break;
+  case NODE_KIND_AND:
+    if (_is_bool(rhs, true) && _has_kind(optimizer, lhs, NODE_KIND_BOOL)) {
+      return lhs;
+    }
+    if (_is_bool(lhs, true) && _has_kind(optimizer, rhs, NODE_KIND_BOOL)) {
+      return rhs;
+    }
+    break;
+  case NODE_KIND_OR:
+    if (_is_bool(rhs, false) && _has_kind(optimizer, lhs, NODE_KIND_BOOL)) {
+      return lhs;
+    }
+    if (_is_bool(lhs, false) && _has_kind(optimizer, rhs, NODE_KIND_BOOL)) {
+      return rhs;
+    }
+    break;
+  case NODE_KIND_CONCAT:
+    if (_is_empty_string(rhs) && _has_kind(optimizer, lhs, NODE_KIND_STRING)) {
+      return lhs;
+    }
+    if (_is_empty_string(lhs) && _has_kind(optimizer, rhs, NODE_KIND_STRING)) {
+      return rhs;
+    }
+    if (rhs->kind == NODE_KIND_STRING && lhs->kind == NODE_KIND_CONCAT &&
+        lhs->as.binary.rhs->kind == NODE_KIND_STRING) {
+      _concat(optimizer->arena, lhs->as.binary.rhs, lhs->as.binary.rhs, rhs);
+      return lhs;
+    }
+    break;
+  default:
+    break;
+  }
+  return ast;
+}
+
+static struct ast *_optimize(struct optimizer *optimizer, struct ast *ast);
+
+static void _optimize_list(struct optimizer *optimizer, struct ast *list) {
+  for (; list; list = list->as.list.next) {
+    list->as.list.item = _optimize(optimizer, list->as.list.item);
+  }
+}
+
+static struct ast *_optimize(struct optimizer *optimizer, struct ast *ast) {
+  switch (ast->kind) {
+  case NODE_KIND_GROUP:
+    return _optimize(optimizer, ast->as.expr);
+  case NODE_KIND_NOT: {
+    struct ast *expr = ast->as.expr = _optimize(optimizer, ast->as.expr);
+    if (expr->kind == NODE_KIND_BOOL) {
+      return FOLD_BOOL(!expr->as.boolean);
+    }
+    if (expr->kind == NODE_KIND_NOT &&
+        _has_kind(optimizer, expr->as.expr, NODE_KIND_BOOL)) {
+      return expr->as.expr;
+    }
+    return ast;
+  }
+  case NODE_KIND_NEGATE: {
+    struct ast *expr = ast->as.expr = _optimize(optimizer, ast->as.expr);
+    if (expr->kind == NODE_KIND_INTEGER && expr->as.integer != INT64_MIN) {
+      return FOLD_INTEGER(-expr->as.integer);
+    }
+    if (expr->kind == NODE_KIND_REAL) {
+      return FOLD_REAL(-expr->as.real);
+    }
+    if (expr->kind == NODE_KIND_NEGATE &&
+        _is_numeric(optimizer, expr->as.expr)) {
+      return expr->as.expr;
+    }
+    return ast;
+  }
+  case NODE_KIND_ADD:
+  case NODE_KIND_SUB:
+  case NODE_KIND_MUL:
+  case NODE_KIND_DIV:
+  case NODE_KIND_INT_DIV:
+  case NODE_KIND_MOD:
+  case NODE_KIND_AND:
+  case NODE_KIND_OR:
+  case NODE_KIND_CONCAT:
+  case NODE_KIND_EQUAL:
+  case NODE_KIND_NOT_EQUAL:
+  case NODE_KIND_GREATER:
+  case NODE_KIND_GREATER_EQUAL:
+  case NODE_KIND_LESS:
+  case NODE_KIND_LESS_EQUAL:
+    ast->as.binary.lhs = _optimize(optimizer, ast->as.binary.lhs);
+    ast->as.binary.rhs = _optimize(optimizer, ast->as.binary.rhs);
+    if (_is_literal(ast->as.binary.lhs) && _is_literal(ast->as.binary.rhs)) {
+      return _fold_literals(optimizer->arena, ast);
+    }
+    return _simplify(optimizer, ast);
+  case NODE_KIND_CALL:
+    _optimize_list(optimizer, ast->as.binary.rhs);
+    return ast;
+  case NODE_KIND_DECLARE:
+  case NODE_KIND_PARAMETER:
+    _declare(optimizer, ast, ast->as.variable.type);
+    return ast;
+  case NODE_KIND_CONSTANT:
+    ast->as.variable.expr = _optimize(optimizer, ast->as.variable.expr);
+    _declare(optimizer, ast, _type(optimizer, ast->as.variable.expr));
+    return ast;
+  case NODE_KIND_ASSIGN:
+    ast->as.variable.expr = _optimize(optimizer, ast->as.variable.expr);
+    return ast;
+  case NODE_KIND_CALL_STMT:
+  case NODE_KIND_RETURN:
+    ast->as.expr = _optimize(optimizer, ast->as.expr);
+    return ast;
+  case NODE_KIND_IF:
+    ast->as.branch.condition = _optimize(optimizer, ast->as.branch.condition);
+    _optimize_list(optimizer, ast->as.branch.then);
+    _optimize_list(optimizer, ast->as.branch.otherwise);
+    return ast;
+  case NODE_KIND_FUNCTION:
+  case NODE_KIND_PROCEDURE: {
+    // Parameters and locals go out of scope with the routine.
+    uint32_t count = optimizer->count;
+    _optimize_list(optimizer, ast->as.variable.expr);
+    optimizer->count = count;
+    return ast;
+  }
+  case NODE_KIND_BLOCK:
+  case NODE_KIND_ARGUMENTS:
+    _optimize_list(optimizer, ast);
+    return ast;
+  default:
+    return ast;
+  }
+}
+
+static inline bool _is_routine(const struct ast *ast) {
+  return ast->kind == NODE_KIND_FUNCTION || ast->kind == NODE_KIND_PROCEDURE;
+}
+
+// Visits a program in the order `chunk_write_from_ast` compiles it, so that
+// names resolve the same way: routines are declared first, their bodies see
+// only them and their own locals, and the main program comes last.
+struct ast *optimizer_run(struct ast_arena *arena, struct ast *ast,
+                          enum optimize_level level) {
+  if (level < OPTIMIZE_LEVEL_FOLD || !ast) {
+    return ast;
+  }
+  struct optimizer optimizer = {arena};
+  if (ast->kind != NODE_KIND_BLOCK) {
+    ast = _optimize(&optimizer, ast);
+  } else {
+    for (struct ast *block = ast; block; block = block->as.list.next) {
+      struct ast *item = block->as.list.item;
+      if (_is_routine(item)) {
+        _declare(&optimizer, item,
+                 item->kind == NODE_KIND_FUNCTION ? item->as.variable.type
+                                                  : TYPE_UNKNOWN);
+      }
+    }
+    for (struct ast *block = ast; block; block = block->as.list.next) {
+      if (_is_routine(block->as.list.item)) {
+        _optimize(&optimizer, block->as.list.item);
+      }
+    }
+    for (struct ast *block = ast; block; block = block->as.list.next) {
+      if (!_is_routine(block->as.list.item)) {
+        block->as.list.item = _optimize(&optimizer, block->as.list.item);
+      }
+    }
+  }
+  MEM_ARRAY_FREE(struct name, optimizer.names, optimizer.capacity);
+  return ast;
+}
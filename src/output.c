@@ -0,0 +1,137 @@
+#include "output.h"
+#include "obj.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define INTEGER_DIGITS_MAX 20U
+#define REAL_CHARS_MAX 32U
+
+static const char g_DIGIT_PAIRS[] = "00010203040506070809"
+                                    "10111213141516171819"
+                                    "20212223242526272829"
+                                    "30313233343536373839"
+                                    "40414243444546474849"
+                                    "50515253545556575859"
+                                    "60616263646566676869"
+                                    "70717273747576777879"
+                                    "80818283848586878889"
+                                    "90919293949596979899";
+
+void output_init(struct output *output, FILE *file) {
+  output->file = file;
+  output->is_owned = false;
+  output->count = 0;
+}
+
+void output_free(struct output *output) {
+  output_flush(output);
+  if (output->is_owned) {
+    fclose(output->file);
+  }
+  output_init(output, stdout);
+}
+
+// Sends everything written so far to the file at `path` instead, which is
+// created or truncated. Keeps the current target if it cannot be opened.
+bool output_open(struct output *output, const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    return false;
+  }
+  output_free(output);
+  output->file = file;
+  output->is_owned = true;
+  return true;
+}
+
+void output_flush(struct output *output) {
+  if (output->count) {
+    fwrite(output->buffer, 1, output->count, output->file);
+    output->count = 0;
+  }
+  fflush(output->file);
+}
+
+void output_write(struct output *output, const char *chars, size_t length) {
+  if (output->count + length > OUTPUT_BUFFER_SIZE) {
+    output_flush(output);
+    if (length > OUTPUT_BUFFER_SIZE) {
+      fwrite(chars, 1, length, output->file);
+      return;
+    }
+  }
+  memcpy(output->buffer + output->count, chars, length);
+  output->count += (uint32_t)length;
+}
+
+// Formats two digits at a time from the right, without going through printf.
+void output_write_integer(struct output *output, int64_t integer) {
+  char digits[INTEGER_DIGITS_MAX + 1];
+  char *start = digits + sizeof(digits);
+  uint64_t magnitude = integer < 0 ? -(uint64_t)integer : (uint64_t)integer;
+  while (magnitude >= 100) {
+    const char *pair = g_DIGIT_PAIRS + magnitude % 100 * 2;
+    magnitude /= 100;
+    *--start = pair[1];
+    *--start = pair[0];
+  }
+  if (magnitude >= 10) {
+    *--start = g_DIGIT_PAIRS[magnitude * 2 + 1];
+    *--start = g_DIGIT_PAIRS[magnitude * 2];
+  } else {
+    *--start = (char)('0' + magnitude);
+  }
+  if (integer < 0) {
+    *--start = '-';
+  }
+  output_write(output, start, digits + sizeof(digits) - start);
+}
+
+static void _write_obj(struct output *output, const struct obj *obj) {
+  switch (obj->kind) {
+  case OBJ_KIND_STRING:
+  case OBJ_KIND_ROPE:
+    output_write(output, obj_text_chars(obj), obj_text_length(obj));
+    break;
+  case OBJ_KIND_INTEGER:
+    output_write_integer(output, OBJ_AS_INTEGER(obj)->value);
+    break;
+  case OBJ_KIND_BUFFER:
+    output_write(output, OBJ_AS_BUFFER(obj)->chars,
+                 OBJ_AS_BUFFER(obj)->length);
+    break;
+  case OBJ_KIND_FUNCTION:
+    output_write(output, "<function>", sizeof("<function>") - 1);
+    break;
+  }
+}
+
+// Writes `value` as a program sees it: text without quotes, characters
+// bare, and BOOLEANs as TRUE or FALSE.
+void output_write_value(struct output *output, struct value value) {
+  switch (VALUE_KIND(value)) {
+  case VALUE_KIND_BOOL:
+    if (VALUE_AS_BOOL(value)) {
+      output_write(output, "TRUE", sizeof("TRUE") - 1);
+    } else {
+      output_write(output, "FALSE", sizeof("FALSE") - 1);
+    }
+    break;
+  case VALUE_KIND_CHAR:
+    output_write_char(output, (char)VALUE_AS_CHAR(value));
+    break;
+  case VALUE_KIND_REAL: {
+    char chars[REAL_CHARS_MAX];
+    int length = snprintf(chars, sizeof(chars), "%g", VALUE_AS_REAL(value));
+    output_write(output, chars, (size_t)length);
+    break;
+  }
+  case VALUE_KIND_INTEGER:
+    output_write_integer(output, VALUE_AS_INTEGER(value));
+    break;
+  case VALUE_KIND_OBJ:
+    _write_obj(output, VALUE_AS_OBJ(value));
+    break;
+  }
+}
@@ -1,6 +1,7 @@
 #include "parser.h"
 #include "ast.h"
 #include "scanner.h"
+#include <stdio.h>
 #include <stdlib.h>
 
 typedef struct ast *(*parse_fn_t)(struct parser *);
@@ -11,59 +12,108 @@ struct parse_rule {
   enum precedence precedence;
 };
 
-static const struct parse_rule g_RULES[];
+static const struct parse_rule g_RULES[TOKEN_KIND_COUNT];
+
+static void _error(struct parser *parser, const char *message) {
+  if (parser->panic_mode) {
+    return;
+  }
+  parser->panic_mode = true;
+  parser->had_error = true;
+
+  struct token token = parser->current;
+  flockfile(stderr);
+  fprintf(stderr, "[line %u] Error", token.line);
+  if (token.kind == TOKEN_KIND_SP_EOF) {
+    fputs(" at end", stderr);
+  } else if (token.kind == TOKEN_KIND_SP_EOL) {
+    fputs(" at end of line", stderr);
+  } else if (token.kind != TOKEN_KIND_SP_ERROR) {
+    fprintf(stderr, " at '%.*s'", token.length, token.start);
+  }
+  fprintf(stderr, ": %s\n", message);
+  funlockfile(stderr);
+}
 
 static inline void _advance(struct parser *parser) {
-  parser->current = scanner_scan_token(parser->scanner);
+  for (;;) {
+    parser->current = scanner_scan_token(parser->scanner);
+    if (parser->current.kind != TOKEN_KIND_SP_ERROR) {
+      return;
+    }
+    _error(parser, parser->current.start);
+  }
 }
 
-static inline void _consume(struct parser *parser, enum token_kind expect) {
+static inline void _consume(struct parser *parser, enum token_kind expect,
+                            const char *message) {
   if (parser->current.kind != expect) {
+    _error(parser, message);
+    return;
   }
   _advance(parser);
 }
 
-static struct ast *_prefix_char(struct parser *parser) {
+static inline bool _match(struct parser *parser, enum token_kind kind) {
+  if (parser->current.kind != kind) {
+    return false;
+  }
+  _advance(parser);
+  return true;
+}
+
+static inline bool _at_line_end(const struct parser *parser) {
+  return parser->current.kind == TOKEN_KIND_SP_EOL ||
+         parser->current.kind == TOKEN_KIND_SP_EOF;
+}
+
+static inline uint16_t _column(struct token token) {
+  return token.column < UINT16_MAX ? (uint16_t)token.column : UINT16_MAX;
+}
+
+static struct ast *_node(struct parser *parser, struct token token,
+                         enum node_kind kind) {
   struct ast *node = ast_arena_make(parser->arena);
-  *node = (struct ast){parser->current.line, NODE_KIND_CHAR,
-                       .as.cha = atoi(parser->current.start)};
+  *node = (struct ast){token.line, _column(token), kind};
+  return node;
+}
+
+static struct ast *_prefix_char(struct parser *parser) {
+  struct ast *node = _node(parser, parser->current, NODE_KIND_CHAR);
+  node->as.cha = atoi(parser->current.start);
   _advance(parser);
   return node;
 }
 
 static struct ast *_prefix_true(struct parser *parser) {
-  struct ast *node = ast_arena_make(parser->arena);
-  *node =
-      (struct ast){parser->current.line, NODE_KIND_BOOL, .as.boolean = true};
+  struct ast *node = _node(parser, parser->current, NODE_KIND_BOOL);
+  node->as.boolean = true;
   _advance(parser);
   return node;
 }
 
 static struct ast *_prefix_false(struct parser *parser) {
-  struct ast *node = ast_arena_make(parser->arena);
-  *node =
-      (struct ast){parser->current.line, NODE_KIND_BOOL, .as.boolean = false};
+  struct ast *node = _node(parser, parser->current, NODE_KIND_BOOL);
+  node->as.boolean = false;
   _advance(parser);
   return node;
 }
 
 static struct ast *_prefix_integer(struct parser *parser) {
-  struct ast *node = ast_arena_make(parser->arena);
-  *node = (struct ast){parser->current.line, NODE_KIND_INTEGER,
-                       .as.integer = strtoll(parser->current.start, NULL, 10)};
+  struct ast *node = _node(parser, parser->current, NODE_KIND_INTEGER);
+  node->as.integer = strtoll(parser->current.start, NULL, 10);
   _advance(parser);
   return node;
 }
 
 static struct ast *_prefix_real(struct parser *parser) {
-  struct ast *node = ast_arena_make(parser->arena);
-  *node = (struct ast){parser->current.line, NODE_KIND_REAL,
-                       .as.real = strtod(parser->current.start, NULL)};
+  struct ast *node = _node(parser, parser->current, NODE_KIND_REAL);
+  node->as.real = strtod(parser->current.start, NULL);
   _advance(parser);
   return node;
 }
 
-static const enum node_kind g_NODE_KIND[] = {
+static const enum node_kind g_NODE_KIND[TOKEN_KIND_COUNT] = {
     [TOKEN_KIND_OP_CONCAT] = NODE_KIND_CONCAT,
     [TOKEN_KIND_OP_ADDITION] = NODE_KIND_ADD,
     [TOKEN_KIND_KW_AND] = NODE_KIND_AND,
@@ -79,6 +129,7 @@ static const enum node_kind g_NODE_KIND[] = {
     [TOKEN_KIND_OP_LESS_OR_EQUAL_TO] = NODE_KIND_LESS_EQUAL,
     [TOKEN_KIND_OP_LESS_THAN] = NODE_KIND_LESS,
     [TOKEN_KIND_OP_NOT_EQUAL_TO] = NODE_KIND_NOT_EQUAL,
+    [TOKEN_KIND_OP_PAREN_OPEN] = NODE_KIND_CALL,
 };
 
 static struct ast *_expression(struct parser *parser);
@@ -88,7 +139,7 @@ static struct ast *_parse_precedence(struct parser *parser,
 static struct ast *_group(struct parser *parser) {
   _advance(parser);
   struct ast *expr = _expression(parser);
-  _consume(parser, TOKEN_KIND_OP_PAREN_CLOSE);
+  _consume(parser, TOKEN_KIND_OP_PAREN_CLOSE, "Expect ')' after expression.");
   return expr;
 }
 
@@ -97,6 +148,7 @@ static struct ast *_unary(struct parser *parser) {
   struct ast *expr = ast_arena_make(parser->arena);
   _advance(parser);
   expr->line = token.line;
+  expr->column = _column(token);
   switch (token.kind) {
   case TOKEN_KIND_KW_NOT:
     expr->kind = NODE_KIND_NOT;
@@ -114,12 +166,43 @@ static struct ast *_unary(struct parser *parser) {
 static struct ast *_prefix_string(struct parser *parser) {
   struct ast *node = ast_arena_make(parser->arena);
   struct token token = parser->current;
-  *node = (struct ast){token.line, NODE_KIND_STRING,
-                       .as.string = {token.length, token.start}};
+  *node = (struct ast){token.line, _column(token), NODE_KIND_STRING,
+                       .as.string = {token.length - 2, false, token.start + 1}};
   _advance(parser);
   return node;
 }
 
+static struct ast *_variable(struct parser *parser) {
+  struct ast *node = ast_arena_make(parser->arena);
+  struct token token = parser->current;
+  *node = (struct ast){token.line, _column(token), NODE_KIND_VARIABLE,
+                       .as.variable = {token.start, token.length}};
+  _advance(parser);
+  return node;
+}
+
+static struct ast **_append(struct parser *parser, struct ast **tail,
+                            enum node_kind kind, struct ast *item) {
+  struct ast *node = ast_arena_make(parser->arena);
+  *node = (struct ast){item->line, item->column, kind,
+                       .as.list = {item, NULL}};
+  *tail = node;
+  return &node->as.list.next;
+}
+
+static struct ast *_arguments(struct parser *parser) {
+  _advance(parser);
+  struct ast *arguments = NULL;
+  struct ast **tail = &arguments;
+  if (parser->current.kind != TOKEN_KIND_OP_PAREN_CLOSE) {
+    do {
+      tail = _append(parser, tail, NODE_KIND_ARGUMENTS, _expression(parser));
+    } while (_match(parser, TOKEN_KIND_OP_COMMA));
+  }
+  _consume(parser, TOKEN_KIND_OP_PAREN_CLOSE, "Expect ')' after arguments.");
+  return arguments;
+}
+
 static struct ast *_binary(struct parser *parser) {
   enum precedence precedence = g_RULES[parser->current.kind].precedence;
   _advance(parser);
@@ -131,6 +214,8 @@ static struct ast *_parse_precedence(struct parser *parser,
                                      enum precedence precedence) {
   const parse_fn_t prefix_rule = g_RULES[parser->current.kind].prefix;
   if (!prefix_rule) {
+    _error(parser, "Expect expression.");
+    return _node(parser, parser->current, NODE_KIND_BOOL);
   }
 
   struct ast *expr = prefix_rule(parser);
@@ -139,9 +224,9 @@ static struct ast *_parse_precedence(struct parser *parser,
   while (precedence <= g_RULES[(current = parser->current).kind].precedence) {
     parse_fn_t infix_rule = g_RULES[current.kind].infix;
     struct ast *lhs = expr;
-    expr = ast_arena_make(parser->arena);
-    *expr = (struct ast){current.line, g_NODE_KIND[current.kind],
-                         .as.binary = {lhs, infix_rule(parser)}};
+    expr = _node(parser, current, g_NODE_KIND[current.kind]);
+    expr->as.binary.lhs = lhs;
+    expr->as.binary.rhs = infix_rule(parser);
   }
 
   return expr;
@@ -151,8 +236,8 @@ static struct ast *_expression(struct parser *parser) {
   return _parse_precedence(parser, PRECEDENCE_ASSIGNMENT);
 }
 
-static const struct parse_rule g_RULES[] = {
-    [TOKEN_KIND_SP_IDENT] = {NULL, NULL, PRECEDENCE_NONE},
+static const struct parse_rule g_RULES[TOKEN_KIND_COUNT] = {
+    [TOKEN_KIND_SP_IDENT] = {_variable, NULL, PRECEDENCE_NONE},
     [TOKEN_KIND_LT_CHAR] = {_prefix_char, NULL, PRECEDENCE_NONE},
     [TOKEN_KIND_LT_DATE] = {NULL, NULL, PRECEDENCE_NONE},
     [TOKEN_KIND_LT_FALSE] = {_prefix_false, NULL, PRECEDENCE_NONE},
@@ -171,8 +256,8 @@ static const struct parse_rule g_RULES[] = {
     [TOKEN_KIND_OP_LESS_OR_EQUAL_TO] = {NULL, _binary, PRECEDENCE_COMPARISON},
     [TOKEN_KIND_OP_LESS_THAN] = {NULL, _binary, PRECEDENCE_COMPARISON},
     [TOKEN_KIND_OP_MULTIPLICATION] = {NULL, _binary, PRECEDENCE_FACTOR},
-    [TOKEN_KIND_OP_NOT_EQUAL_TO] = {NULL, NULL, PRECEDENCE_EQUALITY},
-    [TOKEN_KIND_OP_PAREN_OPEN] = {_group, NULL, PRECEDENCE_NONE},
+    [TOKEN_KIND_OP_NOT_EQUAL_TO] = {NULL, _binary, PRECEDENCE_EQUALITY},
+    [TOKEN_KIND_OP_PAREN_OPEN] = {_group, _arguments, PRECEDENCE_CALL},
     [TOKEN_KIND_OP_SUBTRACTION] = {_unary, _binary, PRECEDENCE_TERM},
     [TOKEN_KIND_KW_AND] = {NULL, _binary, PRECEDENCE_AND},
     [TOKEN_KIND_KW_DIV] = {NULL, _binary, PRECEDENCE_FACTOR},
@@ -181,10 +266,231 @@ static const struct parse_rule g_RULES[] = {
     [TOKEN_KIND_KW_OR] = {NULL, _binary, PRECEDENCE_OR},
 };
 
+static enum node_kind _type(struct parser *parser) {
+  enum node_kind type;
+  switch (parser->current.kind) {
+  case TOKEN_KIND_KW_BOOLEAN:
+    type = NODE_KIND_BOOL;
+    break;
+  case TOKEN_KIND_KW_CHAR:
+    type = NODE_KIND_CHAR;
+    break;
+  case TOKEN_KIND_KW_INTEGER:
+    type = NODE_KIND_INTEGER;
+    break;
+  case TOKEN_KIND_KW_REAL:
+    type = NODE_KIND_REAL;
+    break;
+  case TOKEN_KIND_KW_STRING:
+    type = NODE_KIND_STRING;
+    break;
+  default:
+    _error(parser, "Expect a type.");
+    return NODE_KIND_BOOL;
+  }
+  _advance(parser);
+  return type;
+}
+
+static struct ast *_name(struct parser *parser, enum node_kind kind) {
+  struct ast *node = ast_arena_make(parser->arena);
+  struct token token = parser->current;
+  *node = (struct ast){token.line, _column(token), kind,
+                       .as.variable = {token.start, token.length}};
+  _consume(parser, TOKEN_KIND_SP_IDENT, "Expect a name.");
+  return node;
+}
+
+static struct ast *_block(struct parser *parser);
+
+static void _skip_lines(struct parser *parser) {
+  while (parser->current.kind == TOKEN_KIND_SP_EOL) {
+    _advance(parser);
+  }
+}
+
+static struct ast *_declare(struct parser *parser) {
+  _advance(parser);
+  struct ast *node = _name(parser, NODE_KIND_DECLARE);
+  _consume(parser, TOKEN_KIND_OP_COLON, "Expect ':' after variable name.");
+  node->as.variable.type = _type(parser);
+  return node;
+}
+
+static struct ast *_constant(struct parser *parser) {
+  _advance(parser);
+  struct ast *node = _name(parser, NODE_KIND_CONSTANT);
+  _consume(parser, TOKEN_KIND_OP_EQUAL_TO, "Expect '=' after constant name.");
+  node->as.variable.expr = _expression(parser);
+  return node;
+}
+
+static struct ast *_call(struct parser *parser) {
+  struct token token = parser->current;
+  _advance(parser);
+  struct ast *callee = _name(parser, NODE_KIND_VARIABLE);
+  struct ast *arguments = NULL;
+  if (parser->current.kind == TOKEN_KIND_OP_PAREN_OPEN) {
+    arguments = _arguments(parser);
+  }
+
+  struct ast *call = ast_arena_make(parser->arena);
+  *call = (struct ast){callee->line, callee->column, NODE_KIND_CALL,
+                       .as.binary = {callee, arguments}};
+  struct ast *node = ast_arena_make(parser->arena);
+  *node = (struct ast){token.line, _column(token), NODE_KIND_CALL_STMT,
+                       .as.expr = call};
+  return node;
+}
+
+static struct ast *_if(struct parser *parser) {
+  struct ast *node = _node(parser, parser->current, NODE_KIND_IF);
+  _advance(parser);
+  node->as.branch.condition = _expression(parser);
+  _skip_lines(parser);
+  _consume(parser, TOKEN_KIND_KW_THEN, "Expect THEN after condition.");
+  node->as.branch.then = _block(parser);
+  if (_match(parser, TOKEN_KIND_KW_ELSE)) {
+    node->as.branch.otherwise = _block(parser);
+  }
+  _consume(parser, TOKEN_KIND_KW_ENDIF, "Expect ENDIF after IF.");
+  return node;
+}
+
+static struct ast *_return(struct parser *parser) {
+  struct ast *node = _node(parser, parser->current, NODE_KIND_RETURN);
+  _advance(parser);
+  node->as.expr = _expression(parser);
+  return node;
+}
+
+// The parameters become PARAMETER nodes at the head of the body.
+static struct ast *_routine(struct parser *parser) {
+  bool is_function = parser->current.kind == TOKEN_KIND_KW_FUNCTION;
+  _advance(parser);
+  struct ast *node =
+      _name(parser, is_function ? NODE_KIND_FUNCTION : NODE_KIND_PROCEDURE);
+
+  struct ast *body = NULL;
+  struct ast **tail = &body;
+  if (_match(parser, TOKEN_KIND_OP_PAREN_OPEN) &&
+      !_match(parser, TOKEN_KIND_OP_PAREN_CLOSE)) {
+    do {
+      _match(parser, TOKEN_KIND_KW_BYVAL);
+      struct ast *parameter = _name(parser, NODE_KIND_PARAMETER);
+      _consume(parser, TOKEN_KIND_OP_COLON, "Expect ':' after parameter name.");
+      parameter->as.variable.type = _type(parser);
+      tail = _append(parser, tail, NODE_KIND_BLOCK, parameter);
+    } while (_match(parser, TOKEN_KIND_OP_COMMA));
+    _consume(parser, TOKEN_KIND_OP_PAREN_CLOSE, "Expect ')' after parameters.");
+  }
+
+  if (is_function) {
+    _consume(parser, TOKEN_KIND_KW_RETURNS, "Expect RETURNS after parameters.");
+    node->as.variable.type = _type(parser);
+    *tail = _block(parser);
+    _consume(parser, TOKEN_KIND_KW_ENDFUNCTION,
+             "Expect ENDFUNCTION after function body.");
+  } else {
+    *tail = _block(parser);
+    _consume(parser, TOKEN_KIND_KW_ENDPROCEDURE,
+             "Expect ENDPROCEDURE after procedure body.");
+  }
+  node->as.variable.expr = body;
+  return node;
+}
+
+// An assignment starts out as an expression statement; the variable it
+// parsed becomes the target once `<-` shows up.
+static struct ast *_statement(struct parser *parser) {
+  switch (parser->current.kind) {
+  case TOKEN_KIND_KW_DECLARE:
+    return _declare(parser);
+  case TOKEN_KIND_KW_CONSTANT:
+    return _constant(parser);
+  case TOKEN_KIND_KW_CALL:
+    return _call(parser);
+  case TOKEN_KIND_KW_IF:
+    return _if(parser);
+  case TOKEN_KIND_KW_RETURN:
+    return _return(parser);
+  case TOKEN_KIND_KW_FUNCTION:
+  case TOKEN_KIND_KW_PROCEDURE:
+    return _routine(parser);
+  default:
+    break;
+  }
+
+  struct ast *expr = _expression(parser);
+  if (parser->current.kind != TOKEN_KIND_OP_ASSIGN) {
+    return expr;
+  }
+  if (expr->kind != NODE_KIND_VARIABLE) {
+    _error(parser, "Invalid assignment target.");
+    return expr;
+  }
+  _advance(parser);
+  expr->kind = NODE_KIND_ASSIGN;
+  expr->as.variable.expr = _expression(parser);
+  return expr;
+}
+
+static void _synchronize(struct parser *parser) {
+  parser->panic_mode = false;
+  while (!_at_line_end(parser)) {
+    _advance(parser);
+  }
+}
+
+static inline bool _ends_block(enum token_kind kind) {
+  switch (kind) {
+  case TOKEN_KIND_SP_EOF:
+  case TOKEN_KIND_KW_ELSE:
+  case TOKEN_KIND_KW_ENDIF:
+  case TOKEN_KIND_KW_ENDFUNCTION:
+  case TOKEN_KIND_KW_ENDPROCEDURE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// A statement ends at the end of its line or right before the keyword that
+// closes its block, so that `IF c THEN RETURN x ENDIF` fits on one line.
+static struct ast *_block(struct parser *parser) {
+  struct ast *block = NULL;
+  struct ast **tail = &block;
+
+  _skip_lines(parser);
+  while (!_ends_block(parser->current.kind)) {
+    struct ast *statement = _statement(parser);
+    if (!_at_line_end(parser) && !_ends_block(parser->current.kind)) {
+      _error(parser, "Expect end of line after statement.");
+    }
+    if (parser->panic_mode) {
+      _synchronize(parser);
+    }
+    tail = _append(parser, tail, NODE_KIND_BLOCK, statement);
+    _skip_lines(parser);
+  }
+
+  return block;
+}
+
 struct ast *parser_parse(struct parser *parser) {
-  struct ast *ast = _expression(parser);
-  _consume(parser, TOKEN_KIND_SP_EOF);
-  return ast;
+  struct ast *program = NULL;
+  struct ast **tail = &program;
+
+  for (;;) {
+    for (*tail = _block(parser); *tail; tail = &(*tail)->as.list.next)
+      ;
+    if (parser->current.kind == TOKEN_KIND_SP_EOF) {
+      return program;
+    }
+    _error(parser, "Unexpected end of block.");
+    _advance(parser);
+    _synchronize(parser);
+  }
 }
 
 void parser_init(struct parser *parser, struct ast_arena *arena,
@@ -192,5 +498,6 @@ void parser_init(struct parser *parser, struct ast_arena *arena,
   parser->arena = arena;
   parser->scanner = scanner;
   parser->had_error = false;
+  parser->panic_mode = false;
   _advance(parser);
 }
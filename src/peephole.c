@@ -0,0 +1,151 @@
+#include "peephole.h"
+#include "chunk.h"
+#include "memory.h"
+#include "obj.h"
+#include "value.h"
+#include <stdint.h>
+#include <string.h>
+
+struct jump {
+  uint32_t offset, target;
+};
+
+static inline bool _is_jump(uint8_t opcode) {
+  return opcode == OPCODE_JUMP || opcode == OPCODE_JUMP_IF_FALSE;
+}
+
+static inline uint32_t _jump_target(const uint8_t *code, uint32_t offset) {
+  return offset + 3 + (code[offset + 1] | code[offset + 2] << 8);
+}
+
+// The superinstruction for `CONSTANT k` followed by `opcode`, or OPCODE_COUNT
+// when there is none.
+static enum opcode _const_form(uint8_t opcode) {
+  switch (opcode) {
+  case OPCODE_ADD_INT:
+    return OPCODE_ADD_INT_CONST;
+  case OPCODE_SUB_INT:
+    return OPCODE_SUB_INT_CONST;
+  case OPCODE_EQUAL:
+    return OPCODE_EQUAL_CONST;
+  case OPCODE_LESS_INT:
+    return OPCODE_LESS_INT_CONST;
+  case OPCODE_GREATER_INT:
+    return OPCODE_GREATER_INT_CONST;
+  default:
+    return OPCODE_COUNT;
+  }
+}
+
+// Fuses the instruction at `read` with the one at `next` into `out`, and
+// returns how many bytes of input it consumed, or 0 when nothing fuses.
+// `CONSTANT a; CONSTANT b; ADD_INT` prefers `CONSTANT a; ADD_INT_CONST b`.
+static uint32_t _fuse(const uint8_t *code, const bool *is_target,
+                      uint32_t count, uint32_t read, uint32_t next,
+                      uint8_t *out, uint32_t *out_length) {
+  uint8_t opcode = code[read], following = code[next];
+  if (opcode == OPCODE_CONSTANT && _const_form(following) != OPCODE_COUNT) {
+    out[0] = _const_form(following);
+    out[1] = code[read + 1];
+    *out_length = 2;
+    return 3;
+  }
+  if (opcode == OPCODE_CONSTANT && following == OPCODE_CONSTANT &&
+      (next + 2 >= count || is_target[next + 2] ||
+       _const_form(code[next + 2]) == OPCODE_COUNT)) {
+    out[0] = OPCODE_CONSTANT_CONSTANT;
+    out[1] = code[read + 1];
+    out[2] = code[next + 1];
+    *out_length = 3;
+    return 4;
+  }
+  if ((opcode == OPCODE_EQUAL || opcode == OPCODE_NOT_EQUAL) &&
+      following == OPCODE_NOT) {
+    out[0] = opcode == OPCODE_EQUAL ? OPCODE_NOT_EQUAL : OPCODE_EQUAL;
+    *out_length = 1;
+    return 2;
+  }
+  return 0;
+}
+
+// Instructions are never fused when the second one is a jump target. Jumps
+// are re-aimed afterwards through `map`, from old offsets to new ones.
+static void _rewrite(chunk_t chunk) {
+  uint8_t *code = (uint8_t *)chunk->code;
+  uint32_t count = chunk->count;
+
+  bool *is_target = reallocate(NULL, 0, count + 1);
+  memset(is_target, 0, count + 1);
+  uint32_t jump_capacity = 1;
+  for (uint32_t offset = 0; offset < count;
+       offset += chunk_opcode_length(code[offset])) {
+    if (_is_jump(code[offset])) {
+      is_target[_jump_target(code, offset)] = true;
+      ++jump_capacity;
+    }
+  }
+
+  uint32_t *map = reallocate(NULL, 0, (count + 1) * sizeof(uint32_t));
+  struct jump *jumps =
+      reallocate(NULL, 0, jump_capacity * sizeof(struct jump));
+  debug_info_t debug;
+  debug_info_new(&debug);
+  struct debug_cursor cursor;
+  debug_cursor_init(&cursor, chunk->debug);
+
+  uint32_t write = 0, jump_count = 0;
+  for (uint32_t read = 0; read < count;) {
+    uint32_t length = chunk_opcode_length(code[read]);
+    struct location location = debug_cursor_at(&cursor, read);
+    uint8_t out[4];
+    uint32_t out_length = length;
+    uint32_t consumed = 0;
+    if (read + length < count && !is_target[read + length]) {
+      consumed = _fuse(code, is_target, count, read, read + length, out,
+                       &out_length);
+    }
+    if (!consumed) {
+      memcpy(out, code + read, length);
+      consumed = length;
+    }
+    if (_is_jump(out[0])) {
+      jumps[jump_count++] = (struct jump){write, _jump_target(code, read)};
+    }
+
+    map[read] = write;
+    debug_info_write(&debug, write, location);
+    for (uint32_t i = 0; i < out_length; ++i) {
+      code[write++] = out[i];
+    }
+    read += consumed;
+  }
+  map[count] = write;
+
+  for (uint32_t i = 0; i < jump_count; ++i) {
+    uint32_t offset = jumps[i].offset;
+    uint32_t jump = map[jumps[i].target] - (offset + 3);
+    code[offset + 1] = jump & 0xFF;
+    code[offset + 2] = jump >> 8;
+  }
+
+  chunk->count = write;
+  debug_info_free(&chunk->debug);
+  chunk->debug = debug;
+
+  reallocate(jumps, jump_capacity * sizeof(struct jump), 0);
+  reallocate(map, (count + 1) * sizeof(uint32_t), 0);
+  reallocate(is_target, count + 1, 0);
+}
+
+void peephole_run(chunk_t chunk) {
+  _rewrite(chunk);
+
+  const struct value_array *constants = chunk->constants;
+  for (uint32_t i = 0; i < constants->count; ++i) {
+    struct value value = constants->values[i];
+    if (value_is_obj(value) &&
+        VALUE_AS_OBJ(value)->kind == OBJ_KIND_FUNCTION) {
+      _rewrite(OBJ_AS_FUNCTION(VALUE_AS_OBJ(value))->chunk);
+    }
+  }
+}
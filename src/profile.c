@@ -0,0 +1,361 @@
+// <signal.h> declares a `stack_t` of its own; keep it out of the way of the
+// VM's operand stack type.
+#define stack_t signal_stack_t
+#include <signal.h>
+#undef stack_t
+
+#include "profile.h"
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define CAPACITY_INIT 256U
+#define CAPACITY_MULT 2U
+
+static struct profile *volatile g_profile;
+
+bool profile_init(struct profile *profile, struct vm *vm, uint32_t interval) {
+  *profile = (struct profile){.vm = vm, .interval = interval};
+  profile->raw_depths = malloc(PROFILE_SAMPLES_MAX * sizeof(uint32_t));
+  profile->raw_frames =
+      malloc(PROFILE_FRAMES_MAX * sizeof(struct profile_frame));
+  if (!profile->raw_depths || !profile->raw_frames) {
+    profile_free(profile);
+    return false;
+  }
+  return true;
+}
+
+void profile_free(struct profile *profile) {
+  free(profile->raw_depths);
+  free(profile->raw_frames);
+  free(profile->depths);
+  free(profile->sites);
+  *profile = (struct profile){0};
+}
+
+// Runs on SIGPROF, between any two instructions of the interpreter, so it
+// only reads the VM and writes the preallocated buffers. A sample taken while
+// a call or return is half done is caught in `profile_stop`.
+static void _sample(int signal) {
+  (void)signal;
+  struct profile *profile = g_profile;
+  if (!profile || !profile->vm->chunk) {
+    return;
+  }
+  const struct vm *vm = profile->vm;
+  uint32_t frame_count = vm->frame_count;
+  if (frame_count > VM_FRAMES_MAX) {
+    frame_count = VM_FRAMES_MAX;
+  }
+  uint32_t first = frame_count + 1 > PROFILE_DEPTH_MAX
+                       ? frame_count + 1 - PROFILE_DEPTH_MAX
+                       : 0;
+  uint32_t depth = frame_count + 1 - first;
+  if (profile->raw_count == PROFILE_SAMPLES_MAX ||
+      profile->raw_frame_count + depth > PROFILE_FRAMES_MAX) {
+    ++profile->dropped;
+    return;
+  }
+
+  struct profile_frame *frame = profile->raw_frames + profile->raw_frame_count;
+  for (uint32_t i = first; i < frame_count; ++i) {
+    *frame++ = (struct profile_frame){vm->frames[i].chunk, vm->frames[i].ip};
+  }
+  *frame = (struct profile_frame){vm->chunk, vm->ip};
+  profile->raw_frame_count += depth;
+  profile->raw_depths[profile->raw_count++] = depth;
+}
+
+static void _set_timer(uint32_t interval) {
+  struct itimerval timer = {
+      .it_interval = {interval / 1000000, interval % 1000000},
+      .it_value = {interval / 1000000, interval % 1000000},
+  };
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+void profile_start(struct profile *profile) {
+  g_profile = profile;
+  struct sigaction action = {.sa_handler = _sample, .sa_flags = SA_RESTART};
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, NULL);
+  _set_timer(profile->interval);
+}
+
+static void _append(struct profile *profile, const struct profile_frame *frame,
+                    uint32_t depth) {
+  if (profile->site_count + depth > profile->site_capacity) {
+    uint32_t capacity =
+        profile->site_capacity ? profile->site_capacity : CAPACITY_INIT;
+    while (capacity < profile->site_count + depth) {
+      capacity *= CAPACITY_MULT;
+    }
+    struct profile_site *sites =
+        realloc(profile->sites, capacity * sizeof(struct profile_site));
+    if (!sites) {
+      exit(1);
+    }
+    profile->sites = sites;
+    profile->site_capacity = capacity;
+  }
+  if (profile->count == profile->capacity) {
+    uint32_t capacity =
+        profile->capacity ? profile->capacity * CAPACITY_MULT : CAPACITY_INIT;
+    uint32_t *depths = realloc(profile->depths, capacity * sizeof(uint32_t));
+    if (!depths) {
+      exit(1);
+    }
+    profile->depths = depths;
+    profile->capacity = capacity;
+  }
+
+  struct profile_site *site = profile->sites + profile->site_count;
+  for (uint32_t i = 0; i < depth; ++i) {
+    const struct chunk *chunk = frame[i].chunk;
+    uint32_t offset = (uint32_t)(frame[i].ip - chunk->code);
+    // The instruction running is the one before `ip`: a frame's saved `ip`
+    // is past its CALL, and the running frame's is past the opcode byte.
+    site[i] = (struct profile_site){
+        chunk->name, chunk->name_length,
+        debug_info_lookup(chunk->debug, offset ? offset - 1 : 0, NULL).line};
+  }
+  profile->site_count += depth;
+  profile->depths[profile->count++] = depth;
+}
+
+static bool _is_valid(const struct profile_frame *frame) {
+  return frame->chunk && frame->ip >= frame->chunk->code &&
+         frame->ip <= frame->chunk->code + frame->chunk->count;
+}
+
+// Disarms the timer and maps the samples taken since `profile_start` to
+// sites. Must run before the chunks they point into are freed.
+void profile_stop(struct profile *profile) {
+  _set_timer(0);
+  signal(SIGPROF, SIG_IGN);
+  g_profile = NULL;
+
+  const struct profile_frame *frame = profile->raw_frames;
+  for (uint32_t i = 0; i < profile->raw_count; ++i) {
+    uint32_t depth = profile->raw_depths[i];
+    bool is_valid = true;
+    for (uint32_t j = 0; j < depth; ++j) {
+      is_valid = is_valid && _is_valid(frame + j);
+    }
+    if (is_valid) {
+      _append(profile, frame, depth);
+    } else {
+      ++profile->dropped;
+    }
+    frame += depth;
+  }
+  profile->raw_count = profile->raw_frame_count = 0;
+}
+
+static int _compare_names(const struct profile_site *a,
+                          const struct profile_site *b) {
+  if (!a->name || !b->name) {
+    return (a->name != NULL) - (b->name != NULL);
+  }
+  uint32_t length = a->length < b->length ? a->length : b->length;
+  int order = memcmp(a->name, b->name, length);
+  return order ? order : (a->length > b->length) - (a->length < b->length);
+}
+
+static int _compare_sites(const void *a, const void *b) {
+  const struct profile_site *x = a, *y = b;
+  int order = _compare_names(x, y);
+  return order ? order : (x->line > y->line) - (x->line < y->line);
+}
+
+// A line or routine and how many samples it was running in (`self`) or on
+// the stack of (`total`).
+struct profile_entry {
+  struct profile_site site;
+  uint32_t self, total;
+};
+
+static int _compare_entries(const void *a, const void *b) {
+  const struct profile_entry *x = a, *y = b;
+  if (x->self != y->self) {
+    return (x->self < y->self) - (x->self > y->self);
+  }
+  return (x->total < y->total) - (x->total > y->total);
+}
+
+static int _compare_marks(const void *a, const void *b) {
+  const struct profile_entry *x = a, *y = b;
+  return _compare_names(&x->site, &y->site);
+}
+
+static void _print_name(const struct profile_site *site) {
+  if (site->name) {
+    fprintf(stderr, "%.*s", (int)site->length, site->name);
+  } else {
+    fputs("<main>", stderr);
+  }
+}
+
+static void _print_lines(const struct profile *profile) {
+  struct profile_site *leaves =
+      malloc(profile->count * sizeof(struct profile_site));
+  struct profile_entry *entries =
+      malloc(profile->count * sizeof(struct profile_entry));
+  if (!leaves || !entries) {
+    free(leaves);
+    free(entries);
+    return;
+  }
+  uint32_t end = 0;
+  for (uint32_t i = 0; i < profile->count; ++i) {
+    end += profile->depths[i];
+    leaves[i] = profile->sites[end - 1];
+  }
+  qsort(leaves, profile->count, sizeof(struct profile_site), _compare_sites);
+
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < profile->count; ++i) {
+    if (count && !_compare_sites(&entries[count - 1].site, leaves + i)) {
+      ++entries[count - 1].self;
+    } else {
+      entries[count++] = (struct profile_entry){leaves[i], 1, 0};
+    }
+  }
+  qsort(entries, count, sizeof(struct profile_entry), _compare_entries);
+
+  fprintf(stderr, "%8s %7s  %6s  %s\n", "samples", "self", "line",
+          "routine");
+  for (uint32_t i = 0; i < count && i < PROFILE_REPORT_MAX; ++i) {
+    fprintf(stderr, "%8u %6.2f%%  %6u  ", entries[i].self,
+            100.0 * entries[i].self / profile->count, entries[i].site.line);
+    _print_name(&entries[i].site);
+    fputc('\n', stderr);
+  }
+  free(leaves);
+  free(entries);
+}
+
+// Marks every routine once per sample it is on the stack of, however deep it
+// recursed, with `self` set on the one that was running.
+static void _print_routines(const struct profile *profile) {
+  struct profile_entry *marks =
+      malloc(profile->site_count * sizeof(struct profile_entry));
+  if (!marks) {
+    return;
+  }
+  uint32_t count = 0;
+  const struct profile_site *sample = profile->sites;
+  for (uint32_t i = 0; i < profile->count; ++i) {
+    uint32_t depth = profile->depths[i];
+    uint32_t first = count;
+    for (uint32_t j = depth; j-- > 0;) {
+      bool is_seen = false;
+      for (uint32_t k = first; k < count && !is_seen; ++k) {
+        is_seen = !_compare_names(&marks[k].site, sample + j);
+      }
+      if (!is_seen) {
+        marks[count++] =
+            (struct profile_entry){sample[j], j == depth - 1, 1};
+      }
+    }
+    sample += depth;
+  }
+  qsort(marks, count, sizeof(struct profile_entry), _compare_marks);
+
+  uint32_t routines = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (routines && !_compare_marks(marks + routines - 1, marks + i)) {
+      marks[routines - 1].self += marks[i].self;
+      marks[routines - 1].total += marks[i].total;
+    } else {
+      marks[routines++] = marks[i];
+    }
+  }
+  qsort(marks, routines, sizeof(struct profile_entry), _compare_entries);
+
+  fprintf(stderr, "%8s %7s %7s  %s\n", "samples", "self", "total",
+          "routine");
+  for (uint32_t i = 0; i < routines && i < PROFILE_REPORT_MAX; ++i) {
+    fprintf(stderr, "%8u %6.2f%% %6.2f%%  ", marks[i].self,
+            100.0 * marks[i].self / profile->count,
+            100.0 * marks[i].total / profile->count);
+    _print_name(&marks[i].site);
+    fputc('\n', stderr);
+  }
+  free(marks);
+}
+
+void profile_print(const struct profile *profile) {
+  fprintf(stderr, "profile: %u samples every %u us, %u dropped\n",
+          profile->count, profile->interval, profile->dropped);
+  if (!profile->count) {
+    return;
+  }
+  _print_lines(profile);
+  _print_routines(profile);
+}
+
+static int _compare_stacks(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Writes one line per distinct call stack, its routines outermost first and
+// separated by semicolons, then its sample count: the collapsed format that
+// flame graph tools read.
+bool profile_write_folded(const struct profile *profile, const char *path) {
+  size_t size = 0;
+  for (uint32_t i = 0; i < profile->site_count; ++i) {
+    const struct profile_site *site = profile->sites + i;
+    size += (site->name ? site->length : sizeof("<main>") - 1) + 1;
+  }
+  char *text = malloc(size + 1);
+  char **stacks = malloc((profile->count + 1) * sizeof(char *));
+  FILE *file = fopen(path, "w");
+  if (!text || !stacks || !file) {
+    free(text);
+    free(stacks);
+    if (file) {
+      fclose(file);
+    }
+    return false;
+  }
+
+  char *end = text;
+  const struct profile_site *site = profile->sites;
+  for (uint32_t i = 0; i < profile->count; ++i) {
+    stacks[i] = end;
+    for (uint32_t j = 0; j < profile->depths[i]; ++j, ++site) {
+      if (j) {
+        *end++ = ';';
+      }
+      if (site->name) {
+        memcpy(end, site->name, site->length);
+        end += site->length;
+      } else {
+        memcpy(end, "<main>", sizeof("<main>") - 1);
+        end += sizeof("<main>") - 1;
+      }
+    }
+    *end++ = '\0';
+  }
+  qsort(stacks, profile->count, sizeof(char *), _compare_stacks);
+
+  for (uint32_t i = 0; i < profile->count;) {
+    uint32_t run = i;
+    while (run < profile->count && !strcmp(stacks[run], stacks[i])) {
+      ++run;
+    }
+    fprintf(file, "%s %u\n", stacks[i], run - i);
+    i = run;
+  }
+
+  bool ok = !ferror(file);
+  ok = !fclose(file) && ok;
+  free(text);
+  free(stacks);
+  return ok;
+}
@@ -0,0 +1,819 @@
+#include "reg_chunk.h"
+#include "memory.h"
+#include "obj.h"
+#include "types.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CAPACITY_INIT 8U
+#define CAPACITY_MULT 2U
+
+struct reg_local {
+  const char *name;
+  uint32_t length;
+  enum node_kind type;
+  bool is_constant;
+};
+
+// `routine` is the FUNCTION or PROCEDURE being compiled, or NULL for the main
+// program, whose names are all globals. A routine's parameters and locals are
+// its first `local_count` registers. `free` is the first register that holds
+// neither a local nor a live temporary; between statements it is
+// `local_count`, so a new local always takes the next register.
+struct reg_compiler {
+  reg_chunk_t *chunk;
+  globals_t *globals;
+  obj_t *objects;
+  table_t *strings;
+  const struct ast *routine;
+  uint32_t free, local_count;
+  bool had_error;
+  struct reg_local locals[REG_MAX];
+};
+
+void reg_chunk_init(reg_chunk_t *chunk) {
+  *chunk = reallocate(
+      NULL, 0, sizeof(struct reg_chunk) + CAPACITY_INIT * sizeof(uint32_t));
+  (*chunk)->count = 0;
+  (*chunk)->capacity = CAPACITY_INIT;
+  (*chunk)->registers = (*chunk)->globals = (*chunk)->max_frame = 0;
+  (*chunk)->routine_count = 0;
+  (*chunk)->routines = NULL;
+  (*chunk)->name = NULL;
+  (*chunk)->name_length = 0;
+  value_array_new(&(*chunk)->constants);
+  debug_info_new(&(*chunk)->debug);
+}
+
+void reg_chunk_free(reg_chunk_t *chunk) {
+  if ((*chunk)->routines) {
+    for (uint32_t i = 0; i < (*chunk)->routine_count; ++i) {
+      reg_chunk_free((*chunk)->routines + i);
+    }
+    reallocate((*chunk)->routines,
+               (*chunk)->routine_count * sizeof(reg_chunk_t), 0);
+  }
+  value_array_free(&(*chunk)->constants);
+  debug_info_free(&(*chunk)->debug);
+  reallocate(*chunk,
+             sizeof(struct reg_chunk) + (*chunk)->capacity * sizeof(uint32_t),
+             0);
+  *chunk = NULL;
+}
+
+void reg_chunk_write(reg_chunk_t *chunk, uint32_t instruction,
+                     struct location location) {
+  if ((*chunk)->capacity < (*chunk)->count + 1) {
+    uint32_t new_capacity = (*chunk)->capacity * CAPACITY_MULT;
+    *chunk = reallocate(
+        *chunk,
+        sizeof(struct reg_chunk) + (*chunk)->capacity * sizeof(uint32_t),
+        sizeof(struct reg_chunk) + new_capacity * sizeof(uint32_t));
+    (*chunk)->capacity = new_capacity;
+  }
+  debug_info_write(&(*chunk)->debug, (*chunk)->count, location);
+  (*chunk)->code[(*chunk)->count++] = instruction;
+}
+
+static void _error(struct reg_compiler *compiler, const struct ast *ast,
+                   const char *message) {
+  type_error(ast, message);
+  compiler->had_error = true;
+}
+
+static inline bool _is_routine(const struct ast *ast) {
+  return ast->kind == NODE_KIND_FUNCTION || ast->kind == NODE_KIND_PROCEDURE;
+}
+
+static inline struct location _at(const struct ast *ast) {
+  return (struct location){ast->line, ast->column};
+}
+
+static inline void _write(struct reg_compiler *compiler, uint32_t instruction,
+                          const struct ast *ast) {
+  reg_chunk_write(compiler->chunk, instruction, _at(ast));
+}
+
+static uint32_t _allocate(struct reg_compiler *compiler,
+                          const struct ast *ast) {
+  if (compiler->free >= REG_MAX) {
+    _error(compiler, ast, "Too many registers in one chunk.");
+    return 0;
+  }
+  uint32_t reg = compiler->free++;
+  if ((*compiler->chunk)->registers < compiler->free) {
+    (*compiler->chunk)->registers = compiler->free;
+  }
+  return reg;
+}
+
+static void _move(struct reg_compiler *compiler, uint32_t dest,
+                  uint32_t operand, const struct ast *ast) {
+  if (dest != operand) {
+    _write(compiler, REG_ENCODE(REG_OPCODE_MOVE, dest, operand, 0), ast);
+  }
+}
+
+static uint32_t _constant(struct reg_compiler *compiler, struct value value,
+                          const struct ast *ast) {
+  value_array_t constants = (*compiler->chunk)->constants;
+  for (uint32_t i = 0; i < constants->count && i < REG_RK_CONSTANT; ++i) {
+    if (value_is_equal(constants->values[i], value)) {
+      return i | REG_RK_CONSTANT;
+    }
+  }
+
+  value_array_write(&(*compiler->chunk)->constants, value);
+  uint32_t constant = (*compiler->chunk)->constants->count - 1;
+  if (constant < REG_RK_CONSTANT) {
+    return constant | REG_RK_CONSTANT;
+  }
+  if (constant > UINT16_MAX) {
+    _error(compiler, ast, "Too many constants in one chunk.");
+    return 0;
+  }
+
+  uint32_t reg = _allocate(compiler, ast);
+  _write(compiler, REG_ENCODE_BX(REG_OPCODE_LOADK, reg, constant), ast);
+  return reg;
+}
+
+static uint32_t _default(struct reg_compiler *compiler, enum node_kind type,
+                         const struct ast *ast) {
+  switch (type) {
+  case NODE_KIND_CHAR:
+    return _constant(compiler, VALUE_FROM_CHAR(' '), ast);
+  case NODE_KIND_REAL:
+    return _constant(compiler, VALUE_FROM_REAL(0.0), ast);
+  case NODE_KIND_INTEGER:
+    return _constant(compiler, VALUE_FROM_INTEGER(0), ast);
+  case NODE_KIND_STRING:
+    return _constant(compiler,
+                     VALUE_FROM_OBJ(obj_string_copy(compiler->objects,
+                                                    compiler->strings, "", 0)),
+                     ast);
+  default:
+    return _constant(compiler, VALUE_FROM_BOOL(false), ast);
+  }
+}
+
+// Writes a forward jump on `operand` whose distance `_patch_jump` fills in.
+static uint32_t _jump(struct reg_compiler *compiler, enum reg_opcode opcode,
+                      uint32_t operand, const struct ast *ast) {
+  _write(compiler, REG_ENCODE_BX(opcode, operand, 0), ast);
+  return (*compiler->chunk)->count - 1;
+}
+
+static void _patch_jump(struct reg_compiler *compiler, const struct ast *ast,
+                        uint32_t offset) {
+  uint32_t jump = (*compiler->chunk)->count - offset - 1;
+  if (jump > UINT16_MAX) {
+    _error(compiler, ast, "Too much code to jump over.");
+    return;
+  }
+  (*compiler->chunk)->code[offset] |= jump << 16;
+}
+
+// Reports the error of a rule the operands failed and returns its type.
+static enum node_kind _check(struct reg_compiler *compiler,
+                             const struct ast *ast,
+                             const struct type_rule *rule) {
+  if (rule->message[0]) {
+    _error(compiler, ast, rule->message);
+  }
+  return rule->type;
+}
+
+// Widens an INTEGER operand into a REAL in a fresh register.
+static uint32_t _widen(struct reg_compiler *compiler, const struct ast *ast,
+                       uint32_t operand) {
+  uint32_t reg = _allocate(compiler, ast);
+  _write(compiler, REG_ENCODE(REG_OPCODE_TO_REAL, reg, operand, 0), ast);
+  return reg;
+}
+
+// Checks that `operand`, of type `from`, may be stored as a `to` and returns
+// the operand that holds it as one.
+static uint32_t _convert(struct reg_compiler *compiler, const struct ast *ast,
+                         enum node_kind from, enum node_kind to,
+                         uint32_t operand) {
+  struct type_rule rule = type_convert(from, to);
+  if (_check(compiler, ast, &rule) != TYPE_ERROR && rule.widen_rhs) {
+    return _widen(compiler, ast, operand);
+  }
+  return operand;
+}
+
+static int32_t _resolve_local(const struct reg_compiler *compiler,
+                              const struct ast *ast) {
+  uint32_t length = ast->as.variable.length;
+  for (uint32_t slot = 0; slot < compiler->local_count; ++slot) {
+    const struct reg_local *local = compiler->locals + slot;
+    if (local->length == length &&
+        !memcmp(local->name, ast->as.variable.name, length)) {
+      return (int32_t)slot;
+    }
+  }
+  return -1;
+}
+
+// Declares a local in the next register and returns it.
+static uint32_t _declare_local(struct reg_compiler *compiler,
+                               const struct ast *ast, enum node_kind type,
+                               bool is_constant) {
+  compiler->free = compiler->local_count;
+  uint32_t reg = _allocate(compiler, ast);
+  if (_resolve_local(compiler, ast) >= 0) {
+    _error(compiler, ast, "Already declared.");
+  } else if (reg == compiler->local_count) {
+    compiler->locals[compiler->local_count++] = (struct reg_local){
+        ast->as.variable.name, ast->as.variable.length, type, is_constant};
+  }
+  return reg;
+}
+
+static enum node_kind _expression(struct reg_compiler *compiler,
+                                  struct ast *ast, uint32_t *operand);
+
+static enum node_kind _variable(struct reg_compiler *compiler,
+                                const struct ast *ast, uint32_t *operand) {
+  int32_t slot = _resolve_local(compiler, ast);
+  if (slot >= 0) {
+    *operand = (uint32_t)slot;
+    return compiler->locals[slot].type;
+  }
+
+  slot = globals_resolve(*compiler->globals, ast);
+  if (slot < 0) {
+    _error(compiler, ast, "Undeclared variable.");
+    return TYPE_ERROR;
+  }
+  const struct global *global = (*compiler->globals)->globals + slot;
+  if (global->kind >= GLOBAL_KIND_FUNCTION) {
+    _error(compiler, ast, "Routines can only be called.");
+    return TYPE_ERROR;
+  }
+  *operand = _allocate(compiler, ast);
+  _write(compiler, REG_ENCODE_BX(REG_OPCODE_GET_GLOBAL, *operand, slot), ast);
+  return global->type;
+}
+
+// Moves the arguments into consecutive registers from `free` on; the callee's
+// frame starts at the first of them and its result replaces it.
+static enum node_kind _call(struct reg_compiler *compiler, struct ast *ast,
+                            bool is_statement, uint32_t *dest) {
+  const struct ast *callee = ast->as.binary.lhs;
+  if (callee->kind != NODE_KIND_VARIABLE) {
+    _error(compiler, ast, "Can only call routines.");
+    return TYPE_ERROR;
+  }
+
+  int32_t slot = -1;
+  if (_resolve_local(compiler, callee) < 0 &&
+      (slot = globals_resolve(*compiler->globals, callee)) < 0) {
+    _error(compiler, callee, "Undeclared routine.");
+    return TYPE_ERROR;
+  }
+  const struct global *global =
+      slot >= 0 ? (*compiler->globals)->globals + slot : NULL;
+  if (!global || global->kind < GLOBAL_KIND_FUNCTION) {
+    _error(compiler, callee, "Can only call routines.");
+    return TYPE_ERROR;
+  }
+  if (is_statement && global->kind != GLOBAL_KIND_PROCEDURE) {
+    _error(compiler, callee, "Only procedures can be CALLed.");
+    return TYPE_ERROR;
+  }
+  if (!is_statement && global->kind != GLOBAL_KIND_FUNCTION) {
+    _error(compiler, callee, "Procedures must be invoked with CALL.");
+    return TYPE_ERROR;
+  }
+
+  uint32_t base = compiler->free;
+  uint32_t count = 0;
+  for (struct ast *argument = ast->as.binary.rhs; argument;
+       argument = argument->as.list.next, ++count) {
+    struct ast *item = argument->as.list.item;
+    uint32_t operand = 0;
+    enum node_kind type = _expression(compiler, item, &operand);
+    if (count < global->arity) {
+      operand = _convert(compiler, item, type, global->parameters[count],
+                         operand);
+    }
+    compiler->free = base + count;
+    _move(compiler, _allocate(compiler, item), operand, item);
+  }
+  if (count != global->arity) {
+    char message[64];
+    snprintf(message, sizeof(message), "Expected %u arguments but got %u.",
+             global->arity, count);
+    _error(compiler, callee, message);
+    return TYPE_ERROR;
+  }
+
+  compiler->free = base;
+  *dest = _allocate(compiler, ast);
+  _write(compiler, REG_ENCODE_BX(REG_OPCODE_CALL, *dest, slot), ast);
+  return global->type;
+}
+
+// AND and OR short-circuit: the right operand only runs when it decides the
+// result, and both arms leave their value in `dest`.
+static enum node_kind _logical(struct reg_compiler *compiler, struct ast *ast,
+                               uint32_t *dest) {
+  *dest = _allocate(compiler, ast);
+  uint32_t lhs = 0, rhs = 0;
+  enum node_kind lhs_type = _expression(compiler, ast->as.binary.lhs, &lhs);
+  _move(compiler, *dest, lhs, ast);
+  compiler->free = *dest + 1;
+  uint32_t skip =
+      _jump(compiler,
+            ast->kind == NODE_KIND_AND ? REG_OPCODE_JUMP_IF_FALSE
+                                       : REG_OPCODE_JUMP_IF_TRUE,
+            *dest, ast);
+  enum node_kind rhs_type = _expression(compiler, ast->as.binary.rhs, &rhs);
+  _move(compiler, *dest, rhs, ast);
+  compiler->free = *dest + 1;
+  _patch_jump(compiler, ast, skip);
+
+  struct type_rule rule = type_binary(ast->kind, lhs_type, rhs_type);
+  return _check(compiler, ast, &rule);
+}
+
+static enum node_kind _unary(struct reg_compiler *compiler, struct ast *ast,
+                             enum reg_opcode opcode, uint32_t *dest) {
+  uint32_t base = compiler->free;
+  uint32_t operand = 0;
+  struct type_rule rule =
+      type_unary(ast->kind, _expression(compiler, ast->as.expr, &operand));
+  compiler->free = base;
+  if (_check(compiler, ast, &rule) == TYPE_ERROR) {
+    return TYPE_ERROR;
+  }
+  *dest = _allocate(compiler, ast);
+  _write(compiler, REG_ENCODE(opcode, *dest, operand, 0), ast);
+  return rule.type;
+}
+
+// The operands of a typed binary instruction have the same kind, so the VM
+// picks the INTEGER or REAL form from the left one.
+static enum node_kind _binary(struct reg_compiler *compiler, struct ast *ast,
+                              enum reg_opcode opcode, uint32_t *dest) {
+  uint32_t base = compiler->free;
+  uint32_t lhs = 0, rhs = 0;
+  enum node_kind lhs_type = _expression(compiler, ast->as.binary.lhs, &lhs);
+  enum node_kind rhs_type = _expression(compiler, ast->as.binary.rhs, &rhs);
+  struct type_rule rule = type_binary(ast->kind, lhs_type, rhs_type);
+  if (_check(compiler, ast, &rule) == TYPE_ERROR) {
+    compiler->free = base;
+    return TYPE_ERROR;
+  }
+  if (rule.widen_lhs) {
+    lhs = _widen(compiler, ast, lhs);
+  }
+  if (rule.widen_rhs) {
+    rhs = _widen(compiler, ast, rhs);
+  }
+  compiler->free = base;
+  *dest = _allocate(compiler, ast);
+  _write(compiler, REG_ENCODE(opcode, *dest, lhs, rhs), ast);
+  return rule.type;
+}
+
+// Writes the code for an expression, stores the RK operand that holds its
+// value in `operand` and returns its type.
+static enum node_kind _expression(struct reg_compiler *compiler,
+                                  struct ast *ast, uint32_t *operand) {
+  switch (ast->kind) {
+  case NODE_KIND_BOOL:
+    *operand = _constant(compiler, VALUE_FROM_BOOL(ast->as.boolean), ast);
+    return NODE_KIND_BOOL;
+  case NODE_KIND_CHAR:
+    *operand = _constant(compiler, VALUE_FROM_CHAR(ast->as.cha), ast);
+    return NODE_KIND_CHAR;
+  case NODE_KIND_REAL:
+    *operand = _constant(compiler, VALUE_FROM_REAL(ast->as.real), ast);
+    return NODE_KIND_REAL;
+  case NODE_KIND_INTEGER:
+    *operand = _constant(
+        compiler, value_from_integer(compiler->objects, ast->as.integer), ast);
+    return NODE_KIND_INTEGER;
+  case NODE_KIND_STRING:
+    *operand = _constant(
+        compiler,
+        VALUE_FROM_OBJ(
+            (ast->as.string.in_arena ? obj_string_copy : obj_string_ref)(
+                compiler->objects, compiler->strings, ast->as.string.chars,
+                ast->as.string.length)),
+        ast);
+    return NODE_KIND_STRING;
+  case NODE_KIND_VARIABLE:
+    return _variable(compiler, ast, operand);
+  case NODE_KIND_GROUP:
+    return _expression(compiler, ast->as.expr, operand);
+  case NODE_KIND_NOT:
+    return _unary(compiler, ast, REG_OPCODE_NOT, operand);
+  case NODE_KIND_NEGATE:
+    return _unary(compiler, ast, REG_OPCODE_NEGATE, operand);
+  case NODE_KIND_ADD:
+    return _binary(compiler, ast, REG_OPCODE_ADD, operand);
+  case NODE_KIND_SUB:
+    return _binary(compiler, ast, REG_OPCODE_SUB, operand);
+  case NODE_KIND_MUL:
+    return _binary(compiler, ast, REG_OPCODE_MUL, operand);
+  case NODE_KIND_DIV:
+  case NODE_KIND_INT_DIV:
+    return _binary(compiler, ast, REG_OPCODE_DIV, operand);
+  case NODE_KIND_MOD:
+    return _binary(compiler, ast, REG_OPCODE_MOD, operand);
+  case NODE_KIND_AND:
+  case NODE_KIND_OR:
+    return _logical(compiler, ast, operand);
+  case NODE_KIND_CONCAT:
+    return _binary(compiler, ast, REG_OPCODE_CONCAT, operand);
+  case NODE_KIND_EQUAL:
+    return _binary(compiler, ast, REG_OPCODE_EQUAL, operand);
+  case NODE_KIND_NOT_EQUAL:
+    return _binary(compiler, ast, REG_OPCODE_NOT_EQUAL, operand);
+  case NODE_KIND_GREATER:
+    return _binary(compiler, ast, REG_OPCODE_GREATER, operand);
+  case NODE_KIND_GREATER_EQUAL:
+    return _binary(compiler, ast, REG_OPCODE_GREATER_EQUAL, operand);
+  case NODE_KIND_LESS:
+    return _binary(compiler, ast, REG_OPCODE_LESS, operand);
+  case NODE_KIND_LESS_EQUAL:
+    return _binary(compiler, ast, REG_OPCODE_LESS_EQUAL, operand);
+  case NODE_KIND_CALL:
+    return _call(compiler, ast, false, operand);
+  default:
+    _error(compiler, ast, "Unsupported expression.");
+    return TYPE_ERROR;
+  }
+}
+
+// Declares a DECLARE or CONSTANT of `type` holding `operand`: a local in the
+// next register inside a routine, a global in the main program.
+static void _define(struct reg_compiler *compiler, const struct ast *ast,
+                    enum node_kind type, uint32_t operand) {
+  bool is_constant = ast->kind == NODE_KIND_CONSTANT;
+  if (compiler->routine) {
+    _move(compiler, _declare_local(compiler, ast, type, is_constant), operand,
+          ast);
+    return;
+  }
+
+  int32_t slot = globals_declare(
+      compiler->globals, ast,
+      is_constant ? GLOBAL_KIND_CONSTANT : GLOBAL_KIND_VARIABLE, type);
+  if (slot < 0) {
+    compiler->had_error = true;
+    return;
+  }
+  _write(compiler, REG_ENCODE_BX(REG_OPCODE_SET_GLOBAL, operand, slot), ast);
+}
+
+static void _assign(struct reg_compiler *compiler, struct ast *ast) {
+  uint32_t operand = 0;
+  int32_t slot = _resolve_local(compiler, ast);
+  if (slot >= 0) {
+    if (compiler->locals[slot].is_constant) {
+      _error(compiler, ast, "Cannot assign to a constant.");
+      return;
+    }
+    enum node_kind type =
+        _expression(compiler, ast->as.variable.expr, &operand);
+    operand = _convert(compiler, ast, type, compiler->locals[slot].type,
+                       operand);
+    _move(compiler, (uint32_t)slot, operand, ast);
+    return;
+  }
+
+  slot = globals_resolve(*compiler->globals, ast);
+  enum global_kind kind =
+      slot >= 0 ? (*compiler->globals)->globals[slot].kind
+                : GLOBAL_KIND_VARIABLE;
+  if (slot < 0) {
+    _error(compiler, ast, "Undeclared variable.");
+  } else if (kind == GLOBAL_KIND_CONSTANT) {
+    _error(compiler, ast, "Cannot assign to a constant.");
+  } else if (kind != GLOBAL_KIND_VARIABLE) {
+    _error(compiler, ast, "Routines can only be called.");
+  } else {
+    enum node_kind type =
+        _expression(compiler, ast->as.variable.expr, &operand);
+    operand = _convert(compiler, ast, type,
+                       (*compiler->globals)->globals[slot].type, operand);
+    _write(compiler, REG_ENCODE_BX(REG_OPCODE_SET_GLOBAL, operand, slot),
+           ast);
+  }
+}
+
+static void _block(struct reg_compiler *compiler, struct ast *block);
+
+static void _if(struct reg_compiler *compiler, struct ast *ast) {
+  struct ast *condition = ast->as.branch.condition;
+  uint32_t operand = 0;
+  enum node_kind type = _expression(compiler, condition, &operand);
+  operand = _convert(compiler, condition, type, NODE_KIND_BOOL, operand);
+  compiler->free = compiler->local_count;
+  uint32_t skip = _jump(compiler, REG_OPCODE_JUMP_IF_FALSE, operand, ast);
+  _block(compiler, ast->as.branch.then);
+  if (!ast->as.branch.otherwise) {
+    _patch_jump(compiler, ast, skip);
+    return;
+  }
+  uint32_t end = _jump(compiler, REG_OPCODE_JUMP, 0, ast);
+  _patch_jump(compiler, ast, skip);
+  _block(compiler, ast->as.branch.otherwise);
+  _patch_jump(compiler, ast, end);
+}
+
+static void _statement(struct reg_compiler *compiler, struct ast *ast) {
+  uint32_t operand = 0;
+  switch (ast->kind) {
+  case NODE_KIND_DECLARE:
+    _define(compiler, ast, ast->as.variable.type,
+            _default(compiler, ast->as.variable.type, ast));
+    break;
+  case NODE_KIND_CONSTANT: {
+    enum node_kind type =
+        _expression(compiler, ast->as.variable.expr, &operand);
+    _define(compiler, ast, type, operand);
+    break;
+  }
+  case NODE_KIND_ASSIGN:
+    _assign(compiler, ast);
+    break;
+  case NODE_KIND_CALL_STMT:
+    _call(compiler, ast->as.expr, true, &operand);
+    break;
+  case NODE_KIND_IF:
+    _if(compiler, ast);
+    break;
+  case NODE_KIND_RETURN:
+    if (!compiler->routine) {
+      _error(compiler, ast, "Cannot RETURN from the main program.");
+    } else if (compiler->routine->kind == NODE_KIND_PROCEDURE) {
+      _error(compiler, ast, "Procedures cannot RETURN a value.");
+    } else {
+      enum node_kind type = _expression(compiler, ast->as.expr, &operand);
+      operand = _convert(compiler, ast, type,
+                         compiler->routine->as.variable.type, operand);
+      _write(compiler, REG_ENCODE(REG_OPCODE_RETURN, 0, operand, 0), ast);
+    }
+    break;
+  case NODE_KIND_FUNCTION:
+  case NODE_KIND_PROCEDURE:
+    _error(compiler, ast, "Routines must be declared at the top level.");
+    break;
+  default:
+    _expression(compiler, ast, &operand);
+    _write(compiler, REG_ENCODE(REG_OPCODE_PRINT, 0, operand, 0), ast);
+    break;
+  }
+  compiler->free = compiler->local_count;
+}
+
+static void _block(struct reg_compiler *compiler, struct ast *block) {
+  for (; block; block = block->as.list.next) {
+    _statement(compiler, block->as.list.item);
+  }
+}
+
+// Compiles a routine into `chunk`. Falling off the end returns the default
+// value of the return type.
+static void _routine(struct reg_compiler *compiler, struct ast *ast,
+                     reg_chunk_t *chunk) {
+  struct reg_compiler routine = {
+      .chunk = chunk,
+      .globals = compiler->globals,
+      .objects = compiler->objects,
+      .strings = compiler->strings,
+      .routine = ast,
+  };
+  (*chunk)->name = ast->as.variable.name;
+  (*chunk)->name_length = ast->as.variable.length;
+
+  struct ast *body = ast->as.variable.expr;
+  for (; body && body->as.list.item->kind == NODE_KIND_PARAMETER;
+       body = body->as.list.next) {
+    struct ast *parameter = body->as.list.item;
+    _declare_local(&routine, parameter, parameter->as.variable.type, false);
+  }
+  _block(&routine, body);
+  uint32_t result = _default(
+      &routine,
+      ast->kind == NODE_KIND_FUNCTION ? ast->as.variable.type : NODE_KIND_BOOL,
+      ast);
+  _write(&routine, REG_ENCODE(REG_OPCODE_RETURN, 0, result, 0), ast);
+  compiler->had_error |= routine.had_error;
+}
+
+// Compiles a program (a BLOCK list) and terminates it with REG_OPCODE_RETURN,
+// whose operand the main program ignores.
+// Routines are hoisted into a fresh globals map before anything else is
+// declared, so a routine's global slot is also its index in `routines`. The
+// register backend keeps no globals between programs.
+bool reg_chunk_write_from_ast(reg_chunk_t *chunk, struct ast *ast,
+                              obj_t *objects, table_t *strings) {
+  globals_t globals;
+  globals_init(&globals);
+  struct reg_compiler compiler = {
+      .chunk = chunk,
+      .globals = &globals,
+      .objects = objects,
+      .strings = strings,
+  };
+  struct location location = {1};
+
+  for (struct ast *block = ast; block; block = block->as.list.next) {
+    struct ast *item = block->as.list.item;
+    if (_is_routine(item) && globals_declare_routine(&globals, item) < 0) {
+      compiler.had_error = true;
+    }
+  }
+  if (globals->count) {
+    (*chunk)->routine_count = globals->count;
+    (*chunk)->routines =
+        reallocate(NULL, 0, globals->count * sizeof(reg_chunk_t));
+    for (uint32_t i = 0; i < globals->count; ++i) {
+      reg_chunk_init((*chunk)->routines + i);
+    }
+  }
+  for (struct ast *block = ast; block; block = block->as.list.next) {
+    struct ast *item = block->as.list.item;
+    if (!_is_routine(item)) {
+      continue;
+    }
+    // A routine declared twice was reported above; its body is not compiled.
+    int32_t slot = globals_resolve(globals, item);
+    if (slot < 0 || (*chunk)->routines[slot]->count) {
+      continue;
+    }
+    reg_chunk_t *routine = (*chunk)->routines + slot;
+    _routine(&compiler, item, routine);
+    if ((*chunk)->max_frame < (*routine)->registers) {
+      (*chunk)->max_frame = (*routine)->registers;
+    }
+  }
+  for (struct ast *block = ast; block; block = block->as.list.next) {
+    if (!_is_routine(block->as.list.item)) {
+      _statement(&compiler, block->as.list.item);
+    }
+    location = (struct location){block->line};
+  }
+  reg_chunk_write(chunk, REG_ENCODE(REG_OPCODE_RETURN, 0, 0, 0), location);
+  (*chunk)->globals = globals->count;
+
+  globals_free(&globals);
+  return !compiler.had_error;
+}
+
+#ifdef DEBUG_CHUNK
+
+static void _operand(reg_chunk_t chunk, uint32_t operand) {
+  if (REG_IS_CONSTANT(operand)) {
+    fputc('\'', stderr);
+    value_print(chunk->constants->values[REG_CONSTANT_INDEX(operand)]);
+    fputc('\'', stderr);
+  } else {
+    fprintf(stderr, "r%u", operand);
+  }
+}
+
+static uint32_t _unary_instruction(const char *name, reg_chunk_t chunk,
+                                   uint32_t instruction, uint32_t offset) {
+  fprintf(stderr, "%-16s r%u ", name, REG_A(instruction));
+  _operand(chunk, REG_B(instruction));
+  fputc('\n', stderr);
+  return offset + 1;
+}
+
+static uint32_t _binary_instruction(const char *name, reg_chunk_t chunk,
+                                    uint32_t instruction, uint32_t offset) {
+  fprintf(stderr, "%-16s r%u ", name, REG_A(instruction));
+  _operand(chunk, REG_B(instruction));
+  fputc(' ', stderr);
+  _operand(chunk, REG_C(instruction));
+  fputc('\n', stderr);
+  return offset + 1;
+}
+
+static uint32_t _global_instruction(const char *name, uint32_t instruction,
+                                    uint32_t offset) {
+  fprintf(stderr, "%-16s r%u %4u\n", name, REG_A(instruction),
+          REG_BX(instruction));
+  return offset + 1;
+}
+
+static uint32_t _jump_instruction(const char *name, reg_chunk_t chunk,
+                                  uint32_t instruction, uint32_t offset) {
+  fprintf(stderr, "%-16s ", name);
+  if (REG_OP(instruction) != REG_OPCODE_JUMP) {
+    _operand(chunk, REG_A(instruction));
+    fputc(' ', stderr);
+  }
+  fprintf(stderr, "%u -> %u\n", offset, offset + 1 + REG_BX(instruction));
+  return offset + 1;
+}
+
+static uint32_t _operand_instruction(const char *name, reg_chunk_t chunk,
+                                     uint32_t instruction, uint32_t offset) {
+  fprintf(stderr, "%-16s ", name);
+  _operand(chunk, REG_B(instruction));
+  fputc('\n', stderr);
+  return offset + 1;
+}
+
+uint32_t reg_chunk_disassemble_instruction(reg_chunk_t chunk, uint32_t offset) {
+  uint32_t start;
+  struct location location = debug_info_lookup(chunk->debug, offset, &start);
+
+  fprintf(stderr, "%04d ", offset);
+
+  if (start < offset) {
+    fputs("   |     ", stderr);
+  } else {
+    fprintf(stderr, "%4u:%-3u ", location.line, location.column);
+  }
+
+  uint32_t instruction = chunk->code[offset];
+  switch (REG_OP(instruction)) {
+  case REG_OPCODE_LOADK:
+    fprintf(stderr, "%-16s r%u %4u '", "OP_LOADK", REG_A(instruction),
+            REG_BX(instruction));
+    value_print(chunk->constants->values[REG_BX(instruction)]);
+    fputs("'\n", stderr);
+    return offset + 1;
+  case REG_OPCODE_MOVE:
+    return _unary_instruction("OP_MOVE", chunk, instruction, offset);
+  case REG_OPCODE_GET_GLOBAL:
+    return _global_instruction("OP_GET_GLOBAL", instruction, offset);
+  case REG_OPCODE_SET_GLOBAL:
+    fprintf(stderr, "%-16s ", "OP_SET_GLOBAL");
+    _operand(chunk, REG_A(instruction));
+    fprintf(stderr, " %4u\n", REG_BX(instruction));
+    return offset + 1;
+  case REG_OPCODE_ADD:
+    return _binary_instruction("OP_ADD", chunk, instruction, offset);
+  case REG_OPCODE_SUB:
+    return _binary_instruction("OP_SUB", chunk, instruction, offset);
+  case REG_OPCODE_MUL:
+    return _binary_instruction("OP_MUL", chunk, instruction, offset);
+  case REG_OPCODE_DIV:
+    return _binary_instruction("OP_DIV", chunk, instruction, offset);
+  case REG_OPCODE_MOD:
+    return _binary_instruction("OP_MOD", chunk, instruction, offset);
+  case REG_OPCODE_CONCAT:
+    return _binary_instruction("OP_CONCAT", chunk, instruction, offset);
+  case REG_OPCODE_TO_REAL:
+    return _unary_instruction("OP_TO_REAL", chunk, instruction, offset);
+  case REG_OPCODE_NEGATE:
+    return _unary_instruction("OP_NEGATE", chunk, instruction, offset);
+  case REG_OPCODE_NOT:
+    return _unary_instruction("OP_NOT", chunk, instruction, offset);
+  case REG_OPCODE_EQUAL:
+    return _binary_instruction("OP_EQUAL", chunk, instruction, offset);
+  case REG_OPCODE_NOT_EQUAL:
+    return _binary_instruction("OP_NOT_EQUAL", chunk, instruction, offset);
+  case REG_OPCODE_LESS:
+    return _binary_instruction("OP_LESS", chunk, instruction, offset);
+  case REG_OPCODE_LESS_EQUAL:
+    return _binary_instruction("OP_LESS_EQUAL", chunk, instruction, offset);
+  case REG_OPCODE_GREATER:
+    return _binary_instruction("OP_GREATER", chunk, instruction, offset);
+  case REG_OPCODE_GREATER_EQUAL:
+    return _binary_instruction("OP_GREATER_EQUAL", chunk, instruction, offset);
+  case REG_OPCODE_JUMP:
+    return _jump_instruction("OP_JUMP", chunk, instruction, offset);
+  case REG_OPCODE_JUMP_IF_FALSE:
+    return _jump_instruction("OP_JUMP_IF_FALSE", chunk, instruction, offset);
+  case REG_OPCODE_JUMP_IF_TRUE:
+    return _jump_instruction("OP_JUMP_IF_TRUE", chunk, instruction, offset);
+  case REG_OPCODE_CALL:
+    return _global_instruction("OP_CALL", instruction, offset);
+  case REG_OPCODE_PRINT:
+    return _operand_instruction("OP_PRINT", chunk, instruction, offset);
+  case REG_OPCODE_RETURN:
+    return _operand_instruction("OP_RETURN", chunk, instruction, offset);
+  default:
+    fprintf(stderr, "Unknown opcode %d\n", REG_OP(instruction));
+    return offset + 1;
+  }
+}
+
+void reg_chunk_disassemble(reg_chunk_t chunk, const char *name) {
+  fprintf(stderr, "== %s ==\n", name);
+  for (uint32_t offset = 0; offset < chunk->count;) {
+    offset = reg_chunk_disassemble_instruction(chunk, offset);
+  }
+  for (uint32_t i = 0; i < chunk->routine_count; ++i) {
+    reg_chunk_t routine = chunk->routines[i];
+    fprintf(stderr, "== %.*s ==\n", routine->name_length, routine->name);
+    for (uint32_t offset = 0; offset < routine->count;) {
+      offset = reg_chunk_disassemble_instruction(routine, offset);
+    }
+  }
+}
+#endif // DEBUG_CHUNK
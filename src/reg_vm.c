@@ -0,0 +1,303 @@
+#include "obj.h"
+#include "output.h"
+#include "reg_chunk.h"
+#include "value.h"
+#include "vm.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(VM_COMPUTED_GOTO) && !defined(__GNUC__)
+#undef VM_COMPUTED_GOTO
+#endif
+
+// The caller's state, saved by REG_OPCODE_CALL and restored by
+// REG_OPCODE_RETURN.
+struct reg_frame {
+  reg_chunk_t chunk;
+  const uint32_t *ip;
+  struct value *base;
+};
+
+// Reports an error at the instruction before `ip` in `chunk`, after the
+// output the program made before it.
+static void _runtime_error(struct vm *vm, const struct reg_chunk *chunk,
+                           const uint32_t *ip, const char *message) {
+  output_flush(&vm->output);
+  struct location location =
+      debug_info_lookup(chunk->debug, (uint32_t)(ip - chunk->code - 1), NULL);
+  fprintf(stderr, "[line %u:%u] Error: %s\n", location.line, location.column,
+          message);
+}
+
+// Raises the stack top to `top`, clearing the registers it takes in. The top
+// only rises during a run, so the collector also sees registers of frames
+// that have returned, all of which hold values that were live when written.
+static inline void _cover(struct vm *vm, struct value *top) {
+  for (struct value *slot = vm->stack->top; slot < top; ++slot) {
+    *slot = VALUE_FROM_BOOL(false);
+  }
+  if (vm->stack->top < top) {
+    vm->stack->top = top;
+  }
+}
+
+// The stack was reserved before entry for the program's registers and as
+// many frames as calls may nest, so `base` never moves.
+static enum interpret_result _run(struct vm *vm, const reg_chunk_t program,
+                                  struct value *base,
+                                  struct reg_frame *frames) {
+  reg_chunk_t chunk = program;
+  const uint32_t *ip = chunk->code;
+  const struct value *constants = chunk->constants->values;
+  struct value *globals = vm->globals->values;
+  uint32_t frame_count = 0;
+  uint32_t instruction;
+
+#define RK(operand)                                                            \
+  (REG_IS_CONSTANT(operand) ? constants[REG_CONSTANT_INDEX(operand)]           \
+                            : base[operand])
+#define RA() base[REG_A(instruction)]
+#define RKA() RK(REG_A(instruction))
+#define RKB() RK(REG_B(instruction))
+#define RKC() RK(REG_C(instruction))
+#define COMPARE_OP(op)                                                         \
+  do {                                                                         \
+    struct value a = RKB();                                                    \
+    struct value b = RKC();                                                    \
+    switch (VALUE_KIND(a)) {                                                   \
+    case VALUE_KIND_BOOL:                                                      \
+      RA() = VALUE_FROM_BOOL(VALUE_AS_BOOL(a) op VALUE_AS_BOOL(b));            \
+      break;                                                                   \
+    case VALUE_KIND_CHAR:                                                      \
+      RA() = VALUE_FROM_BOOL(VALUE_AS_CHAR(a) op VALUE_AS_CHAR(b));            \
+      break;                                                                   \
+    case VALUE_KIND_REAL:                                                      \
+      RA() = VALUE_FROM_BOOL(VALUE_AS_REAL(a) op VALUE_AS_REAL(b));            \
+      break;                                                                   \
+    case VALUE_KIND_INTEGER:                                                   \
+      RA() = VALUE_FROM_BOOL(VALUE_AS_INTEGER(a) op VALUE_AS_INTEGER(b));      \
+      break;                                                                   \
+    default:                                                                   \
+      break;                                                                   \
+    }                                                                          \
+  } while (false)
+#define NUMBER_BINARY_OP(op)                                                   \
+  do {                                                                         \
+    struct value a = RKB();                                                    \
+    struct value b = RKC();                                                    \
+    if (VALUE_KIND(a) == VALUE_KIND_REAL) {                                    \
+      RA() = VALUE_FROM_REAL(VALUE_AS_REAL(a) op VALUE_AS_REAL(b));            \
+    } else {                                                                   \
+      RA() = value_from_integer(&vm->objects,                                  \
+                                VALUE_AS_INTEGER(a) op VALUE_AS_INTEGER(b));   \
+    }                                                                          \
+  } while (false)
+// Integer division and remainder, which stop the program with an error on a
+// zero divisor or on INT64_MIN by -1, neither of which has a result.
+#define INT_DIVIDE_OP(op)                                                      \
+  do {                                                                         \
+    int64_t a = VALUE_AS_INTEGER(RKB());                                       \
+    int64_t b = VALUE_AS_INTEGER(RKC());                                       \
+    if (!b || (a == INT64_MIN && b == -1)) {                                   \
+      _runtime_error(vm, chunk, ip,                                            \
+                     b ? "Integer overflow." : "Division by zero.");           \
+      return INTERPRET_RESULT_RUNTIME_ERROR;                                   \
+    }                                                                          \
+    RA() = value_from_integer(&vm->objects, a op b);                           \
+  } while (false)
+#ifdef VM_COMPUTED_GOTO
+#define TARGET(opcode)                                                         \
+  case opcode:                                                                 \
+  label_##opcode
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    instruction = *ip++;                                                       \
+    goto *g_LABELS[REG_OP(instruction)];                                       \
+  } while (false)
+
+  static const void *const g_LABELS[UINT8_MAX + 1] = {
+      [0 ... UINT8_MAX] = &&label_unknown,
+      [REG_OPCODE_LOADK] = &&label_REG_OPCODE_LOADK,
+      [REG_OPCODE_MOVE] = &&label_REG_OPCODE_MOVE,
+      [REG_OPCODE_GET_GLOBAL] = &&label_REG_OPCODE_GET_GLOBAL,
+      [REG_OPCODE_SET_GLOBAL] = &&label_REG_OPCODE_SET_GLOBAL,
+      [REG_OPCODE_ADD] = &&label_REG_OPCODE_ADD,
+      [REG_OPCODE_SUB] = &&label_REG_OPCODE_SUB,
+      [REG_OPCODE_MUL] = &&label_REG_OPCODE_MUL,
+      [REG_OPCODE_DIV] = &&label_REG_OPCODE_DIV,
+      [REG_OPCODE_MOD] = &&label_REG_OPCODE_MOD,
+      [REG_OPCODE_CONCAT] = &&label_REG_OPCODE_CONCAT,
+      [REG_OPCODE_TO_REAL] = &&label_REG_OPCODE_TO_REAL,
+      [REG_OPCODE_NEGATE] = &&label_REG_OPCODE_NEGATE,
+      [REG_OPCODE_NOT] = &&label_REG_OPCODE_NOT,
+      [REG_OPCODE_EQUAL] = &&label_REG_OPCODE_EQUAL,
+      [REG_OPCODE_NOT_EQUAL] = &&label_REG_OPCODE_NOT_EQUAL,
+      [REG_OPCODE_LESS] = &&label_REG_OPCODE_LESS,
+      [REG_OPCODE_LESS_EQUAL] = &&label_REG_OPCODE_LESS_EQUAL,
+      [REG_OPCODE_GREATER] = &&label_REG_OPCODE_GREATER,
+      [REG_OPCODE_GREATER_EQUAL] = &&label_REG_OPCODE_GREATER_EQUAL,
+      [REG_OPCODE_JUMP] = &&label_REG_OPCODE_JUMP,
+      [REG_OPCODE_JUMP_IF_FALSE] = &&label_REG_OPCODE_JUMP_IF_FALSE,
+      [REG_OPCODE_JUMP_IF_TRUE] = &&label_REG_OPCODE_JUMP_IF_TRUE,
+      [REG_OPCODE_CALL] = &&label_REG_OPCODE_CALL,
+      [REG_OPCODE_PRINT] = &&label_REG_OPCODE_PRINT,
+      [REG_OPCODE_RETURN] = &&label_REG_OPCODE_RETURN,
+  };
+#else
+#define TARGET(opcode) case opcode
+#define DISPATCH() continue
+#endif
+  for (;;) {
+    switch (REG_OP(instruction = *ip++)) {
+    TARGET(REG_OPCODE_LOADK):
+      RA() = constants[REG_BX(instruction)];
+      DISPATCH();
+    TARGET(REG_OPCODE_MOVE):
+      RA() = RKB();
+      DISPATCH();
+    TARGET(REG_OPCODE_GET_GLOBAL):
+      RA() = globals[REG_BX(instruction)];
+      DISPATCH();
+    TARGET(REG_OPCODE_SET_GLOBAL):
+      globals[REG_BX(instruction)] = RKA();
+      DISPATCH();
+    TARGET(REG_OPCODE_ADD):
+      NUMBER_BINARY_OP(+);
+      DISPATCH();
+    TARGET(REG_OPCODE_SUB):
+      NUMBER_BINARY_OP(-);
+      DISPATCH();
+    TARGET(REG_OPCODE_MUL):
+      NUMBER_BINARY_OP(*);
+      DISPATCH();
+    TARGET(REG_OPCODE_DIV):
+      if (VALUE_KIND(RKB()) == VALUE_KIND_INTEGER) {
+        INT_DIVIDE_OP(/);
+      } else {
+        RA() = VALUE_FROM_REAL(VALUE_AS_REAL(RKB()) / VALUE_AS_REAL(RKC()));
+      }
+      DISPATCH();
+    TARGET(REG_OPCODE_MOD):
+      INT_DIVIDE_OP(%);
+      DISPATCH();
+    TARGET(REG_OPCODE_CONCAT):
+      RA() = VALUE_FROM_OBJ(
+          vm_concat(vm, VALUE_AS_OBJ(RKB()), VALUE_AS_OBJ(RKC())));
+      DISPATCH();
+    TARGET(REG_OPCODE_TO_REAL):
+      RA() = VALUE_FROM_REAL((double)VALUE_AS_INTEGER(RKB()));
+      DISPATCH();
+    TARGET(REG_OPCODE_NEGATE):
+      if (VALUE_KIND(RKB()) == VALUE_KIND_REAL) {
+        RA() = VALUE_FROM_REAL(-VALUE_AS_REAL(RKB()));
+      } else {
+        RA() = value_from_integer(&vm->objects, -VALUE_AS_INTEGER(RKB()));
+      }
+      DISPATCH();
+    TARGET(REG_OPCODE_NOT):
+      RA() = VALUE_FROM_BOOL(!VALUE_AS_BOOL(RKB()));
+      DISPATCH();
+    TARGET(REG_OPCODE_EQUAL):
+      RA() = VALUE_FROM_BOOL(value_is_equal(RKB(), RKC()));
+      DISPATCH();
+    TARGET(REG_OPCODE_NOT_EQUAL):
+      RA() = VALUE_FROM_BOOL(!value_is_equal(RKB(), RKC()));
+      DISPATCH();
+    TARGET(REG_OPCODE_LESS):
+      COMPARE_OP(<);
+      DISPATCH();
+    TARGET(REG_OPCODE_LESS_EQUAL):
+      COMPARE_OP(<=);
+      DISPATCH();
+    TARGET(REG_OPCODE_GREATER):
+      COMPARE_OP(>);
+      DISPATCH();
+    TARGET(REG_OPCODE_GREATER_EQUAL):
+      COMPARE_OP(>=);
+      DISPATCH();
+    TARGET(REG_OPCODE_JUMP):
+      ip += REG_BX(instruction);
+      DISPATCH();
+    TARGET(REG_OPCODE_JUMP_IF_FALSE):
+      if (!VALUE_AS_BOOL(RKA())) {
+        ip += REG_BX(instruction);
+      }
+      DISPATCH();
+    TARGET(REG_OPCODE_JUMP_IF_TRUE):
+      if (VALUE_AS_BOOL(RKA())) {
+        ip += REG_BX(instruction);
+      }
+      DISPATCH();
+    TARGET(REG_OPCODE_CALL):
+      if (frame_count >= VM_FRAMES_MAX) {
+        _runtime_error(vm, chunk, ip, "Stack overflow.");
+        return INTERPRET_RESULT_RUNTIME_ERROR;
+      }
+      frames[frame_count++] = (struct reg_frame){chunk, ip, base};
+      base += REG_A(instruction);
+      chunk = program->routines[REG_BX(instruction)];
+      ip = chunk->code;
+      constants = chunk->constants->values;
+      _cover(vm, base + chunk->registers);
+      DISPATCH();
+    TARGET(REG_OPCODE_PRINT):
+      output_write_value(&vm->output, RKB());
+      output_write_char(&vm->output, '\n');
+      DISPATCH();
+    TARGET(REG_OPCODE_RETURN): {
+      if (!frame_count) {
+        return INTERPRET_RESULT_OK;
+      }
+      *base = RKB();
+      const struct reg_frame *frame = frames + --frame_count;
+      chunk = frame->chunk;
+      ip = frame->ip;
+      base = frame->base;
+      constants = chunk->constants->values;
+      DISPATCH();
+    }
+    default:
+#ifdef VM_COMPUTED_GOTO
+    label_unknown:
+#endif
+      _runtime_error(vm, chunk, ip, "Unknown opcode.");
+      return INTERPRET_RESULT_RUNTIME_ERROR;
+    }
+  }
+#undef RK
+#undef RA
+#undef RKA
+#undef RKB
+#undef RKC
+#undef COMPARE_OP
+#undef NUMBER_BINARY_OP
+#undef INT_DIVIDE_OP
+#undef TARGET
+#undef DISPATCH
+}
+
+enum interpret_result vm_interpret_registers(struct vm *vm,
+                                             const reg_chunk_t chunk) {
+  struct reg_frame *frames = malloc(VM_FRAMES_MAX * sizeof(struct reg_frame));
+  if (!frames) {
+    fputs("Out of memory.\n", stderr);
+    return INTERPRET_RESULT_RUNTIME_ERROR;
+  }
+  vm->reg_chunk = chunk;
+  while (vm->globals->count < chunk->globals) {
+    value_array_write(&vm->globals, VALUE_FROM_BOOL(false));
+  }
+  stack_reserve(&vm->stack,
+                chunk->registers + VM_FRAMES_MAX * chunk->max_frame);
+  struct value *base = vm->stack->top;
+  _cover(vm, base + chunk->registers);
+
+  enum interpret_result result = _run(vm, chunk, base, frames);
+  output_flush(&vm->output);
+
+  vm->reg_chunk = NULL;
+  vm->stack->top = base;
+  free(frames);
+  return result;
+}
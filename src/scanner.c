@@ -1,7 +1,13 @@
 #include "scanner.h"
+#include "keyword_hash.h"
+#include "scanner_kernels.h"
 #include <ctype.h>
 #include <stdint.h>
 #include <string.h>
+#include <threads.h>
+
+static const struct scanner_kernels *g_kernels = NULL;
+static once_flag g_kernels_once = ONCE_FLAG_INIT;
 
 static inline bool _is_at_end(struct scanner scanner) {
   return *scanner.current == 0;
@@ -13,6 +19,7 @@ static struct token _make_token(struct scanner scanner, enum token_kind kind) {
   token.start = scanner.start;
   token.length = (uint32_t)(scanner.current - scanner.start);
   token.line = scanner.line;
+  token.column = (uint32_t)(scanner.start - scanner.line_start) + 1;
   return token;
 }
 
@@ -22,6 +29,7 @@ static struct token _error_token(struct scanner scanner, const char *message) {
   token.start = message;
   token.length = (int32_t)strlen(message);
   token.line = scanner.line;
+  token.column = (uint32_t)(scanner.start - scanner.line_start) + 1;
   return token;
 }
 
@@ -54,13 +62,11 @@ static void _skip_whitespace(struct scanner *scanner) {
     case ' ':
     case '\r':
     case '\t':
-      _advance(scanner);
+      scanner->current = g_kernels->skip_blank(scanner->current + 1);
       break;
     case '/':
       if (_peek_next(*scanner) == '/') {
-        while (_peek(*scanner) != '\n' && !_is_at_end(*scanner)) {
-          _advance(scanner);
-        }
+        scanner->current = g_kernels->skip_line(scanner->current + 2);
       } else {
         return;
       }
@@ -72,10 +78,13 @@ static void _skip_whitespace(struct scanner *scanner) {
 }
 
 static struct token _make_string(struct scanner *scanner) {
-  while (_peek(*scanner) != '"' && !_is_at_end(*scanner)) {
-    if (_peek(*scanner) == '\n')
-      ++scanner->line;
-    _advance(scanner);
+  uint32_t line = scanner->line;
+  scanner->current = g_kernels->skip_string(scanner->current, &scanner->line);
+  if (scanner->line != line) {
+    scanner->line_start = scanner->current;
+    while (scanner->line_start[-1] != '\n') {
+      --scanner->line_start;
+    }
   }
 
   if (_is_at_end(*scanner)) {
@@ -88,8 +97,10 @@ static struct token _make_string(struct scanner *scanner) {
 
 static struct token make_char(struct scanner *scanner) {
   while (_peek(*scanner) != '\'' && !_is_at_end(*scanner)) {
-    if (_peek(*scanner) == '\n')
+    if (_peek(*scanner) == '\n') {
       ++scanner->line;
+      scanner->line_start = scanner->current + 1;
+    }
     _advance(scanner);
   }
 
@@ -110,347 +121,25 @@ static struct token make_char(struct scanner *scanner) {
 }
 
 static struct token _make_number(struct scanner *scanner) {
-  while (isdigit(_peek(*scanner))) {
-    _advance(scanner);
-  }
+  scanner->current = g_kernels->skip_digits(scanner->current);
 
   bool is_real = false;
   if (_peek(*scanner) == '.' && isdigit(_peek_next(*scanner))) {
     is_real = true;
-    _advance(scanner);
-    while (isdigit(_peek(*scanner))) {
-      _advance(scanner);
-    }
+    scanner->current = g_kernels->skip_digits(scanner->current + 1);
   }
 
   return is_real ? _make_token(*scanner, TOKEN_KIND_LT_REAL)
                  : _make_token(*scanner, TOKEN_KIND_LT_INTEGER);
 }
 
-static enum token_kind _check_keyword(struct scanner scanner, uint32_t start,
-                                      uint32_t length, const char *rest,
-                                      enum token_kind kind) {
-  return scanner.current - scanner.start == start + length &&
-                 !memcmp(scanner.start + start, rest, length)
-             ? kind
-             : TOKEN_KIND_SP_IDENT;
-}
-
 static enum token_kind _make_identifier_kind(struct scanner scanner) {
-  const uint16_t length = scanner.current - scanner.start;
-
-  switch (scanner.start[0]) {
-  case 'A':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'N':
-        return _check_keyword(scanner, 2, 1, "D", TOKEN_KIND_KW_AND);
-      case 'P':
-        return _check_keyword(scanner, 2, 4, "PEND", TOKEN_KIND_KW_APPEND);
-      case 'R':
-        return _check_keyword(scanner, 2, 3, "RAY", TOKEN_KIND_KW_ARRAY);
-      }
-    }
-    break;
-  case 'B':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'O':
-        return _check_keyword(scanner, 2, 5, "OLEAN", TOKEN_KIND_KW_BOOLEAN);
-      case 'Y':
-        if (length > 2) {
-          switch (scanner.start[2]) {
-          case 'V':
-            return _check_keyword(scanner, 3, 2, "AL", TOKEN_KIND_KW_BYVAL);
-          case 'R':
-            return _check_keyword(scanner, 3, 2, "EF", TOKEN_KIND_KW_BYREF);
-          }
-        }
-      }
-    }
-    break;
-  case 'C':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'A':
-        if (length > 2) {
-          switch (scanner.start[2]) {
-          case 'L':
-            return _check_keyword(scanner, 3, 1, "L", TOKEN_KIND_KW_CALL);
-          case 'S':
-            return _check_keyword(scanner, 3, 1, "E", TOKEN_KIND_KW_CASE);
-          }
-        }
-        break;
-      case 'H':
-        return _check_keyword(scanner, 2, 2, "AR", TOKEN_KIND_KW_CHAR);
-      case 'L':
-        if (length > 1) {
-          switch (scanner.start[2]) {
-          case 'A':
-            return _check_keyword(scanner, 3, 2, "SS", TOKEN_KIND_KW_CLASS);
-          case 'O':
-            return _check_keyword(scanner, 3, 6, "SEFILE",
-                                  TOKEN_KIND_KW_CLOSEFILE);
-          }
-        }
-        break;
-      case 'O':
-        return _check_keyword(scanner, 2, 6, "NSTANT", TOKEN_KIND_KW_CONSTANT);
-      }
-    }
-    break;
-  case 'D':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'A':
-        return _check_keyword(scanner, 2, 2, "TE", TOKEN_KIND_KW_DATE);
-      case 'E':
-        if (length > 2) {
-          switch (scanner.start[2]) {
-          case 'C':
-            return _check_keyword(scanner, 3, 4, "LARE", TOKEN_KIND_KW_DECLARE);
-          case 'F':
-            return _check_keyword(scanner, 3, 3, "INE", TOKEN_KIND_KW_DEFINE);
-          }
-        }
-        break;
-      case 'I':
-        return _check_keyword(scanner, 2, 1, "V", TOKEN_KIND_KW_DIV);
-      }
-    }
-    break;
-  case 'E':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'L':
-        return _check_keyword(scanner, 2, 2, "SE", TOKEN_KIND_KW_ELSE);
-      case 'N':
-        if (length > 3 && scanner.start[2] == 'D') {
-          switch (scanner.start[3]) {
-          case 'C':
-            if (length > 4) {
-              switch (scanner.start[4]) {
-              case 'A':
-                return _check_keyword(scanner, 5, 2, "SE",
-                                      TOKEN_KIND_KW_ENDCASE);
-              case 'L':
-                return _check_keyword(scanner, 5, 3, "ASS",
-                                      TOKEN_KIND_KW_ENDCLASS);
-              }
-            }
-            break;
-          case 'F':
-            return _check_keyword(scanner, 4, 7, "UNCTION",
-                                  TOKEN_KIND_KW_ENDFUNCTION);
-          case 'I':
-            return _check_keyword(scanner, 4, 1, "F", TOKEN_KIND_KW_ENDIF);
-          case 'P':
-            return _check_keyword(scanner, 4, 8, "ROCEDURE",
-                                  TOKEN_KIND_KW_ENDPROCEDURE);
-          case 'T':
-            return _check_keyword(scanner, 4, 3, "YPE", TOKEN_KIND_KW_ENDTYPE);
-          case 'W':
-            return _check_keyword(scanner, 4, 4, "HILE",
-                                  TOKEN_KIND_KW_ENDWHILE);
-          }
-        }
-      }
-    }
-    break;
-  case 'F':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'A':
-        return _check_keyword(scanner, 2, 3, "LSE", TOKEN_KIND_LT_FALSE);
-      case 'O':
-        return _check_keyword(scanner, 2, 1, "R", TOKEN_KIND_KW_FOR);
-      case 'U':
-        return _check_keyword(scanner, 2, 6, "NCTION", TOKEN_KIND_KW_FUNCTION);
-      }
-    }
-    break;
-  case 'G':
-    return _check_keyword(scanner, 1, 8, "ETRECORD", TOKEN_KIND_KW_GETRECORD);
-  case 'I':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'F':
-        return TOKEN_KIND_KW_IF;
-      case 'N':
-        if (length > 2) {
-          switch (scanner.start[2]) {
-          case 'H':
-            return _check_keyword(scanner, 3, 5, "ERITS",
-                                  TOKEN_KIND_KW_INHERITS);
-          case 'P':
-            return _check_keyword(scanner, 3, 2, "UT", TOKEN_KIND_KW_INPUT);
-          case 'T':
-            return _check_keyword(scanner, 3, 4, "EGER", TOKEN_KIND_KW_INTEGER);
-          }
-        }
-      }
-    }
-    break;
-  case 'M':
-    return _check_keyword(scanner, 1, 2, "OD", TOKEN_KIND_KW_MOD);
-  case 'N':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'E':
-        if (length > 2) {
-          switch (scanner.start[2]) {
-          case 'X':
-            return _check_keyword(scanner, 3, 1, "T", TOKEN_KIND_KW_NEXT);
-          case 'W':
-            return TOKEN_KIND_KW_NEW;
-          }
-        }
-      case 'O':
-        return _check_keyword(scanner, 2, 1, "T", TOKEN_KIND_KW_NOT);
-      }
-    }
-    break;
-  case 'O':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'P':
-        return _check_keyword(scanner, 2, 6, "ENFILE", TOKEN_KIND_KW_OPENFILE);
-      case 'R':
-        return TOKEN_KIND_KW_OR;
-      case 'T':
-        return _check_keyword(scanner, 2, 7, "HERWISE",
-                              TOKEN_KIND_KW_OTHERWISE);
-      case 'U':
-        return _check_keyword(scanner, 2, 4, "TPUT", TOKEN_KIND_KW_OUTPUT);
-      }
-    }
-    break;
-  case 'P':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'R':
-        if (length > 2) {
-          switch (scanner.start[2]) {
-          case 'O':
-            return _check_keyword(scanner, 3, 6, "CEDURE",
-                                  TOKEN_KIND_KW_PROCEDURE);
-          case 'I':
-            return _check_keyword(scanner, 3, 4, "VATE", TOKEN_KIND_KW_PRIVATE);
-          }
-          break;
-        }
-      case 'U':
-        if (length > 2) {
-          switch (scanner.start[2]) {
-          case 'B':
-            return _check_keyword(scanner, 3, 3, "LIC", TOKEN_KIND_KW_PUBLIC);
-          case 'T':
-            return _check_keyword(scanner, 3, 6, "RECORD",
-                                  TOKEN_KIND_KW_PUTRECORD);
-          }
-          break;
-        }
-      }
-    }
-    break;
-  case 'R':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'A':
-        return _check_keyword(scanner, 2, 4, "NDOM", TOKEN_KIND_KW_RANDOM);
-      case 'E':
-        if (length > 2) {
-          switch (scanner.start[2]) {
-          case 'A':
-            if (length > 3) {
-              switch (scanner.start[3]) {
-              case 'D':
-                if (length > 4) {
-                  return _check_keyword(scanner, 4, 4, "FILE",
-                                        TOKEN_KIND_KW_READFILE);
-                }
-                return _check_keyword(scanner, 4, 0, "", TOKEN_KIND_KW_READ);
-              case 'L':
-                return _check_keyword(scanner, 4, 0, "", TOKEN_KIND_KW_REAL);
-                break;
-              }
-            }
-            break;
-          case 'P':
-            return _check_keyword(scanner, 3, 3, "EAT", TOKEN_KIND_KW_REPEAT);
-          case 'T':
-            if (length == 6) {
-              return _check_keyword(scanner, 3, 3, "URN", TOKEN_KIND_KW_RETURN);
-            }
-            if (length > 6) {
-              return _check_keyword(scanner, 3, 4, "URNS",
-                                    TOKEN_KIND_KW_RETURNS);
-            }
-          }
-        }
-        break;
-      }
-    }
-    break;
-  case 'S':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'E':
-        return _check_keyword(scanner, 2, 2, "EK", TOKEN_KIND_KW_SEEK);
-      case 'T':
-        if (length > 2) {
-          switch (scanner.start[2]) {
-          case 'E':
-            return _check_keyword(scanner, 3, 1, "P", TOKEN_KIND_KW_STEP);
-          case 'R':
-            return _check_keyword(scanner, 3, 3, "ING", TOKEN_KIND_KW_STRING);
-          }
-        }
-        break;
-      case 'U':
-        return _check_keyword(scanner, 2, 3, "PER", TOKEN_KIND_KW_SUPER);
-      }
-    }
-    break;
-  case 'T':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'H':
-        return _check_keyword(scanner, 2, 2, "EN", TOKEN_KIND_KW_THEN);
-      case 'R':
-        return _check_keyword(scanner, 2, 2, "UE", TOKEN_KIND_LT_TRUE);
-      case 'Y':
-        return _check_keyword(scanner, 2, 2, "PE", TOKEN_KIND_KW_TYPE);
-      }
-    }
-    break;
-  case 'U':
-    return _check_keyword(scanner, 1, 4, "NTIL", TOKEN_KIND_KW_UNTIL);
-  case 'W':
-    if (length > 1) {
-      switch (scanner.start[1]) {
-      case 'H':
-        return _check_keyword(scanner, 2, 3, "ILE", TOKEN_KIND_KW_WHILE);
-      case 'R':
-        if (length == 5) {
-          return _check_keyword(scanner, 2, 3, "ITE", TOKEN_KIND_KW_WRITE);
-        }
-        if (length > 5) {
-          return _check_keyword(scanner, 2, 7, "ITEFILE",
-                                TOKEN_KIND_KW_WRITEFILE);
-        }
-      }
-    }
-    break;
-  }
-  return TOKEN_KIND_SP_IDENT;
+  return scanner_keyword_kind(scanner.start,
+                              (uint32_t)(scanner.current - scanner.start));
 }
 
 static struct token _make_identifier(struct scanner *scanner) {
-  while (isalnum(_peek(*scanner)) || _peek(*scanner) == '_') {
-    _advance(scanner);
-  }
+  scanner->current = g_kernels->skip_identifier(scanner->current);
   return _make_token(*scanner, _make_identifier_kind(*scanner));
 }
 
@@ -474,9 +163,12 @@ struct token scanner_scan_token(struct scanner *scanner) {
   }
 
   switch (c) {
-  case '\n':
+  case '\n': {
+    struct token token = _make_token(*scanner, TOKEN_KIND_SP_EOL);
     ++scanner->line;
-    return _make_token(*scanner, TOKEN_KIND_SP_EOL);
+    scanner->line_start = scanner->current;
+    return token;
+  }
   case '-':
     return _make_token(*scanner, TOKEN_KIND_OP_SUBTRACTION);
   case '*':
@@ -530,6 +222,38 @@ struct token scanner_scan_token(struct scanner *scanner) {
   return _error_token(*scanner, "Unexpected character.");
 }
 
+// Runs once even when modules start scanning on several threads at once.
+static void _select_kernels(void) {
+  if (!g_kernels) {
+    g_kernels = scanner_kernels_get(scanner_kernels_best());
+  }
+}
+
 void scanner_init(struct scanner *scanner, const char *source) {
-  *scanner = (struct scanner){.start = source, .current = source, .line = 1};
+  call_once(&g_kernels_once, _select_kernels);
+  *scanner = (struct scanner){
+      .start = source, .current = source, .line_start = source, .line = 1};
+}
+
+bool scanner_use_isa(enum scanner_isa isa) {
+  const struct scanner_kernels *kernels = scanner_kernels_get(isa);
+  if (!kernels) {
+    return false;
+  }
+  g_kernels = kernels;
+  return true;
+}
+
+enum token_kind scanner_keyword_kind(const char *start, uint32_t length) {
+  if (length < KEYWORD_LENGTH_MIN || length > KEYWORD_LENGTH_MAX) {
+    return TOKEN_KIND_SP_IDENT;
+  }
+  const struct keyword *keyword = g_KEYWORDS + keyword_hash(start, length);
+  if (keyword->length != length) {
+    return TOKEN_KIND_SP_IDENT;
+  }
+  char word[KEYWORD_WIDTH] = {0};
+  memcpy(word, start, length);
+  return memcmp(word, keyword->text, KEYWORD_WIDTH) ? TOKEN_KIND_SP_IDENT
+                                                    : keyword->kind;
 }
@@ -0,0 +1,246 @@
+#include "scanner_kernels.h"
+#include "scanner.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(SCANNER_SIMD) && defined(__GNUC__) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+#define SCANNER_X86
+#include <immintrin.h>
+#endif
+
+enum scan_class : uint8_t {
+  SCAN_CLASS_BLANK,
+  SCAN_CLASS_LINE,
+  SCAN_CLASS_DIGIT,
+  SCAN_CLASS_IDENTIFIER,
+  SCAN_CLASS_STRING,
+};
+
+static inline bool _is_digit(char c) { return (uint8_t)(c - '0') < 10; }
+
+static inline bool _is_identifier(char c) {
+  return _is_digit(c) || (uint8_t)((c | 0x20) - 'a') < 26 || c == '_';
+}
+
+static const char *_skip_blank_scalar(const char *current) {
+  while (*current == ' ' || *current == '\t' || *current == '\r') {
+    ++current;
+  }
+  return current;
+}
+
+static const char *_skip_line_scalar(const char *current) {
+  while (*current != '\n' && *current) {
+    ++current;
+  }
+  return current;
+}
+
+static const char *_skip_digits_scalar(const char *current) {
+  while (_is_digit(*current)) {
+    ++current;
+  }
+  return current;
+}
+
+static const char *_skip_identifier_scalar(const char *current) {
+  while (_is_identifier(*current)) {
+    ++current;
+  }
+  return current;
+}
+
+static const char *_skip_string_scalar(const char *current, uint32_t *lines) {
+  while (*current != '"' && *current) {
+    *lines += *current == '\n';
+    ++current;
+  }
+  return current;
+}
+
+static const struct scanner_kernels g_KERNELS_SCALAR = {
+    _skip_blank_scalar,      _skip_line_scalar,   _skip_digits_scalar,
+    _skip_identifier_scalar, _skip_string_scalar,
+};
+
+#ifdef SCANNER_X86
+
+#define SCAN_KERNELS(isa, ISA, target)                                         \
+  target static const char *_skip_blank_##isa(const char *current) {           \
+    return _scan_##isa(current, SCAN_CLASS_BLANK, NULL);                       \
+  }                                                                            \
+  target static const char *_skip_line_##isa(const char *current) {            \
+    return _scan_##isa(current, SCAN_CLASS_LINE, NULL);                        \
+  }                                                                            \
+  target static const char *_skip_digits_##isa(const char *current) {          \
+    return _scan_##isa(current, SCAN_CLASS_DIGIT, NULL);                       \
+  }                                                                            \
+  target static const char *_skip_identifier_##isa(const char *current) {      \
+    return _scan_##isa(current, SCAN_CLASS_IDENTIFIER, NULL);                  \
+  }                                                                            \
+  target static const char *_skip_string_##isa(const char *current,            \
+                                               uint32_t *lines) {              \
+    return _scan_##isa(current, SCAN_CLASS_STRING, lines);                     \
+  }                                                                            \
+  static const struct scanner_kernels g_KERNELS_##ISA = {                      \
+      _skip_blank_##isa,      _skip_line_##isa,   _skip_digits_##isa,          \
+      _skip_identifier_##isa, _skip_string_##isa,                              \
+  }
+
+#define TARGET_SSE2 __attribute__((target("sse2"), always_inline)) static inline
+
+TARGET_SSE2 __m128i _in_range_sse2(__m128i chunk, char low, char high) {
+  __m128i lo = _mm_cmpeq_epi8(_mm_max_epu8(chunk, _mm_set1_epi8(low)), chunk);
+  __m128i hi = _mm_cmpeq_epi8(_mm_min_epu8(chunk, _mm_set1_epi8(high)), chunk);
+  return _mm_and_si128(lo, hi);
+}
+
+TARGET_SSE2 uint32_t _stop_sse2(__m128i chunk, enum scan_class class) {
+  __m128i in;
+  switch (class) {
+  case SCAN_CLASS_BLANK:
+    in = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+        _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+    return ~_mm_movemask_epi8(in) & 0xFFFF;
+  case SCAN_CLASS_DIGIT:
+    return ~_mm_movemask_epi8(_in_range_sse2(chunk, '0', '9')) & 0xFFFF;
+  case SCAN_CLASS_IDENTIFIER:
+    in = _mm_or_si128(
+        _mm_or_si128(_in_range_sse2(chunk, '0', '9'),
+                     _in_range_sse2(
+                         _mm_or_si128(chunk, _mm_set1_epi8(0x20)), 'a', 'z')),
+        _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')));
+    return ~_mm_movemask_epi8(in) & 0xFFFF;
+  case SCAN_CLASS_LINE:
+    return _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(chunk, _mm_setzero_si128())));
+  case SCAN_CLASS_STRING:
+    return _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')),
+                     _mm_cmpeq_epi8(chunk, _mm_setzero_si128())));
+  }
+  return 0;
+}
+
+TARGET_SSE2 const char *_scan_sse2(const char *current, enum scan_class class,
+                            uint32_t *lines) {
+  uintptr_t offset = (uintptr_t)current & 15;
+  const char *block = current - offset;
+  uint32_t skip = ~((1U << offset) - 1);
+  for (;; block += 16, skip = ~0U) {
+    __m128i chunk = _mm_load_si128((const __m128i *)block);
+    uint32_t stop = _stop_sse2(chunk, class) & skip;
+    if (class == SCAN_CLASS_STRING) {
+      uint32_t newlines =
+          _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))) & skip;
+      if (stop) {
+        newlines &= (stop & -stop) - 1;
+      }
+      *lines += __builtin_popcount(newlines);
+    }
+    if (stop) {
+      return block + __builtin_ctz(stop);
+    }
+  }
+}
+
+SCAN_KERNELS(sse2, SSE2, __attribute__((target("sse2"))));
+
+#define TARGET_AVX2 __attribute__((target("avx2"), always_inline)) static inline
+
+TARGET_AVX2 __m256i _in_range_avx2(__m256i chunk, char low, char high) {
+  __m256i lo =
+      _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, _mm256_set1_epi8(low)), chunk);
+  __m256i hi =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, _mm256_set1_epi8(high)), chunk);
+  return _mm256_and_si256(lo, hi);
+}
+
+TARGET_AVX2 uint32_t _stop_avx2(__m256i chunk, enum scan_class class) {
+  __m256i in;
+  switch (class) {
+  case SCAN_CLASS_BLANK:
+    in = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')));
+    return ~(uint32_t)_mm256_movemask_epi8(in);
+  case SCAN_CLASS_DIGIT:
+    return ~(uint32_t)_mm256_movemask_epi8(_in_range_avx2(chunk, '0', '9'));
+  case SCAN_CLASS_IDENTIFIER:
+    in = _mm256_or_si256(
+        _mm256_or_si256(
+            _in_range_avx2(chunk, '0', '9'),
+            _in_range_avx2(_mm256_or_si256(chunk, _mm256_set1_epi8(0x20)), 'a',
+                           'z')),
+        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_')));
+    return ~(uint32_t)_mm256_movemask_epi8(in);
+  case SCAN_CLASS_LINE:
+    return _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')),
+                        _mm256_cmpeq_epi8(chunk, _mm256_setzero_si256())));
+  case SCAN_CLASS_STRING:
+    return _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')),
+                        _mm256_cmpeq_epi8(chunk, _mm256_setzero_si256())));
+  }
+  return 0;
+}
+
+TARGET_AVX2 const char *_scan_avx2(const char *current, enum scan_class class,
+                            uint32_t *lines) {
+  uintptr_t offset = (uintptr_t)current & 31;
+  const char *block = current - offset;
+  uint32_t skip = ~(uint32_t)((1ULL << offset) - 1);
+  for (;; block += 32, skip = ~0U) {
+    __m256i chunk = _mm256_load_si256((const __m256i *)block);
+    uint32_t stop = _stop_avx2(chunk, class) & skip;
+    if (class == SCAN_CLASS_STRING) {
+      uint32_t newlines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                              chunk, _mm256_set1_epi8('\n'))) &
+                          skip;
+      if (stop) {
+        newlines &= (stop & -stop) - 1;
+      }
+      *lines += __builtin_popcount(newlines);
+    }
+    if (stop) {
+      return block + __builtin_ctz(stop);
+    }
+  }
+}
+
+SCAN_KERNELS(avx2, AVX2, __attribute__((target("avx2"))));
+
+#endif
+
+const struct scanner_kernels *scanner_kernels_get(enum scanner_isa isa) {
+  switch (isa) {
+  case SCANNER_ISA_SCALAR:
+    return &g_KERNELS_SCALAR;
+#ifdef SCANNER_X86
+  case SCANNER_ISA_SSE2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2") ? &g_KERNELS_SSE2 : NULL;
+  case SCANNER_ISA_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? &g_KERNELS_AVX2 : NULL;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+enum scanner_isa scanner_kernels_best(void) {
+  for (enum scanner_isa isa = SCANNER_ISA_AVX2; isa > SCANNER_ISA_SCALAR;
+       --isa) {
+    if (scanner_kernels_get(isa)) {
+      return isa;
+    }
+  }
+  return SCANNER_ISA_SCALAR;
+}
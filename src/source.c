@@ -0,0 +1,119 @@
+#include "source.h"
+#include "memory.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CAPACITY_INIT 4096U
+#define CAPACITY_MULT 2U
+
+static source_t _link(struct source_manager *manager, const char *chars,
+                      size_t length, size_t size, bool is_mapped) {
+  source_t source = MEM_ALLOC(sizeof(struct source));
+  source->next = manager->sources;
+  source->chars = chars;
+  source->length = length;
+  source->size = size;
+  source->is_mapped = is_mapped;
+  manager->sources = source;
+  return source;
+}
+
+static const struct source *_map(struct source_manager *manager, int fd,
+                                 size_t length) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t size = (length / page + 1) * page + page;
+
+  char *base =
+      mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+  if (length && mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd,
+                     0) == MAP_FAILED) {
+    munmap(base, size);
+    return NULL;
+  }
+  if (!(length % page)) {
+    mprotect(base + length, page, PROT_READ);
+  }
+  madvise(base, length, MADV_SEQUENTIAL);
+
+  return _link(manager, base, length, size, true);
+}
+
+static const struct source *_read(struct source_manager *manager, int fd) {
+  size_t capacity = CAPACITY_INIT;
+  size_t length = 0;
+  char *chars = MEM_ALLOC(capacity);
+
+  for (;;) {
+    if (length + 1 >= capacity) {
+      chars = reallocate(chars, capacity, capacity * CAPACITY_MULT);
+      capacity *= CAPACITY_MULT;
+    }
+    ssize_t count = read(fd, chars + length, capacity - length - 1);
+    if (count < 0) {
+      MEM_FREE(chars, capacity);
+      return NULL;
+    }
+    if (!count) {
+      break;
+    }
+    length += count;
+  }
+  chars[length] = '\0';
+
+  return _link(manager, chars, length, capacity, false);
+}
+
+void source_manager_init(struct source_manager *manager) {
+  manager->sources = NULL;
+}
+
+void source_manager_free(struct source_manager *manager) {
+  while (manager->sources) {
+    source_t next = manager->sources->next;
+    if (manager->sources->is_mapped) {
+      munmap((void *)manager->sources->chars, manager->sources->size);
+    } else {
+      MEM_FREE((void *)manager->sources->chars, manager->sources->size);
+    }
+    MEM_FREE(manager->sources, sizeof(struct source));
+    manager->sources = next;
+  }
+}
+
+const struct source *source_manager_open(struct source_manager *manager,
+                                         const char *path) {
+  if (!strcmp(path, "-")) {
+    return _read(manager, STDIN_FILENO);
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct stat info;
+  const struct source *source = NULL;
+  if (!fstat(fd, &info)) {
+    source = S_ISREG(info.st_mode) ? _map(manager, fd, info.st_size)
+                                   : _read(manager, fd);
+  }
+  close(fd);
+  return source;
+}
+
+const struct source *source_manager_add(struct source_manager *manager,
+                                        const char *chars, size_t length) {
+  char *copy = MEM_ALLOC(length + 1);
+  memcpy(copy, chars, length);
+  copy[length] = '\0';
+  return _link(manager, copy, length, length + 1, false);
+}
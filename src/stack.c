@@ -12,25 +12,24 @@ void stack_init(stack_t *stack) {
   (*stack)->top = (*stack)->values;
 }
 
-void stack_put(stack_t *stack, struct value value) {
-  if ((*stack)->top - (*stack)->values >= (*stack)->capacity) {
-    size_t count = (*stack)->top - (*stack)->values;
-    size_t new_capacity = (*stack)->capacity * CAPACITY_MULT;
-
-    *stack = reallocate(
-        *stack,
-        sizeof(struct stack) + (*stack)->capacity * sizeof(struct value),
-        sizeof(struct stack) + new_capacity * sizeof(struct value));
-
-    (*stack)->capacity = new_capacity;
-    (*stack)->top = (*stack)->values + count;
+void stack_reserve(stack_t *stack, uint32_t count) {
+  size_t used = (*stack)->top - (*stack)->values;
+  if (used + count <= (*stack)->capacity) {
+    return;
   }
 
-  *((*stack)->top) = value;
-  (*stack)->top++;
-}
+  size_t new_capacity = (*stack)->capacity;
+  while (new_capacity < used + count) {
+    new_capacity *= CAPACITY_MULT;
+  }
 
-struct value stack_pop(stack_t stack) { return *--stack->top; }
+  *stack = reallocate(
+      *stack, sizeof(struct stack) + (*stack)->capacity * sizeof(struct value),
+      sizeof(struct stack) + new_capacity * sizeof(struct value));
+
+  (*stack)->capacity = new_capacity;
+  (*stack)->top = (*stack)->values + used;
+}
 
 void stack_reset(stack_t stack) { stack->top = stack->values; }
 
@@ -3,28 +3,76 @@
 #include "obj.h"
 #include "value.h"
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define CAPACITY_INIT 8
-#define CAPACITY_MULT 2
-#define TABLE_MAX_LOAD 0.75F
+#ifdef __SSE2__
+#define TABLE_SSE2
+#include <emmintrin.h>
+#endif
 
-void table_init(table_t *table) {
-  *table = reallocate(
-      NULL, 0, sizeof(struct table) + CAPACITY_INIT * sizeof(struct entry));
-  (*table)->count = 0;
-  (*table)->capacity = CAPACITY_INIT;
-  struct entry *entries = (*table)->entries;
-  for (uint32_t i = 0; i < CAPACITY_INIT; ++i) {
-    entries[i].key = NULL;
-    entries[i].value = TABLE_NIL;
+#define CAPACITY_INIT TABLE_GROUP_WIDTH
+#define CAPACITY_MULT 2U
+#define TABLE_MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+#define TABLE_CONTROL_EMPTY 0x80U
+#define TABLE_CONTROL_DELETED 0xFEU
+
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((uint8_t)((hash) & 0x7F))
+
+static inline uint8_t *_control(const struct table *table) {
+  return (uint8_t *)(table->entries + table->capacity);
+}
+
+static inline size_t _size(uint32_t capacity) {
+  return sizeof(struct table) + capacity * (sizeof(struct entry) + 1);
+}
+
+static inline uint32_t _match(const uint8_t *group, uint8_t control) {
+#ifdef TABLE_SSE2
+  __m128i bytes = _mm_loadu_si128((const __m128i *)group);
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)control)));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < TABLE_GROUP_WIDTH; ++i) {
+    mask |= (uint32_t)(group[i] == control) << i;
+  }
+  return mask;
+#endif
+}
+
+// Empty and deleted slots are the only control bytes with the top bit set.
+static inline uint32_t _match_free(const uint8_t *group) {
+#ifdef TABLE_SSE2
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_loadu_si128((const __m128i *)group));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < TABLE_GROUP_WIDTH; ++i) {
+    mask |= (uint32_t)(group[i] >> 7) << i;
+  }
+  return mask;
+#endif
+}
+
+static table_t _allocate(uint32_t capacity) {
+  table_t table = MEM_ALLOC(_size(capacity));
+  if (!table) {
+    exit(1);
   }
+  table->count = 0;
+  table->capacity = capacity;
+  table->growth_left = TABLE_MAX_LOAD(capacity);
+  memset(_control(table), TABLE_CONTROL_EMPTY, capacity);
+  return table;
 }
 
+void table_init(table_t *table) { *table = _allocate(CAPACITY_INIT); }
+
 void table_free(table_t *table) {
-  reallocate(*table,
-             sizeof(struct table) + (*table)->capacity * sizeof(struct entry),
-             0);
+  MEM_FREE(*table, _size((*table)->capacity));
   *table = NULL;
 }
 
@@ -37,83 +85,118 @@ uint32_t table_hash(const char *key, uint32_t length) {
   return hash;
 }
 
-static struct entry *_find_entry(struct entry *entries, uint32_t capacity,
+// Groups are visited in triangular order, which reaches every group of a
+// power-of-two table. A lookup ends at the first group with an empty slot.
+static struct entry *_find_entry(const struct table *table,
                                  const struct obj_string *key) {
-  uint32_t index = key->hash % capacity;
-  struct entry *tombstone = NULL;
-
-  for (;;) {
-    struct entry *entry = entries + index;
-    if (!entry->value.kind) {
-      if (VALUE_AS_BOOL(entry->value)) {
-        if (!tombstone) {
-          tombstone = entry;
-        }
-      } else {
-        return (tombstone) ? tombstone : entry;
+  const uint8_t *control = _control(table);
+  uint32_t mask = table->capacity / TABLE_GROUP_WIDTH - 1;
+  uint32_t group = H1(key->hash) & mask;
+
+  for (uint32_t step = 1;; ++step) {
+    uint32_t base = group * TABLE_GROUP_WIDTH;
+    for (uint32_t match = _match(control + base, H2(key->hash)); match;
+         match &= match - 1) {
+      struct entry *entry =
+          (struct entry *)table->entries + base + __builtin_ctz(match);
+      if (entry->key == key) {
+        return entry;
       }
-    } else if (entry->key == key) {
-      return entry;
     }
-
-    index = (index + 1) % capacity;
+    if (_match(control + base, TABLE_CONTROL_EMPTY)) {
+      return NULL;
+    }
+    group = (group + step) & mask;
   }
 }
 
-static void _adjust_capacity(table_t *table, uint32_t capacity) {
-  table_t new_table =
-      MEM_ALLOC(sizeof(struct table) + capacity * sizeof(struct entry));
-  if (!new_table) {
+static uint32_t _find_free(const struct table *table, uint32_t hash) {
+  const uint8_t *control = _control(table);
+  uint32_t mask = table->capacity / TABLE_GROUP_WIDTH - 1;
+  uint32_t group = H1(hash) & mask;
+
+  for (uint32_t step = 1;; ++step) {
+    uint32_t base = group * TABLE_GROUP_WIDTH;
+    uint32_t match = _match_free(control + base);
+    if (match) {
+      return base + __builtin_ctz(match);
+    }
+    group = (group + step) & mask;
   }
-  new_table->capacity = capacity;
-  new_table->count = 0;
+}
+
+static void _place(table_t table, uint32_t index, struct obj_string *key,
+                   struct value value) {
+  uint8_t *control = _control(table);
+  table->growth_left -= control[index] == TABLE_CONTROL_EMPTY;
+  control[index] = H2(key->hash);
+  table->entries[index] = (struct entry){key, value};
+  ++table->count;
+}
 
-  struct entry *new_entries = new_table->entries;
-  for (uint32_t i = 0; i < capacity; ++i) {
-    new_entries[i].key = NULL;
-    new_entries[i].value = TABLE_NIL;
+// A slot can go back to empty when its group still has an empty slot: no
+// probe sequence has ever continued past that group.
+static void _erase(table_t table, uint32_t index) {
+  uint8_t *control = _control(table);
+  uint32_t base = index & ~(TABLE_GROUP_WIDTH - 1);
+  if (_match(control + base, TABLE_CONTROL_EMPTY)) {
+    control[index] = TABLE_CONTROL_EMPTY;
+    ++table->growth_left;
+  } else {
+    control[index] = TABLE_CONTROL_DELETED;
   }
+  table->entries[index].key = NULL;
+  --table->count;
+}
+
+static void _adjust_capacity(table_t *table, uint32_t capacity) {
+  table_t new_table = _allocate(capacity);
 
-  struct entry *old_entries = (*table)->entries;
+  const uint8_t *control = _control(*table);
   uint32_t old_capacity = (*table)->capacity;
   for (uint32_t i = 0; i < old_capacity; ++i) {
-    struct entry *entry = old_entries + i;
-    if (!entry) {
+    if (control[i] & TABLE_CONTROL_EMPTY) {
       continue;
     }
-
-    struct entry *dest = _find_entry(new_entries, capacity, entry->key);
-    dest->key = entry->key;
-    dest->value = dest->value;
-    ++new_table->count;
+    struct entry *entry = (*table)->entries + i;
+    _place(new_table, _find_free(new_table, entry->key->hash), entry->key,
+           entry->value);
   }
 
-  MEM_FREE(*table, sizeof(struct table) + old_capacity * sizeof(struct entry));
+  MEM_FREE(*table, _size(old_capacity));
   *table = new_table;
 }
 
-bool table_insert(table_t *table, struct obj_string *key, struct value value) {
-  if ((*table)->count >= (*table)->capacity * TABLE_MAX_LOAD) {
-    uint32_t capacity = (*table)->capacity * CAPACITY_MULT;
-    _adjust_capacity(table, capacity);
+// Tombstones eat into the growth budget too, so a table that runs out of it
+// while mostly deleted is rehashed at the same capacity instead of doubling.
+void table_reserve(table_t *table, uint32_t count) {
+  if ((*table)->growth_left >= count) {
+    return;
   }
-
-  struct entry *entry = _find_entry((*table)->entries, (*table)->capacity, key);
-  if (!entry && !VALUE_AS_BOOL(entry->value)) {
-    ++(*table)->count;
+  uint32_t capacity = (*table)->capacity;
+  while (TABLE_MAX_LOAD(capacity) / 2 < (*table)->count + count) {
+    capacity *= CAPACITY_MULT;
   }
+  _adjust_capacity(table, capacity);
+}
 
-  entry->key = key;
-  entry->value = value;
+bool table_insert(table_t *table, struct obj_string *key, struct value value) {
+  struct entry *entry = _find_entry(*table, key);
+  if (entry) {
+    entry->value = value;
+    return false;
+  }
 
-  return entry;
+  table_reserve(table, 1);
+  _place(*table, _find_free(*table, key->hash), key, value);
+  return true;
 }
 
 void table_add_all(const struct table *from, table_t *to) {
+  const uint8_t *control = _control(from);
   for (uint32_t i = 0; i < from->capacity; ++i) {
-    const struct entry *entry = from->entries + i;
-    if (!entry) {
-      table_insert(to, entry->key, entry->value);
+    if (!(control[i] & TABLE_CONTROL_EMPTY)) {
+      table_insert(to, from->entries[i].key, from->entries[i].value);
     }
   }
 }
@@ -124,9 +207,8 @@ bool table_member(const struct table *table, const struct obj_string *key,
     return false;
   }
 
-  const struct entry *entry =
-      _find_entry((struct entry *)table->entries, table->capacity, key);
-  if (!entry->key) {
+  const struct entry *entry = _find_entry(table, key);
+  if (!entry) {
     return false;
   }
 
@@ -139,14 +221,12 @@ bool table_delete(table_t table, const struct obj_string *key) {
     return false;
   }
 
-  struct entry *entry = _find_entry(table->entries, table->capacity, key);
-  if (!entry->key) {
+  struct entry *entry = _find_entry(table, key);
+  if (!entry) {
     return false;
   }
 
-  entry->key = NULL;
-  entry->value = VALUE_FROM_BOOL(true);
-
+  _erase(table, (uint32_t)(entry - table->entries));
   return true;
 }
 
@@ -156,19 +236,44 @@ obj_string_t table_find_string(table_t table, const char *chars,
     return NULL;
   }
 
-  uint32_t index = hash % table->capacity;
-  for (;;) {
-    struct entry *entry = table->entries + index;
+  const uint8_t *control = _control(table);
+  uint32_t mask = table->capacity / TABLE_GROUP_WIDTH - 1;
+  uint32_t group = H1(hash) & mask;
 
-    if (!entry) {
-      if (!VALUE_AS_BOOL(entry->value)) {
-        return NULL;
+  for (uint32_t step = 1;; ++step) {
+    uint32_t base = group * TABLE_GROUP_WIDTH;
+    for (uint32_t match = _match(control + base, H2(hash)); match;
+         match &= match - 1) {
+      obj_string_t key = table->entries[base + __builtin_ctz(match)].key;
+      if (key->hash == hash && key->length == length &&
+          !memcmp(OBJ_AS_CSTRING(key), chars, length)) {
+        return key;
       }
-    } else if (entry->key->length == length && entry->key->hash == hash &&
-               memcmp(OBJ_AS_CSTRING(entry->key), chars, length)) {
-      return entry->key;
     }
+    if (_match(control + base, TABLE_CONTROL_EMPTY)) {
+      return NULL;
+    }
+    group = (group + step) & mask;
+  }
+}
 
-    index = (index + 1) % table->capacity;
+void table_intern_all(const struct table *from, table_t *to) {
+  const uint8_t *control = _control(from);
+  for (uint32_t i = 0; i < from->capacity; ++i) {
+    obj_string_t key = from->entries[i].key;
+    if (!(control[i] & TABLE_CONTROL_EMPTY) &&
+        !table_find_string(*to, OBJ_AS_CSTRING(key), key->length, key->hash)) {
+      table_insert(to, key, from->entries[i].value);
+    }
+  }
+}
+
+void table_remove_unmarked(table_t table) {
+  const uint8_t *control = _control(table);
+  for (uint32_t i = 0; i < table->capacity; ++i) {
+    if (!(control[i] & TABLE_CONTROL_EMPTY) &&
+        !table->entries[i].key->obj.is_marked) {
+      _erase(table, i);
+    }
   }
 }
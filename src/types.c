@@ -0,0 +1,151 @@
+#include "types.h"
+#include <stdint.h>
+#include <stdio.h>
+
+static const char *const g_TYPE_NAMES[] = {
+    [NODE_KIND_BOOL] = "BOOLEAN", [NODE_KIND_CHAR] = "CHAR",
+    [NODE_KIND_REAL] = "REAL",    [NODE_KIND_INTEGER] = "INTEGER",
+    [NODE_KIND_STRING] = "STRING",
+};
+
+const char *type_name(enum node_kind type) { return g_TYPE_NAMES[type]; }
+
+bool type_is_number(enum node_kind type) {
+  return type == NODE_KIND_INTEGER || type == NODE_KIND_REAL;
+}
+
+static inline struct type_rule _ok(enum node_kind type,
+                                   enum node_kind operand) {
+  return (struct type_rule){.type = type, .operand = operand};
+}
+
+static inline struct type_rule _fail(const char *message) {
+  struct type_rule rule = {.type = TYPE_ERROR, .operand = TYPE_ERROR};
+  snprintf(rule.message, sizeof(rule.message), "%s", message);
+  return rule;
+}
+
+// Two INTEGERs stay INTEGERs; any other pair of numbers is widened to REAL.
+static struct type_rule _numbers(enum node_kind lhs, enum node_kind rhs) {
+  if (lhs == NODE_KIND_INTEGER && rhs == NODE_KIND_INTEGER) {
+    return _ok(NODE_KIND_INTEGER, NODE_KIND_INTEGER);
+  }
+  struct type_rule rule = _ok(NODE_KIND_REAL, NODE_KIND_REAL);
+  rule.widen_lhs = lhs == NODE_KIND_INTEGER;
+  rule.widen_rhs = rhs == NODE_KIND_INTEGER;
+  return rule;
+}
+
+struct type_rule type_unary(enum node_kind op, enum node_kind operand) {
+  if (operand == TYPE_ERROR) {
+    return _ok(TYPE_ERROR, TYPE_ERROR);
+  }
+  if (op == NODE_KIND_NOT) {
+    return operand == NODE_KIND_BOOL ? _ok(operand, operand)
+                                     : _fail("Operand must be a BOOLEAN.");
+  }
+  return type_is_number(operand) ? _ok(operand, operand)
+                                 : _fail("Operand must be a number.");
+}
+
+// Numbers compare after widening. Other operands must have the same type;
+// STRINGs only compare for equality.
+static struct type_rule _compare(enum node_kind op, enum node_kind lhs,
+                                 enum node_kind rhs) {
+  if (type_is_number(lhs) && type_is_number(rhs)) {
+    struct type_rule rule = _numbers(lhs, rhs);
+    rule.type = NODE_KIND_BOOL;
+    return rule;
+  }
+  bool is_equality = op == NODE_KIND_EQUAL || op == NODE_KIND_NOT_EQUAL;
+  if (lhs != rhs || (lhs == NODE_KIND_STRING && !is_equality)) {
+    struct type_rule rule = _fail("");
+    snprintf(rule.message, sizeof(rule.message), "Cannot compare %s with %s.",
+             g_TYPE_NAMES[lhs], g_TYPE_NAMES[rhs]);
+    return rule;
+  }
+  return _ok(NODE_KIND_BOOL, lhs);
+}
+
+struct type_rule type_binary(enum node_kind op, enum node_kind lhs,
+                             enum node_kind rhs) {
+  if (lhs == TYPE_ERROR || rhs == TYPE_ERROR) {
+    return _ok(TYPE_ERROR, TYPE_ERROR);
+  }
+  switch (op) {
+  case NODE_KIND_ADD:
+  case NODE_KIND_SUB:
+  case NODE_KIND_MUL:
+  case NODE_KIND_DIV:
+    if (!type_is_number(lhs) || !type_is_number(rhs)) {
+      return _fail("Operands must be numbers.");
+    }
+    return _numbers(lhs, rhs);
+  case NODE_KIND_INT_DIV:
+  case NODE_KIND_MOD:
+    if (lhs != NODE_KIND_INTEGER || rhs != NODE_KIND_INTEGER) {
+      return _fail("Operands must be INTEGERs.");
+    }
+    return _ok(NODE_KIND_INTEGER, NODE_KIND_INTEGER);
+  case NODE_KIND_AND:
+  case NODE_KIND_OR:
+    if (lhs != NODE_KIND_BOOL || rhs != NODE_KIND_BOOL) {
+      return _fail("Operands must be BOOLEANs.");
+    }
+    return _ok(NODE_KIND_BOOL, NODE_KIND_BOOL);
+  case NODE_KIND_CONCAT:
+    if (lhs != NODE_KIND_STRING || rhs != NODE_KIND_STRING) {
+      return _fail("Operands must be STRINGs.");
+    }
+    return _ok(NODE_KIND_STRING, NODE_KIND_STRING);
+  case NODE_KIND_EQUAL:
+  case NODE_KIND_NOT_EQUAL:
+  case NODE_KIND_GREATER:
+  case NODE_KIND_GREATER_EQUAL:
+  case NODE_KIND_LESS:
+  case NODE_KIND_LESS_EQUAL:
+    return _compare(op, lhs, rhs);
+  default:
+    return _fail("Unsupported expression.");
+  }
+}
+
+// A value may be stored as its own type, and an INTEGER as a REAL.
+struct type_rule type_convert(enum node_kind from, enum node_kind to) {
+  if (from == TYPE_ERROR || to == TYPE_ERROR) {
+    return _ok(TYPE_ERROR, TYPE_ERROR);
+  }
+  if (from == to) {
+    return _ok(to, to);
+  }
+  if (from == NODE_KIND_INTEGER && to == NODE_KIND_REAL) {
+    struct type_rule rule = _ok(to, to);
+    rule.widen_rhs = true;
+    return rule;
+  }
+  struct type_rule rule = _fail("");
+  snprintf(rule.message, sizeof(rule.message), "Expected %s but got %s.",
+           g_TYPE_NAMES[to], g_TYPE_NAMES[from]);
+  return rule;
+}
+
+void type_error(const struct ast *ast, const char *message) {
+  flockfile(stderr);
+  fprintf(stderr, "[line %u] Error", ast->line);
+  switch (ast->kind) {
+  case NODE_KIND_VARIABLE:
+  case NODE_KIND_DECLARE:
+  case NODE_KIND_CONSTANT:
+  case NODE_KIND_ASSIGN:
+  case NODE_KIND_FUNCTION:
+  case NODE_KIND_PROCEDURE:
+  case NODE_KIND_PARAMETER:
+    fprintf(stderr, " at '%.*s'", ast->as.variable.length,
+            ast->as.variable.name);
+    break;
+  default:
+    break;
+  }
+  fprintf(stderr, ": %s\n", message);
+  funlockfile(stderr);
+}
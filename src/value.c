@@ -10,7 +10,8 @@
 
 void value_array_new(value_array_t *array) {
   *array = reallocate(
-      NULL, 0, sizeof(value_array_t) + CAPACITY_INIT * sizeof(struct value));
+      NULL, 0,
+      sizeof(struct value_array) + CAPACITY_INIT * sizeof(struct value));
   (*array)->capacity = CAPACITY_INIT;
   (*array)->count = 0;
 }
@@ -36,30 +37,44 @@ void value_array_write(value_array_t *array, struct value value) {
 }
 
 bool value_is_equal(struct value a, struct value b) {
-  if (a.kind != b.kind) {
+  if (VALUE_KIND(a) != VALUE_KIND(b)) {
     return false;
   }
-  switch (a.kind) {
+  switch (VALUE_KIND(a)) {
   case VALUE_KIND_BOOL:
     return VALUE_AS_BOOL(a) == VALUE_AS_BOOL(b);
   case VALUE_KIND_CHAR:
-    return VALUE_AS_CHAR(a) == VALUE_AS_BOOL(b);
+    return VALUE_AS_CHAR(a) == VALUE_AS_CHAR(b);
   case VALUE_KIND_REAL:
-    return VALUE_AS_REAL(a) == VALUE_AS_BOOL(b);
+    return VALUE_AS_REAL(a) == VALUE_AS_REAL(b);
   case VALUE_KIND_INTEGER:
-    return VALUE_AS_INTEGER(a) == VALUE_AS_BOOL(b);
+    return VALUE_AS_INTEGER(a) == VALUE_AS_INTEGER(b);
   case VALUE_KIND_OBJ:
-    return VALUE_AS_OBJ(a) == VALUE_AS_OBJ(b);
+    return obj_is_equal(VALUE_AS_OBJ(a), VALUE_AS_OBJ(b));
   }
+  return false;
 }
 
+#ifdef VALUE_NAN_BOXING
+
+struct value value_box_integer(obj_t *objects, int64_t integer) {
+  return (struct value){VALUE_SIGN | VALUE_QNAN | VALUE_TAG_BOXED |
+                        (uint64_t)(uintptr_t)obj_integer_new(objects, integer)};
+}
+
+int64_t value_unbox_integer(struct value value) {
+  return OBJ_AS_INTEGER(VALUE_AS_OBJ(value))->value;
+}
+
+#endif
+
 #ifdef DEBUG_CHUNK
 #include <stdio.h>
 
 void value_print(struct value value) {
-  switch (value.kind) {
+  switch (VALUE_KIND(value)) {
   case VALUE_KIND_BOOL:
-    fputs(value.as.boolean ? "TRUE" : "FALSE", stderr);
+    fputs(VALUE_AS_BOOL(value) ? "TRUE" : "FALSE", stderr);
     break;
   case VALUE_KIND_CHAR:
     fprintf(stderr, "'%c'", VALUE_AS_CHAR(value));
@@ -1,193 +1,324 @@
 #include "vm.h"
+#include "memory.h"
 #include "obj.h"
 #include "value.h"
 #include <stdint.h>
-#include <string.h>
-
-#ifdef DEBUG_TRACE_EXECUTION
 #include <stdio.h>
+#include <stdlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(VM_COMPUTED_GOTO) && !defined(__GNUC__)
+#undef VM_COMPUTED_GOTO
 #endif
 
 void vm_init(struct vm *vm) {
+  pool_init(&vm->pool);
+  memory_set_allocator(&vm->pool.allocator);
   vm->objects = NULL;
+  vm->chunk = NULL;
+  vm->reg_chunk = NULL;
+  vm->base = vm->frame_count = 0;
+  vm->trace = false;
+  vm->count_hits = false;
+  vm->opcode_pairs = NULL;
+  vm->opcode_stats = NULL;
+  vm->profile = NULL;
+  vm->stats = (struct vm_stats){0};
+  source_manager_init(&vm->sources);
+  output_init(&vm->output, stdout);
+  gc_init(&vm->gc, vm);
+  gc_pause(&vm->gc);
   stack_init(&vm->stack);
+  value_array_new(&vm->globals);
   table_init(&vm->strings);
+  gc_resume(&vm->gc);
 }
 
 void vm_free(struct vm *vm) {
   stack_free(&vm->stack);
+  value_array_free(&vm->globals);
   table_free(&vm->strings);
   objects_free(&vm->objects);
+  source_manager_free(&vm->sources);
+  output_free(&vm->output);
+  gc_free(&vm->gc);
+  free(vm->opcode_pairs);
+  vm->opcode_pairs = NULL;
+  free(vm->opcode_stats);
+  vm->opcode_stats = NULL;
+  if (vm->profile) {
+    profile_free(vm->profile);
+    free(vm->profile);
+    vm->profile = NULL;
+  }
+  memory_set_allocator(NULL);
+  pool_free(&vm->pool);
 }
 
-static void _concat(struct vm *vm) {
-  obj_string_t b = VALUE_AS_STRING(stack_pop(vm->stack));
-  obj_string_t a = VALUE_AS_STRING(stack_pop(vm->stack));
-
-  uint32_t length = a->length + b->length;
-  char c[length];
-  memcpy(c, OBJ_AS_CSTRING(a), a->length);
-  memcpy(c + a->length, OBJ_AS_CSTRING(b), b->length);
-
-  stack_put(&vm->stack, VALUE_FROM_OBJ(obj_string_copy(
-                            &vm->objects, &vm->strings, c, length)));
-}
-
-static enum interpret_result _run(struct vm *vm) {
-#define READ_BYTE() (*vm->ip++)
-#define READ_CONSTANT() (vm->chunk->constants->values[READ_BYTE()])
-#define READ_CONSTANT_LONG()                                                   \
-  (vm->chunk->constants                                                        \
-       ->values[READ_BYTE() | (READ_BYTE() << 8) | (READ_BYTE() << 16)])
-#define COMPARE_OP(op)                                                         \
-  do {                                                                         \
-    struct value b = stack_pop(vm->stack);                                     \
-    struct value a = stack_pop(vm->stack);                                     \
-    switch (a.kind) {                                                          \
-    case VALUE_KIND_BOOL:                                                      \
-      stack_put(&vm->stack,                                                    \
-                VALUE_FROM_BOOL(VALUE_AS_BOOL(a) op VALUE_AS_BOOL(b)));        \
-      break;                                                                   \
-    case VALUE_KIND_CHAR:                                                      \
-      stack_put(&vm->stack,                                                    \
-                VALUE_FROM_BOOL(VALUE_AS_CHAR(a) op VALUE_AS_CHAR(b)));        \
-      break;                                                                   \
-    case VALUE_KIND_REAL:                                                      \
-      stack_put(&vm->stack,                                                    \
-                VALUE_FROM_BOOL(VALUE_AS_REAL(a) op VALUE_AS_REAL(b)));        \
-      break;                                                                   \
-    case VALUE_KIND_INTEGER:                                                   \
-      stack_put(&vm->stack,                                                    \
-                VALUE_FROM_BOOL(VALUE_AS_INTEGER(a) op VALUE_AS_INTEGER(b)));  \
-      break;                                                                   \
-    default:                                                                   \
-      break;                                                                   \
-    }                                                                          \
-  } while (false)
-#define BOOL_BINARY_OP(op)                                                     \
-  do {                                                                         \
-    bool b = stack_pop(vm->stack).as.boolean;                                  \
-    struct value a = stack_pop(vm->stack);                                     \
-    a.as.boolean = a.as.boolean op b;                                          \
-    stack_put(&vm->stack, a);                                                  \
-  } while (false)
-#define NUMBER_BINARY_OP(op)                                                   \
-  do {                                                                         \
-    struct value b = stack_pop(vm->stack);                                     \
-    struct value a = stack_pop(vm->stack);                                     \
-    if (a.kind == VALUE_KIND_REAL) {                                           \
-      a.as.real = a.as.real op b.as.real;                                      \
-    } else {                                                                   \
-      a.as.integer = a.as.integer op b.as.integer;                             \
-    }                                                                          \
-    stack_put(&vm->stack, a);                                                  \
-  } while (false)
-  for (;;) {
-#ifdef DEBUG_TRACE_EXECUTION
-    fputs("          ", stderr);
-    for (struct value *slot = vm->stack->values; slot < vm->stack->top;
-         slot++) {
-      fputs("[ ", stderr);
-      value_print(*slot);
-      fputs(" ]", stderr);
-    }
-    fputc('\n', stderr);
+void vm_count_opcode_pairs(struct vm *vm) {
+  if (!vm->opcode_pairs) {
+    vm->opcode_pairs = calloc(OPCODE_COUNT * OPCODE_COUNT, sizeof(uint64_t));
+  }
+}
 
-    chunk_disassemble_instruction(vm->chunk, vm->ip - vm->chunk->code);
-#endif
-    enum opcode instruction;
-    switch (instruction = READ_BYTE()) {
-    case OPCODE_CONSTANT:
-      stack_put(&vm->stack, READ_CONSTANT());
-      break;
-    case OPCODE_CONSTANT_LONG:
-      stack_put(&vm->stack, READ_CONSTANT_LONG());
-      break;
-    case OPCODE_ADD:
-      NUMBER_BINARY_OP(+);
-      break;
-    case OPCODE_SUB:
-      NUMBER_BINARY_OP(-);
-      break;
-    case OPCODE_MUL:
-      NUMBER_BINARY_OP(*);
-      break;
-    case OPCODE_DIV:
-      NUMBER_BINARY_OP(/);
-      break;
-    case OPCODE_NEGATE: {
-      struct value *top = &vm->stack->top[-1];
-      switch (top->kind) {
-      case VALUE_KIND_REAL:
-        top->as.real = -top->as.real;
-        break;
-      case VALUE_KIND_INTEGER:
-        return top->as.integer = -top->as.integer;
-        break;
-      default:
-        return INTERPRET_RESULT_RUNTIME_ERROR;
-      }
-      break;
-    }
-    case OPCODE_RETURN:
-      value_print(stack_pop(vm->stack));
-      fputc('\n', stderr);
-      return INTERPRET_RESULT_OK;
-    case OPCODE_TRUE:
-      stack_put(&vm->stack,
-                (struct value){VALUE_KIND_BOOL, .as.boolean = true});
-      break;
-    case OPCODE_FALSE:
-      stack_put(&vm->stack,
-                (struct value){VALUE_KIND_BOOL, .as.boolean = false});
-      break;
-    case OPCODE_NOT:
-      vm->stack->top[-1].as.boolean = !vm->stack->top[-1].as.boolean;
-      break;
-    case OPCODE_EQUAL: {
-      struct value a = stack_pop(vm->stack);
-      struct value b = stack_pop(vm->stack);
-      stack_put(&vm->stack, (struct value){VALUE_KIND_BOOL,
-                                           .as.boolean = value_is_equal(a, b)});
-      break;
-    }
-    case OPCODE_NOT_EQUAL: {
-      struct value a = stack_pop(vm->stack);
-      struct value b = stack_pop(vm->stack);
-      stack_put(&vm->stack, (struct value){VALUE_KIND_BOOL,
-                                           .as.boolean = value_is_equal(a, b)});
-      break;
+void vm_count_opcodes(struct vm *vm) {
+  if (!vm->opcode_stats) {
+    vm->opcode_stats = calloc(1, sizeof(struct vm_opcode_stats));
+  }
+}
+
+bool vm_profile(struct vm *vm, uint32_t interval) {
+  if (vm->profile) {
+    return true;
+  }
+  vm->profile = malloc(sizeof(struct profile));
+  if (!vm->profile || !profile_init(vm->profile, vm, interval)) {
+    free(vm->profile);
+    vm->profile = NULL;
+    return false;
+  }
+  return true;
+}
+
+struct opcode_pair {
+  uint64_t count;
+  enum opcode first, second;
+};
+
+static int _compare_pairs(const void *a, const void *b) {
+  uint64_t x = ((const struct opcode_pair *)a)->count;
+  uint64_t y = ((const struct opcode_pair *)b)->count;
+  return (x < y) - (x > y);
+}
+
+void vm_print_opcode_pairs(const struct vm *vm) {
+  if (!vm->opcode_pairs) {
+    return;
+  }
+
+  struct opcode_pair *pairs =
+      malloc(OPCODE_COUNT * OPCODE_COUNT * sizeof(struct opcode_pair));
+  if (!pairs) {
+    return;
+  }
+  uint32_t count = 0;
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < OPCODE_COUNT * OPCODE_COUNT; ++i) {
+    if (vm->opcode_pairs[i]) {
+      pairs[count++] = (struct opcode_pair){vm->opcode_pairs[i],
+                                            i / OPCODE_COUNT, i % OPCODE_COUNT};
+      total += vm->opcode_pairs[i];
     }
-    case OPCODE_LESS:
-      COMPARE_OP(<);
-      break;
-    case OPCODE_LESS_EQUAL:
-      COMPARE_OP(<=);
-      break;
-    case OPCODE_GREATER:
-      COMPARE_OP(>);
-      break;
-    case OPCODE_GREATER_EQUAL:
-      COMPARE_OP(<=);
-      break;
-    case OPCODE_CONCAT:
-      _concat(vm);
-      break;
+  }
+  qsort(pairs, count, sizeof(struct opcode_pair), _compare_pairs);
+
+  fprintf(stderr, "%14s %7s  %s\n", "count", "share", "opcode pair");
+  for (uint32_t i = 0; i < count; ++i) {
+    fprintf(stderr, "%14llu %6.2f%%  %s %s\n",
+            (unsigned long long)pairs[i].count, 100.0 * pairs[i].count / total,
+            chunk_opcode_name(pairs[i].first),
+            chunk_opcode_name(pairs[i].second));
+  }
+  free(pairs);
+}
+
+struct opcode_count {
+  uint64_t count, cycles;
+  enum opcode opcode;
+};
+
+static int _compare_counts(const void *a, const void *b) {
+  uint64_t x = ((const struct opcode_count *)a)->count;
+  uint64_t y = ((const struct opcode_count *)b)->count;
+  return (x < y) - (x > y);
+}
+
+void vm_print_opcode_stats(const struct vm *vm) {
+  const struct vm_opcode_stats *stats = vm->opcode_stats;
+  if (!stats) {
+    return;
+  }
+
+  struct opcode_count counts[OPCODE_COUNT];
+  uint32_t count = 0;
+  uint64_t total = 0, cycles = 0;
+  for (uint32_t i = 0; i < OPCODE_COUNT; ++i) {
+    if (stats->counts[i]) {
+      counts[count++] =
+          (struct opcode_count){stats->counts[i], stats->cycles[i], i};
+      total += stats->counts[i];
+      cycles += stats->cycles[i];
     }
   }
-#undef READ_BYTE
-#undef READ_CONSTANT
-#undef READ_CONSTANT_LONG
-#undef COMPARE_OP
-#undef BOOL_BINARY_OP
-#undef NUMBER_BINARY_OP
+  qsort(counts, count, sizeof(struct opcode_count), _compare_counts);
+
+  fprintf(stderr, "%14s %7s %16s %7s %9s  %s\n", "count", "share", "cycles",
+          "share", "per op", "opcode");
+  for (uint32_t i = 0; i < count; ++i) {
+    fprintf(stderr, "%14llu %6.2f%% %16llu %6.2f%% %9.1f  %s\n",
+            (unsigned long long)counts[i].count,
+            100.0 * counts[i].count / total,
+            (unsigned long long)counts[i].cycles,
+            cycles ? 100.0 * counts[i].cycles / cycles : 0.0,
+            (double)counts[i].cycles / counts[i].count,
+            chunk_opcode_name(counts[i].opcode));
+  }
+  fprintf(stderr, "vm: %llu opcodes, %llu cycles, %llu allocations\n",
+          (unsigned long long)total, (unsigned long long)cycles,
+          (unsigned long long)stats->allocations);
+}
+
+void vm_print_stats(const struct vm *vm) {
+  fprintf(stderr, "vm: %llu opcodes quickened, %llu quick hits, %llu misses\n",
+          (unsigned long long)vm->stats.quickened,
+          (unsigned long long)vm->stats.quick_hits,
+          (unsigned long long)vm->stats.quick_misses);
+}
+
+obj_t vm_concat(struct vm *vm, obj_t a, obj_t b) {
+  gc_safepoint(&vm->gc);
+  gc_pause(&vm->gc);
+  obj_t text = obj_text_concat(&vm->objects, &vm->strings, a, b);
+  gc_resume(&vm->gc);
+  return text;
 }
 
+static void _concat(struct vm *vm) {
+  struct value *top = vm->stack->top;
+  obj_t text = vm_concat(vm, VALUE_AS_OBJ(top[-2]), VALUE_AS_OBJ(top[-1]));
+
+  top[-2] = VALUE_FROM_OBJ(text);
+  vm->stack->top = top - 1;
+}
+
+// The `_QUICK` form of a generic opcode for operands of one kind. Zero, which
+// is OPCODE_CONSTANT, means the opcode stays generic for that kind.
+static const enum opcode g_QUICK_FORMS[OPCODE_COUNT][VALUE_KIND_OBJ + 1] = {
+    [OPCODE_ADD] = {[VALUE_KIND_INTEGER] = OPCODE_ADD_INT_QUICK,
+                    [VALUE_KIND_REAL] = OPCODE_ADD_REAL_QUICK},
+    [OPCODE_SUB] = {[VALUE_KIND_INTEGER] = OPCODE_SUB_INT_QUICK,
+                    [VALUE_KIND_REAL] = OPCODE_SUB_REAL_QUICK},
+    [OPCODE_MUL] = {[VALUE_KIND_INTEGER] = OPCODE_MUL_INT_QUICK,
+                    [VALUE_KIND_REAL] = OPCODE_MUL_REAL_QUICK},
+    [OPCODE_DIV] = {[VALUE_KIND_INTEGER] = OPCODE_DIV_INT_QUICK,
+                    [VALUE_KIND_REAL] = OPCODE_DIV_REAL_QUICK},
+    [OPCODE_NEGATE] = {[VALUE_KIND_INTEGER] = OPCODE_NEGATE_INT_QUICK,
+                       [VALUE_KIND_REAL] = OPCODE_NEGATE_REAL_QUICK},
+    [OPCODE_EQUAL] = {[VALUE_KIND_INTEGER] = OPCODE_EQUAL_INT_QUICK,
+                      [VALUE_KIND_CHAR] = OPCODE_EQUAL_CHAR_QUICK},
+    [OPCODE_NOT_EQUAL] = {[VALUE_KIND_INTEGER] = OPCODE_NOT_EQUAL_INT_QUICK,
+                          [VALUE_KIND_CHAR] = OPCODE_NOT_EQUAL_CHAR_QUICK},
+    [OPCODE_LESS] = {[VALUE_KIND_CHAR] = OPCODE_LESS_CHAR_QUICK},
+    [OPCODE_LESS_EQUAL] = {[VALUE_KIND_CHAR] = OPCODE_LESS_EQUAL_CHAR_QUICK},
+    [OPCODE_GREATER] = {[VALUE_KIND_CHAR] = OPCODE_GREATER_CHAR_QUICK},
+    [OPCODE_GREATER_EQUAL] = {[VALUE_KIND_CHAR] =
+                                  OPCODE_GREATER_EQUAL_CHAR_QUICK},
+};
+
+static const enum opcode g_GENERIC_FORMS[OPCODE_COUNT] = {
+    [OPCODE_ADD_INT_QUICK] = OPCODE_ADD,
+    [OPCODE_ADD_REAL_QUICK] = OPCODE_ADD,
+    [OPCODE_SUB_INT_QUICK] = OPCODE_SUB,
+    [OPCODE_SUB_REAL_QUICK] = OPCODE_SUB,
+    [OPCODE_MUL_INT_QUICK] = OPCODE_MUL,
+    [OPCODE_MUL_REAL_QUICK] = OPCODE_MUL,
+    [OPCODE_DIV_INT_QUICK] = OPCODE_DIV,
+    [OPCODE_DIV_REAL_QUICK] = OPCODE_DIV,
+    [OPCODE_NEGATE_INT_QUICK] = OPCODE_NEGATE,
+    [OPCODE_NEGATE_REAL_QUICK] = OPCODE_NEGATE,
+    [OPCODE_EQUAL_INT_QUICK] = OPCODE_EQUAL,
+    [OPCODE_EQUAL_CHAR_QUICK] = OPCODE_EQUAL,
+    [OPCODE_NOT_EQUAL_INT_QUICK] = OPCODE_NOT_EQUAL,
+    [OPCODE_NOT_EQUAL_CHAR_QUICK] = OPCODE_NOT_EQUAL,
+    [OPCODE_LESS_CHAR_QUICK] = OPCODE_LESS,
+    [OPCODE_LESS_EQUAL_CHAR_QUICK] = OPCODE_LESS_EQUAL,
+    [OPCODE_GREATER_CHAR_QUICK] = OPCODE_GREATER,
+    [OPCODE_GREATER_EQUAL_CHAR_QUICK] = OPCODE_GREATER_EQUAL,
+};
+
+// Rewrites the generic opcode at `instruction` for operands of kinds `a` and
+// `b`. Chunks loaded from the cache are private mappings, so this never
+// writes through to the cache file.
+static inline void _quicken(struct vm *vm, uint8_t *instruction,
+                            enum value_kind a, enum value_kind b) {
+  enum opcode quick = a == b ? g_QUICK_FORMS[*instruction][a] : 0;
+  if (quick) {
+    *instruction = quick;
+    ++vm->stats.quickened;
+  }
+}
+
+static void _dequicken(struct vm *vm, uint8_t *instruction) {
+  *instruction = g_GENERIC_FORMS[*instruction];
+  ++vm->stats.quick_misses;
+}
+
+// Reports an error at the instruction `vm->ip` is in the middle of, after
+// the output the program made before it.
+static void _runtime_error(struct vm *vm, const char *message) {
+  output_flush(&vm->output);
+  struct location location = debug_info_lookup(
+      vm->chunk->debug, (uint32_t)(vm->ip - vm->chunk->code - 1), NULL);
+  fprintf(stderr, "[line %u:%u] Error: %s\n", location.line, location.column,
+          message);
+}
+
+#define VM_RUN _run
+#include "vm_run.inc"
+#undef VM_RUN
+
+// A timestamp for `--stats`: the time-stamp counter where there is one,
+// nanoseconds elsewhere.
+static inline uint64_t _cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+#endif
+}
+
+#define VM_RUN _run_instrumented
+#define VM_RUN_INSTRUMENTED
+#include "vm_run.inc"
+#undef VM_RUN_INSTRUMENTED
+#undef VM_RUN
+
 enum interpret_result vm_interpret(struct vm *vm, const chunk_t chunk) {
   vm->chunk = chunk;
   vm->ip = chunk->code;
+  vm->base = vm->frame_count = 0;
+  while (vm->globals->count < chunk->globals) {
+    value_array_write(&vm->globals, VALUE_FROM_BOOL(false));
+  }
+  stack_reserve(&vm->stack,
+                chunk->max_stack + VM_FRAMES_MAX * chunk->max_frame);
 
-  enum interpret_result result = _run(vm);
+  if (vm->profile) {
+    profile_start(vm->profile);
+  }
+  uint64_t allocations = vm->gc.stats.allocations;
+  enum interpret_result result =
+      vm->trace || vm->count_hits || vm->opcode_pairs || vm->opcode_stats
+          ? _run_instrumented(vm)
+          : _run(vm);
+  if (vm->opcode_stats) {
+    vm->opcode_stats->allocations += vm->gc.stats.allocations - allocations;
+  }
+  if (vm->profile) {
+    profile_stop(vm->profile);
+  }
 
+  output_flush(&vm->output);
+  if (result != INTERPRET_RESULT_OK) {
+    stack_reset(vm->stack);
+  }
+  vm->chunk = NULL;
+  vm->frame_count = 0;
   return result;
 }
@@ -0,0 +1,25 @@
+// Identity rules apply to declared variables, parameters, constants and
+// calls, and leave REAL additions alone.
+FUNCTION Twice(n : INTEGER) RETURNS INTEGER
+  DECLARE m : INTEGER
+  m <- n * 1
+  RETURN (m + 0) * 2
+ENDFUNCTION
+
+FUNCTION Scale(x : REAL) RETURNS REAL
+  RETURN x * 1 - 0
+ENDFUNCTION
+
+DECLARE flag : BOOLEAN
+DECLARE s : STRING
+DECLARE r : REAL
+CONSTANT k = 7
+r <- 2.5
+s <- "ab"
+flag <- TRUE AND NOT NOT flag
+s <- "" & s & ""
+s
+flag
+Twice(k DIV 1) + 0
+Scale(r) / 1
+r + 0
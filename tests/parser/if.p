@@ -0,0 +1,20 @@
+// IF conditions end at THEN, a token with no expression rule: the parser
+// must stop there instead of reading past its rule tables.
+FUNCTION Sign(n : INTEGER) RETURNS INTEGER
+  IF n < 0 THEN RETURN -1 ENDIF
+  IF n = 0 THEN RETURN 0 ENDIF
+  RETURN 1
+ENDFUNCTION
+
+FUNCTION Between(n : INTEGER, low : INTEGER, high : INTEGER) RETURNS BOOLEAN
+  IF n >= low AND n <= high THEN
+    RETURN TRUE
+  ENDIF
+  RETURN FALSE
+ENDFUNCTION
+
+Sign(-5)
+Sign(0)
+Sign(7)
+Between(3, 1, 5)
+Between(9, 1, 5)
@@ -0,0 +1,4 @@
+// Operands the stack backend rejects are rejected on registers as well,
+// before any of the program runs.
+"a"
+"a" < "b"
@@ -0,0 +1,18 @@
+// The register backend types expressions like the stack backend and widens
+// the INTEGER operands that meet a REAL.
+FUNCTION Scale(n : INTEGER, x : REAL) RETURNS REAL
+  RETURN n * x
+ENDFUNCTION
+
+FUNCTION Same(n : INTEGER, x : REAL) RETURNS BOOLEAN
+  RETURN n = x
+ENDFUNCTION
+
+FUNCTION Widen(n : INTEGER) RETURNS REAL
+  RETURN n
+ENDFUNCTION
+
+Scale(2, 3.5)
+Same(1, 1.0)
+Widen(3) / 2
+Scale(2, 0.25) < 1
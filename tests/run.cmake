@@ -0,0 +1,25 @@
+# Runs campseudo with OPTIONS on PROGRAM and fails unless it exits with
+# RESULT, 0 by default, and prints exactly the contents of EXPECTED, and of
+# ERRORS on stderr when that file exists.
+if (NOT DEFINED RESULT)
+    set (RESULT 0)
+endif ()
+execute_process (
+    COMMAND ${CAMPSEUDO} --no-cache ${OPTIONS} ${PROGRAM}
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors
+)
+if (NOT result EQUAL RESULT)
+    message (FATAL_ERROR "${PROGRAM} exited with ${result}:\n${errors}")
+endif ()
+if (EXISTS ${ERRORS})
+    file (READ ${ERRORS} expected_errors)
+    if (NOT errors STREQUAL expected_errors)
+        message (FATAL_ERROR "${PROGRAM} reported:\n${errors}\nexpected:\n${expected_errors}")
+    endif ()
+endif ()
+file (READ ${EXPECTED} expected)
+if (NOT output STREQUAL expected)
+    message (FATAL_ERROR "${PROGRAM} printed:\n${output}\nexpected:\n${expected}")
+endif ()
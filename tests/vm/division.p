@@ -0,0 +1,13 @@
+// Integer division by zero stops the program with an error at the
+// division instead of crashing the interpreter.
+FUNCTION Half(n : INTEGER) RETURNS INTEGER
+  RETURN n DIV 2
+ENDFUNCTION
+
+FUNCTION Divide(a : INTEGER, b : INTEGER) RETURNS INTEGER
+  RETURN a DIV b
+ENDFUNCTION
+
+Half(9)
+9 MOD 4
+Divide(10, 0)
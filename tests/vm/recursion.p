@@ -0,0 +1,12 @@
+// Calls nest as deep as the frame array allows within the stack reserved
+// on entry, and one more is a stack overflow.
+FUNCTION Down(n : INTEGER, s : STRING) RETURNS INTEGER
+  DECLARE a : INTEGER
+  DECLARE b : STRING
+  b <- s & "x"
+  IF n = 0 THEN RETURN 0 ENDIF
+  RETURN 1 + Down(n - 1, b)
+ENDFUNCTION
+
+Down(1022, "")
+Down(5000, "")
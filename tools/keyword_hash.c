@@ -0,0 +1,162 @@
+// Build-time generator for the scanner's keyword table. Searches for
+// multipliers that map the length, first character and last two characters
+// of every entry in keywords.def to a distinct slot of a power-of-two table,
+// then writes that table out as a header. Usage: keyword_hash <output>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KEYWORD_WIDTH 16U
+#define SEARCH_SIZE_MAX 512U
+#define SEARCH_MULT_MAX 64U
+
+struct keyword {
+  const char *text;
+  const char *kind;
+  uint32_t length;
+};
+
+static const struct keyword g_KEYWORDS[] = {
+#define KEYWORD(text, kind) {#text, #kind, sizeof(#text) - 1},
+#include "keywords.def"
+#undef KEYWORD
+};
+
+#define KEYWORD_COUNT (sizeof(g_KEYWORDS) / sizeof(*g_KEYWORDS))
+
+struct params {
+  uint32_t size;
+  uint32_t length_mult;
+  uint32_t first_mult;
+  uint32_t penultimate_mult;
+  uint32_t last_mult;
+};
+
+static uint32_t _hash(const struct params *params,
+                      const struct keyword *keyword) {
+  return (keyword->length * params->length_mult +
+          (uint8_t)keyword->text[0] * params->first_mult +
+          (uint8_t)keyword->text[keyword->length - 2] *
+              params->penultimate_mult +
+          (uint8_t)keyword->text[keyword->length - 1] * params->last_mult) &
+         (params->size - 1);
+}
+
+static bool _is_perfect(const struct params *params) {
+  uint8_t used[SEARCH_SIZE_MAX] = {0};
+  for (uint32_t i = 0; i < KEYWORD_COUNT; ++i) {
+    uint32_t slot = _hash(params, g_KEYWORDS + i);
+    if (used[slot]) {
+      return false;
+    }
+    used[slot] = 1;
+  }
+  return true;
+}
+
+static bool _search(struct params *params) {
+  for (params->size = 1; params->size < KEYWORD_COUNT; params->size <<= 1)
+    ;
+  for (; params->size <= SEARCH_SIZE_MAX; params->size <<= 1) {
+    for (params->first_mult = 1; params->first_mult < SEARCH_MULT_MAX;
+         ++params->first_mult) {
+      for (params->last_mult = 1; params->last_mult < SEARCH_MULT_MAX;
+           ++params->last_mult) {
+        for (params->penultimate_mult = 1;
+             params->penultimate_mult < SEARCH_MULT_MAX;
+             ++params->penultimate_mult) {
+          for (params->length_mult = 1; params->length_mult < SEARCH_MULT_MAX;
+               ++params->length_mult) {
+            if (_is_perfect(params)) {
+              return true;
+            }
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+int main(int argc, const char *argv[]) {
+  if (argc != 2) {
+    fputs("Usage: keyword_hash <output>\n", stderr);
+    return 64;
+  }
+
+  uint32_t min_length = KEYWORD_WIDTH, max_length = 0;
+  for (uint32_t i = 0; i < KEYWORD_COUNT; ++i) {
+    if (g_KEYWORDS[i].length < 2 || g_KEYWORDS[i].length >= KEYWORD_WIDTH) {
+      fprintf(stderr, "Keyword %s must be 2 to %u bytes long.\n",
+              g_KEYWORDS[i].text, KEYWORD_WIDTH - 1);
+      return EXIT_FAILURE;
+    }
+    if (g_KEYWORDS[i].length < min_length) {
+      min_length = g_KEYWORDS[i].length;
+    }
+    if (g_KEYWORDS[i].length > max_length) {
+      max_length = g_KEYWORDS[i].length;
+    }
+  }
+
+  struct params params;
+  if (!_search(&params)) {
+    fputs("No perfect hash found for keywords.def.\n", stderr);
+    return EXIT_FAILURE;
+  }
+
+  const struct keyword *slots[SEARCH_SIZE_MAX] = {0};
+  for (uint32_t i = 0; i < KEYWORD_COUNT; ++i) {
+    slots[_hash(&params, g_KEYWORDS + i)] = g_KEYWORDS + i;
+  }
+
+  FILE *file = fopen(argv[1], "w");
+  if (!file) {
+    fprintf(stderr, "Could not open \"%s\".\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  fprintf(file,
+          "// Generated by tools/keyword_hash.c from keywords.def; do not "
+          "edit.\n\n"
+          "#ifndef CAMPSEUDO_KEYWORD_HASH_H\n"
+          "#define CAMPSEUDO_KEYWORD_HASH_H\n\n"
+          "#include \"scanner.h\"\n"
+          "#include <stdint.h>\n\n"
+          "#define KEYWORD_WIDTH %uU\n"
+          "#define KEYWORD_LENGTH_MIN %uU\n"
+          "#define KEYWORD_LENGTH_MAX %uU\n"
+          "#define KEYWORD_HASH_SIZE %uU\n\n"
+          "struct keyword {\n"
+          "  char text[KEYWORD_WIDTH];\n"
+          "  uint32_t length;\n"
+          "  enum token_kind kind;\n"
+          "};\n\n"
+          "static inline uint32_t keyword_hash(const char *start, uint32_t "
+          "length) {\n"
+          "  return (length * %uU + (uint8_t)start[0] * %uU +\n"
+          "          (uint8_t)start[length - 2] * %uU +\n"
+          "          (uint8_t)start[length - 1] * %uU) &\n"
+          "         (KEYWORD_HASH_SIZE - 1);\n"
+          "}\n\n"
+          "static const struct keyword g_KEYWORDS[KEYWORD_HASH_SIZE] = {\n",
+          KEYWORD_WIDTH, min_length, max_length, params.size,
+          params.length_mult, params.first_mult, params.penultimate_mult,
+          params.last_mult);
+  for (uint32_t i = 0; i < params.size; ++i) {
+    if (slots[i]) {
+      fprintf(file, "    [%u] = {\"%s\", %u, %s},\n", i, slots[i]->text,
+              slots[i]->length, slots[i]->kind);
+    }
+  }
+  fputs("};\n\n#endif\n", file);
+
+  if (fclose(file)) {
+    fprintf(stderr, "Could not write \"%s\".\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}